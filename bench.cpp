@@ -0,0 +1,109 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace bench {
+
+static volatile uint64_t gSink = 0;
+void doNotOptimize(uint64_t v) { gSink = gSink + v; }
+
+std::string Result::key() const {
+    return name + "/systems=" + std::to_string(systems) + "/missions=" + std::to_string(missions);
+}
+
+Stats summarize(std::vector<double> s, uint64_t itersPerRep) {
+    Stats st{};
+    st.itersPerRep = itersPerRep;
+    st.reps = (int)s.size();
+    if (s.empty()) return st;
+
+    std::sort(s.begin(), s.end());
+    size_t n = s.size();
+    st.minNs = s.front();
+    st.maxNs = s.back();
+    st.medianNs = (n % 2) ? s[n / 2] : 0.5 * (s[n / 2 - 1] + s[n / 2]);
+
+    double sum = 0;
+    for (double v : s) sum += v;
+    st.meanNs = sum / n;
+
+    double var = 0;
+    for (double v : s) var += (v - st.meanNs) * (v - st.meanNs);
+    st.stddevNs = (n > 1) ? std::sqrt(var / (n - 1)) : 0.0;
+    return st;
+}
+
+bool writeJson(const std::string& path, const std::vector<Result>& results) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    std::fputs("{\"suite\":\"spacetrader\",\"unit\":\"ns/op\",\"results\":[\n", f);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        std::fprintf(f,
+            "{\"key\":\"%s\",\"name\":\"%s\",\"systems\":%lld,\"missions\":%lld,"
+            "\"reps\":%d,\"iters\":%llu,\"median\":%.3f,\"mean\":%.3f,\"min\":%.3f,\"max\":%.3f,\"stddev\":%.3f}%s\n",
+            r.key().c_str(), r.name.c_str(), r.systems, r.missions,
+            r.ns.reps, (unsigned long long)r.ns.itersPerRep,
+            r.ns.medianNs, r.ns.meanNs, r.ns.minNs, r.ns.maxNs, r.ns.stddevNs,
+            (i + 1 < results.size()) ? "," : "");
+    }
+    std::fputs("]}\n", f);
+    return std::fclose(f) == 0;
+}
+
+// The format is ours (one result per line), so a field scan is enough.
+static bool findString(const std::string& line, const char* field, std::string& out) {
+    std::string pat = std::string("\"") + field + "\":\"";
+    size_t p = line.find(pat);
+    if (p == std::string::npos) return false;
+    p += pat.size();
+    size_t e = line.find('"', p);
+    if (e == std::string::npos) return false;
+    out = line.substr(p, e - p);
+    return true;
+}
+static bool findNumber(const std::string& line, const char* field, double& out) {
+    std::string pat = std::string("\"") + field + "\":";
+    size_t p = line.find(pat);
+    if (p == std::string::npos) return false;
+    return std::sscanf(line.c_str() + p + pat.size(), "%lf", &out) == 1;
+}
+
+bool loadBaseline(const std::string& path, std::map<std::string, double>& medianByKey) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string key;
+        double median = 0;
+        if (findString(line, "key", key) && findNumber(line, "median", median))
+            medianByKey[key] = median;
+    }
+    return true;
+}
+
+int compareToBaseline(const std::vector<Result>& results,
+                      const std::map<std::string, double>& baseline,
+                      double thresholdPct) {
+    int regressions = 0;
+    std::printf("\n%-58s %12s %12s %8s\n", "benchmark", "base ns/op", "now ns/op", "delta");
+    for (const Result& r : results) {
+        auto it = baseline.find(r.key());
+        if (it == baseline.end() || it->second <= 0) {
+            std::printf("%-58s %12s %12.2f %8s\n", r.key().c_str(), "-", r.ns.medianNs, "new");
+            continue;
+        }
+        double pct = (r.ns.medianNs - it->second) / it->second * 100.0;
+        bool bad = pct > thresholdPct;
+        if (bad) regressions++;
+        std::printf("%-58s %12.2f %12.2f %+7.1f%%%s\n", r.key().c_str(), it->second, r.ns.medianNs,
+                    pct, bad ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+} // namespace bench
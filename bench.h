@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Small self-contained microbenchmark harness (used by bench_main.cpp).
+//
+// measure() calibrates an iteration count so one repetition takes at least
+// `minRepMs`, then times `reps` repetitions and summarizes ns/op. Results are
+// written as JSON (one result object per line) and can be compared against
+// a previously stored run to flag regressions.
+
+namespace bench {
+
+struct Stats {
+    double minNs = 0, medianNs = 0, meanNs = 0, maxNs = 0, stddevNs = 0;
+    uint64_t itersPerRep = 0;
+    int reps = 0;
+};
+
+struct Result {
+    std::string name;       // kernel name
+    long long systems = 0;  // galaxy size parameter (0 = n/a)
+    long long missions = 0; // mission count parameter (0 = n/a)
+    Stats ns;
+
+    std::string key() const;  // name/systems=N/missions=M
+};
+
+struct Options {
+    int reps = 15;
+    double minRepMs = 5.0;
+};
+
+// Keeps the compiler from discarding a computed value.
+void doNotOptimize(uint64_t v);
+
+Stats summarize(std::vector<double> nsPerOp, uint64_t itersPerRep);
+
+template <class F>
+Stats measure(const Options& opt, F&& op) {
+    using clock = std::chrono::steady_clock;
+    auto runFor = [&](uint64_t iters) {
+        auto t0 = clock::now();
+        for (uint64_t i = 0; i < iters; i++) op(i);
+        return std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+    };
+
+    uint64_t iters = 1;
+    while (iters < (1ull << 40)) {
+        double ns = runFor(iters);
+        if (ns >= opt.minRepMs * 1e6) break;
+        iters *= (ns < opt.minRepMs * 1e5) ? 10 : 2;
+    }
+
+    std::vector<double> samples;
+    samples.reserve(opt.reps);
+    for (int r = 0; r < opt.reps; r++) samples.push_back(runFor(iters) / (double)iters);
+    return summarize(std::move(samples), iters);
+}
+
+bool writeJson(const std::string& path, const std::vector<Result>& results);
+
+// Reads median ns/op per result key from a file written by writeJson().
+bool loadBaseline(const std::string& path, std::map<std::string, double>& medianByKey);
+
+// Prints a comparison table; returns the number of results whose median is
+// more than `thresholdPct` percent slower than the baseline.
+int compareToBaseline(const std::vector<Result>& results,
+                      const std::map<std::string, double>& baseline,
+                      double thresholdPct);
+
+} // namespace bench
@@ -0,0 +1,342 @@
+// Microbenchmarks for the core game kernels.
+//
+// Build (same sources as the game, plus the harness):
+//   g++ -O2 -std=c++17 bench_main.cpp bench.cpp termui.cpp trace.cpp perf.cpp replay.cpp rng.cpp net.cpp journal.cpp catalog.cpp -o SpaceTraderBench -lws2_32
+//
+// Usage:
+//   SpaceTraderBench [--out bench.json] [--baseline old.json] [--threshold 10]
+//                    [--max-systems N] [--reps N] [--min-rep-ms MS]
+//                    [--sector-budget MB]
+//
+// Every kernel runs against synthetic galaxies of 25 .. 1M systems (and
+// 0 .. 100k missions where relevant), built from fixed seeds so runs are
+// repeatable. Exit code is 1 if any result regressed past the threshold.
+#define SPACETRADER_NO_MAIN
+#include "main.cpp"
+
+#include "bench.h"
+
+#include <cstring>
+
+// Synthetic galaxy of `n` systems, streamed through the same sector cache and
+// generator as the game (systems past the known table get "GX-<id>" names).
+static void makeBenchGalaxy(GameState& S, int n, size_t sectorBudget) {
+    S.seed = 12345;
+    S.activeMissions.clear();
+    S.poiOffers.clear();
+    S.gen.missions++; S.gen.offers++;
+    S.fleet.clear();
+    S.fleet.add(0, 0);
+
+    int side = std::max(8, (int)std::ceil(std::sqrt((double)n) * 2.0));
+    std::vector<SystemPos> catalog((size_t)n);
+    for (int i = 0; i < n; i++) {
+        catalog[i].gx = (int)(hash32((uint32_t)i * 2u + 1u) % (uint32_t)side);
+        catalog[i].gy = (int)(hash32((uint32_t)i * 2u + 2u) % (uint32_t)side);
+    }
+    S.galaxy.reset(std::move(catalog), generateSystems);
+    S.galaxy.setBudget(sectorBudget);
+    S.gen.world++;
+    S.priceIndex.clear();
+    S.orbits.clear();
+}
+
+static void makeBenchMissions(GameState& S, int count) {
+    S.activeMissions.clear();
+    S.events.clear();
+    S.activeMissions.reserve(count);
+    for (int i = 0; i < count; i++) {
+        Mission m{};
+        m.active = true;
+        m.toSystem = i % (int)S.galaxy.size();
+        m.toPoi = 0;
+        m.amount = 5;
+        m.reward = 100;
+        m.deadlineWeeks = 1 << 30;
+        m.dueWeek = 1 << 30;       // never expires during the run
+        S.activeMissions.push_back(m);
+        scheduleMissionExpiry(S, i);
+    }
+    S.gen.missions++;
+}
+
+int main(int argc, char** argv) {
+    std::string outPath = "bench.json";
+    std::string baselinePath;
+    double threshold = 10.0;
+    long long maxSystems = 1000000;
+    size_t sectorBudget = (size_t)256 << 20;
+    bench::Options opt;
+
+    for (int i = 1; i < argc; i++) {
+        auto next = [&]() -> const char* { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (!std::strcmp(argv[i], "--out")) outPath = next();
+        else if (!std::strcmp(argv[i], "--baseline")) baselinePath = next();
+        else if (!std::strcmp(argv[i], "--threshold")) threshold = std::atof(next());
+        else if (!std::strcmp(argv[i], "--max-systems")) maxSystems = std::atoll(next());
+        else if (!std::strcmp(argv[i], "--reps")) opt.reps = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--min-rep-ms")) opt.minRepMs = std::atof(next());
+        else if (!std::strcmp(argv[i], "--sector-budget")) sectorBudget = (size_t)std::max(1LL, std::atoll(next())) << 20;
+        else { std::fprintf(stderr, "unknown option: %s\n", argv[i]); return 2; }
+    }
+
+    std::vector<bench::Result> results;
+    auto run = [&](const char* name, long long systems, long long missions, auto&& op) {
+        bench::Result r;
+        r.name = name;
+        r.systems = systems;
+        r.missions = missions;
+        r.ns = bench::measure(opt, op);
+        std::printf("%-58s %10.2f ns/op  (+/- %.2f, %d x %llu)\n", r.key().c_str(), r.ns.medianNs,
+                    r.ns.stddevNs, r.ns.reps, (unsigned long long)r.ns.itersPerRep);
+        std::fflush(stdout);
+        results.push_back(std::move(r));
+    };
+
+    // Size-independent kernels
+    run("hash32", 0, 0, [](uint64_t i) { bench::doNotOptimize(hash32((uint32_t)i)); });
+    run("makeMarket", 0, 0, [](uint64_t i) {
+        Market m = makeMarket((uint32_t)i, (PoiType)(i % 3));
+        bench::doNotOptimize((uint64_t)m.price[0] + (uint64_t)m.stock[5]);
+    });
+    {
+        // Batched kernels: one op = 1024 values / markets
+        constexpr size_t N = 1024;
+        std::vector<uint32_t> buf(N), seeds(N);
+        std::vector<PoiType> types(N);
+        std::vector<Market> markets(N);
+        for (size_t k = 0; k < N; k++) { seeds[k] = (uint32_t)k * 977u; types[k] = (PoiType)(k % 3); }
+        std::printf("(rng simd path: %s)\n", rng::simdPath());
+        run("hash32Counter[1024]", 0, 0, [&](uint64_t i) {
+            rng::hash32Counter((uint32_t)i * (uint32_t)N, buf.data(), N);
+            bench::doNotOptimize(buf[N - 1]);
+        });
+        run("makeMarkets[1024]", 0, 0, [&](uint64_t i) {
+            seeds[0] = (uint32_t)i;
+            makeMarkets(seeds.data(), types.data(), markets.data(), N);
+            bench::doNotOptimize((uint64_t)markets[N - 1].price[0]);
+        });
+    }
+    {
+        std::vector<std::wstring> words = { L"Sol", L"Proxima Centauri", L"Mission COMPLETE: Delivered 12 Electronics to Highport Station (+900 CR)." };
+        run("ellipsize", 0, 0, [&](uint64_t i) {
+            const std::wstring& w = words[i % words.size()];
+            bench::doNotOptimize(ellipsize(w, 8 + (int)(i % 32)).size());
+        });
+    }
+    run("buildRoute", 0, 0, [](uint64_t i) {
+        int tx = (int)(hash32((uint32_t)i) % 120u), ty = (int)(hash32((uint32_t)i + 7u) % 80u);
+        bench::doNotOptimize(buildRoute(60, 40, tx, ty, GALAXY_JUMP_RANGE).size());
+    });
+    run("stepToward", 0, 0, [](uint64_t i) {
+        int x = 60, y = 40;
+        stepToward(x, y, (int)(i % 120u), (int)((i >> 7) % 80u), GALAXY_JUMP_RANGE);
+        bench::doNotOptimize((uint64_t)(x * 131 + y));
+    });
+
+    for (int ships : { 1000, 10000, 100000 }) {
+        // Whole fleet in flight toward targets it never reaches during the run.
+        Fleet F;
+        for (int k = 0; k < ships; k++) {
+            int ship = F.add((int)(hash32((uint32_t)k) % 1000u), (int)(hash32((uint32_t)k + 1u) % 1000u), 1 << 30);
+            F.order[ship] = (uint8_t)ShipOrder::Travel;
+            F.tx[ship] = (k & 1) ? (1 << 29) : -(1 << 29);
+            F.ty[ship] = (k & 2) ? (1 << 29) : -(1 << 29);
+        }
+        std::vector<int> arrived;
+        std::string name = "fleetMoveWeek[" + std::to_string(ships) + " ships]";
+        run(name.c_str(), 0, 0, [&](uint64_t) {
+            fleetMove(F, 1, arrived);
+            bench::doNotOptimize((uint64_t)F.gx[0]);
+        });
+    }
+
+    for (int series : { 10000, 1000000 }) {
+        // One op = one trade: the series catches up to this week and records.
+        PriceHistory H;
+        for (int k = 0; k < series; k++) H.record(k / 18, (k / 6) % 3, (Good)(k % 6), 0, 50, 100, 50, 100);
+        std::string name = "priceHistory.record[" + std::to_string(series) + " series]";
+        run(name.c_str(), 0, 0, [&](uint64_t i) {
+            int k = (int)(i % (uint64_t)series);
+            int week = (int)(i / (uint64_t)series) + 1;
+            H.record(k / 18, (k / 6) % 3, (Good)(k % 6), week, 50, 100, 40 + (int)(hash32((uint32_t)i) % 20u), 100);
+        });
+        std::printf("(price history: %zu series, %zu MB)\n", H.size(), H.bytes() >> 20);
+    }
+    {
+        PriceSeries h(0, 50, 100);
+        for (int w = 1; w < GameDate::WEEKS_PER_YEAR * 10; w++) h.set(w, 40 + (int)(hash32((uint32_t)w) % 20u), 100);
+        run("PriceSeries::stats[48 weeks]", 0, 0, [&](uint64_t) {
+            bench::doNotOptimize((uint64_t)h.stats(GameDate::WEEKS_PER_YEAR).avg);
+        });
+    }
+
+    // Galaxy-size-dependent kernels
+    static const long long SIZES[] = { 25, 1000, 100000, 1000000 };
+    static const int MISSIONS[] = { 0, 100, 10000, 100000 };
+    GameState S;
+    for (long long n : SIZES) {
+        if (n > maxSystems) break;
+        makeBenchGalaxy(S, (int)n, sectorBudget);
+        int side = std::max(8, (int)std::ceil(std::sqrt((double)n) * 2.0));
+
+        // Hot working set: the first 4096 systems stay resident after warm-up.
+        uint64_t hot = (uint64_t)std::min(S.galaxy.size(), 4096);
+        run("computeBestInSystem", n, 0, [&](uint64_t i) {
+            if ((i & 1023) == 0) S.galaxy.beginFrame();
+            const StarSystem& sys = S.galaxy[(int)(i % hot)];
+            BestInfo bi = computeBestInSystem(sys, (Good)(i % (int)Good::COUNT));
+            bench::doNotOptimize((uint64_t)(bi.minPoi + bi.maxPoi));
+        });
+        run("systemIndexAtGalaxy", n, 0, [&](uint64_t i) {
+            int gx = (int)(hash32((uint32_t)i) % (uint32_t)side);
+            int gy = (int)(hash32((uint32_t)i ^ 0x5bd1e995u) % (uint32_t)side);
+            bench::doNotOptimize((uint64_t)systemIndexAtGalaxy(S, gx, gy));
+        });
+        // Index cells are filled by the first query over them, as in play.
+        run("PriceIndex::cheapest[3 jumps]", n, 0, [&](uint64_t i) {
+            if ((i & 1023) == 0) S.galaxy.beginFrame();
+            int id = (int)(i % hot);
+            PriceIndex::Hit h = S.priceIndex.cheapest(S.galaxy, (Good)(i % (int)Good::COUNT), S.galaxy.pos(id).gx,
+                                                      S.galaxy.pos(id).gy, RUMOR_JUMPS * GALAXY_JUMP_RANGE);
+            bench::doNotOptimize((uint64_t)h.value);
+        });
+        {
+            const int units[(int)Good::COUNT] = { 10, 5, 20, 0, 3, 2 };
+            run("PriceIndex::bestSellPoints[13 jumps, top 5]", n, 0, [&](uint64_t i) {
+                if ((i & 1023) == 0) S.galaxy.beginFrame();
+                int id = (int)(i % hot);
+                auto leads = S.priceIndex.bestSellPoints(S.galaxy, units, S.galaxy.pos(id).gx, S.galaxy.pos(id).gy,
+                                                         13 * GALAXY_JUMP_RANGE, 5);
+                bench::doNotOptimize(leads.size());
+            });
+        }
+        {
+            // One op = one trade near the ship: the market moves, then both
+            // indexes catch up with it.
+            S.galaxy.beginFrame();
+            S.arbitrage.follow(S.galaxy, S.priceIndex, side / 2, side / 2);
+            std::vector<int> near;
+            for (int id = 0; id < S.galaxy.size(); id++)
+                if (chebyshev(S.galaxy.pos(id).gx, S.galaxy.pos(id).gy, side / 2, side / 2) <= SECTOR_SIZE) near.push_back(id);
+            if (!near.empty())
+                run("ArbitrageIndex::changed[1 market]", n, 0, [&](uint64_t i) {
+                    int id = near[i % near.size()];
+                    int poi = (int)(i % S.galaxy[id].pois.size());
+                    Market& m = writeMarket(S, id, poi);
+                    m.pressure[i % (int)Good::COUNT] += (i & 1) ? 40 : -40;
+                    marketWritten(S, id, poi);
+                    S.priceIndex.update(S.galaxy, id, poi, m);
+                    S.arbitrage.changed(S.galaxy, S.priceIndex, { { id, poi } });
+                    bench::doNotOptimize((uint64_t)S.arbitrage.top(Good::Ore, ArbitrageIndex::Nearby).size());
+                });
+        }
+        {
+            // Fuel overlay over the whole catalog extent; every op changes fuel
+            // so the overlay is rebuilt (chains for the tank size stay cached).
+            FuelReach reach;
+            reach.setSystems(S.galaxy.catalog(), side, side);
+            int fuel = 20;
+            run("FuelReach::update[fuel change]", n, 0, [&](uint64_t) {
+                fuel = (fuel == 40) ? 20 : fuel + 1;
+                reach.update(side / 2, side / 2, fuel, 60);
+                bench::doNotOptimize(reach.now(side / 2, side / 2, side / 2, side / 2));
+            });
+        }
+        {
+            // Startup from a catalog file of the same galaxy: map, checksum,
+            // bounds pass and an in-place Galaxy::reset. The file stays in
+            // the page cache between reps, so this is the warm-start cost.
+            const char* path = "bench_catalog.bin";
+            catalog::Builder b;
+            SystemSpan pos = S.galaxy.catalog();
+            for (int id = 0; id < S.galaxy.size(); id++) {
+                uint32_t seed = catalog::defaultSystemSeed((uint32_t)id);
+                b.addSystem(L"GX-" + std::to_wstring(id), pos[id].gx, pos[id].gy, seed);
+                b.addPoi(L"Prime", 0, seed + 1);
+                b.addPoi(L"Highport Station", 1, seed + 2);
+                b.addPoi(L"Outer Belt", 2, seed + 3);
+            }
+            std::string err;
+            if (b.write(path, SECTOR_SIZE, err)) {
+                run("Catalog::open+Galaxy::reset", n, 0, [&](uint64_t) {
+                    auto cat = std::make_shared<catalog::Catalog>();
+                    if (!cat->open(path, SECTOR_SIZE, err)) return;
+                    Galaxy g;
+                    g.reset(catalogIndex(*cat), cat, catalogGenerator(cat));
+                    bench::doNotOptimize((uint64_t)g.size());
+                });
+            }
+            std::remove(path);
+        }
+        // Uniform over the whole galaxy, so large sizes include sector loads.
+        run("generateOffersForDock", n, 0, [&](uint64_t i) {
+            S.galaxy.beginFrame();
+            S.currentSystem = (int)(hash32((uint32_t)i) % (uint32_t)S.galaxy.size());
+            S.dockPoiIndex = (int)(i % 3);
+            generateOffersForDock(S);
+            bench::doNotOptimize(S.poiOffers.size());
+        });
+
+        {
+            // Weekly economy tick shape: offers for every dock in the galaxy.
+            if (n <= 100000) {
+                S.galaxy.beginFrame();
+                std::vector<DockRef> docks;
+                for (int si = 0; si < S.galaxy.size(); si++)
+                    for (int pi = 0; pi < (int)S.galaxy[si].pois.size(); pi++) docks.push_back({ si, pi });
+                std::vector<std::vector<Mission>> offers(docks.size());
+                run("generateOffersBatch[all docks]", n, 0, [&](uint64_t) {
+                    generateOffersBatch(S, docks.data(), docks.size(), offers.data());
+                    bench::doNotOptimize(offers[0].size());
+                });
+            }
+        }
+
+        for (int m : MISSIONS) {
+            makeBenchMissions(S, m);
+            run("advanceTime[1 week]", n, m, [&](uint64_t) {
+                S.date = GameDate{};
+                advanceTime(S, 1);
+                bench::doNotOptimize(S.activeMissions.size());
+            });
+            run("advanceTime[52 weeks]", n, m, [&](uint64_t) {
+                S.date = GameDate{};
+                advanceTime(S, 52);
+                bench::doNotOptimize(S.activeMissions.size());
+            });
+        }
+        S.activeMissions.clear();
+        S.gen.missions++;
+
+        // Random systems over the whole galaxy, last since it churns the
+        // cache: once the galaxy outgrows --sector-budget, a miss generates a
+        // sector and evicts the least recently used ones.
+        run("Galaxy::operator[][random, sector budget]", n, 0, [&](uint64_t i) {
+            if ((i & 255) == 0) S.galaxy.beginFrame();
+            const StarSystem& sys = S.galaxy[(int)(hash32((uint32_t)i * 2654435761u) % (uint32_t)S.galaxy.size())];
+            bench::doNotOptimize((uint64_t)sys.pois.size());
+        });
+        Galaxy::Stats gs = S.galaxy.stats();
+        std::printf("  sector cache: budget %zu MB, %zu MB resident, %llu evictions\n", sectorBudget >> 20,
+                    gs.residentBytes >> 20, (unsigned long long)gs.evictions);
+    }
+
+    if (!bench::writeJson(outPath, results)) {
+        std::fprintf(stderr, "could not write %s\n", outPath.c_str());
+        return 2;
+    }
+    std::printf("\nwrote %zu results to %s\n", results.size(), outPath.c_str());
+
+    if (!baselinePath.empty()) {
+        std::map<std::string, double> base;
+        if (!bench::loadBaseline(baselinePath, base)) {
+            std::fprintf(stderr, "could not read baseline %s\n", baselinePath.c_str());
+            return 2;
+        }
+        int bad = bench::compareToBaseline(results, base, threshold);
+        std::printf("\n%d regression(s) above %.1f%%\n", bad, threshold);
+        return bad ? 1 : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,375 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "catalog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace catalog {
+
+static const char MAGIC[4] = { 'S', 'T', 'C', 'G' };
+
+static uint64_t align8(uint64_t v) { return (v + 7) & ~7ull; }
+
+// Section offsets; every size follows from the header counts.
+namespace {
+struct Sections {
+    uint64_t pos, sectorStart, sectorIds, localIndex, systems, pois, names, end;
+
+    explicit Sections(const Header& h) {
+        uint64_t o = sizeof(Header);
+        auto take = [&o](uint64_t bytes) { uint64_t at = o; o = align8(o + bytes); return at; };
+        pos         = take((uint64_t)h.systems * sizeof(Pos));
+        sectorStart = take(((uint64_t)h.sectorsX * h.sectorsY + 1) * sizeof(uint32_t));
+        sectorIds   = take((uint64_t)h.systems * sizeof(uint32_t));
+        localIndex  = take((uint64_t)h.systems * sizeof(uint32_t));
+        systems     = take((uint64_t)h.systems * sizeof(SystemRec));
+        pois        = take((uint64_t)h.pois * sizeof(PoiRec));
+        names       = take((uint64_t)h.nameUnits * sizeof(uint16_t));
+        end = o;
+    }
+};
+}
+
+// FNV-1a over u64 words: one multiply per 8 bytes keeps it under the cost
+// of faulting the pages in.
+static uint64_t checksum(const uint8_t* p, uint64_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (uint64_t i = 0; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h ^= w;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint32_t defaultSystemSeed(uint32_t id) { return 0xC0FFEEu + id * 1337u; }
+
+// ---------------- Catalog ----------------
+Catalog::~Catalog() { close(); }
+
+void Catalog::close() {
+    if (view_) UnmapViewOfFile(view_);
+    if (mapping_) CloseHandle((HANDLE)mapping_);
+    if (file_) CloseHandle((HANDLE)file_);
+    view_ = nullptr;
+    mapping_ = file_ = nullptr;
+    h_ = nullptr;
+}
+
+bool Catalog::open(const std::string& path, uint32_t sectorSize, std::string& err) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE || !file) { err = "cannot open " + path; return false; }
+    file_ = file;
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(Header)) {
+        close();
+        err = path + ": not a catalog file";
+        return false;
+    }
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) view_ = (const uint8_t*)MapViewOfFile((HANDLE)mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (!view_) { close(); err = "cannot map " + path; return false; }
+
+    if (!validate((uint64_t)size.QuadPart, sectorSize, err)) {
+        close();
+        err = path + ": " + err;
+        return false;
+    }
+    return true;
+}
+
+// Header and checksum first, then one pass over each array so that nothing
+// the galaxy indexes with can point outside the file.
+bool Catalog::validate(uint64_t size, uint32_t sectorSize, std::string& err) {
+    h_ = (const Header*)view_;
+    const Header& h = *h_;
+    if (std::memcmp(h.magic, MAGIC, 4) != 0) { err = "not a catalog file"; return false; }
+    if (h.version != VERSION) { err = "unsupported catalog version"; return false; }
+    if (h.sectorSize != sectorSize) { err = "sector size " + std::to_string(h.sectorSize) + ", expected " + std::to_string(sectorSize); return false; }
+    if (h.width > MAX_EXTENT || h.height > MAX_EXTENT) { err = "extent over " + std::to_string(MAX_EXTENT); return false; }
+    if (h.sectorsX != (h.width + sectorSize - 1) / sectorSize || h.sectorsY != (h.height + sectorSize - 1) / sectorSize ||
+        h.width == 0 || h.height == 0) {
+        err = "sector grid does not match the extent";
+        return false;
+    }
+    if (h.systems == 0) { err = "no systems"; return false; }
+    Sections s(h);
+    if (h.fileSize != size || s.end != size) { err = "truncated or oversized file"; return false; }
+    if (checksum(view_ + sizeof(Header), size - sizeof(Header)) != h.checksum) { err = "checksum mismatch"; return false; }
+
+    pos_ = (const Pos*)(view_ + s.pos);
+    sectorStart_ = (const uint32_t*)(view_ + s.sectorStart);
+    sectorIds_ = (const uint32_t*)(view_ + s.sectorIds);
+    localIndex_ = (const uint32_t*)(view_ + s.localIndex);
+    systems_ = (const SystemRec*)(view_ + s.systems);
+    pois_ = (const PoiRec*)(view_ + s.pois);
+    names_ = (const uint16_t*)(view_ + s.names);
+
+    uint64_t sectors = (uint64_t)h.sectorsX * h.sectorsY;
+    if (sectorStart_[0] != 0 || sectorStart_[sectors] != h.systems) { err = "bad sector table"; return false; }
+    for (uint32_t sec = 0; sec < sectors; sec++) {
+        if (sectorStart_[sec] > sectorStart_[sec + 1]) { err = "bad sector table"; return false; }
+        for (uint32_t k = sectorStart_[sec]; k < sectorStart_[sec + 1]; k++) {
+            uint32_t id = sectorIds_[k];
+            if (id >= h.systems || localIndex_[id] != k - sectorStart_[sec]) { err = "bad sector ids"; return false; }
+            const Pos& p = pos_[id];
+            if (p.gx < 0 || p.gy < 0 || (uint32_t)p.gx >= h.width || (uint32_t)p.gy >= h.height ||
+                (uint32_t)(p.gy / (int32_t)sectorSize) * h.sectorsX + (uint32_t)(p.gx / (int32_t)sectorSize) != sec) {
+                err = "system " + std::to_string(id) + " outside its sector";
+                return false;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < h.systems; i++) {
+        const SystemRec& r = systems_[i];
+        if (r.poiCount == 0 || r.poiCount > MAX_POIS || (uint64_t)r.firstPoi + r.poiCount > h.pois ||
+            (uint64_t)r.name + r.nameLen > h.nameUnits) {
+            err = "system " + std::to_string(i) + " out of range";
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.pois; i++) {
+        const PoiRec& r = pois_[i];
+        if (r.type > 2 || (uint64_t)r.name + r.nameLen > h.nameUnits) {
+            err = "poi " + std::to_string(i) + " out of range";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::wstring Catalog::name(uint32_t offset, uint16_t len) const {
+    std::wstring s;
+    s.reserve(len);
+    const uint16_t* p = names_ + offset;
+    for (uint16_t i = 0; i < len; i++) {
+        uint32_t c = p[i];
+        if (sizeof(wchar_t) == 4 && c >= 0xD800 && c < 0xDC00 && i + 1 < len && p[i + 1] >= 0xDC00 && p[i + 1] < 0xE000)
+            c = 0x10000 + ((c - 0xD800) << 10) + (p[++i] - 0xDC00);
+        s.push_back((wchar_t)c);
+    }
+    return s;
+}
+
+// ---------------- Builder ----------------
+uint32_t Builder::addName(const std::wstring& name, uint16_t& len, bool share) {
+    if (share) {
+        auto it = shared_.find(name);
+        if (it != shared_.end()) {
+            size_t units = name.size();
+            for (wchar_t wc : name) units += (uint32_t)wc >= 0x10000;
+            len = (uint16_t)std::min<size_t>(units, 0xFFFF);
+            return it->second;
+        }
+    }
+    uint32_t at = (uint32_t)names_.size();
+    for (wchar_t wc : name) {
+        uint32_t c = (uint32_t)wc;
+        if (c >= 0x10000) {
+            c -= 0x10000;
+            names_.push_back((uint16_t)(0xD800 + (c >> 10)));
+            names_.push_back((uint16_t)(0xDC00 + (c & 0x3FF)));
+        } else {
+            names_.push_back((uint16_t)c);
+        }
+    }
+    len = (uint16_t)std::min<size_t>(names_.size() - at, 0xFFFF);
+    if (share) shared_.emplace(name, at);
+    return at;
+}
+
+void Builder::addSystem(const std::wstring& name, int gx, int gy, uint32_t seed) {
+    SystemRec r{};
+    r.name = addName(name, r.nameLen, false);
+    r.firstPoi = (uint32_t)pois_.size();
+    r.seed = seed;
+    systems_.push_back(r);
+    pos_.push_back({ gx, gy });
+}
+
+void Builder::addPoi(const std::wstring& name, uint8_t type, uint32_t seed, const int8_t* priceMod) {
+    PoiRec r{};
+    r.name = addName(name, r.nameLen, true);
+    r.type = type;
+    r.seed = seed;
+    if (priceMod) std::memcpy(r.priceMod, priceMod, MAX_GOODS);
+    pois_.push_back(r);
+    systems_.back().poiCount++;
+}
+
+bool Builder::write(const std::string& path, uint32_t sectorSize, std::string& err) const {
+    if (pos_.empty()) { err = "no systems"; return false; }
+    Header h{};
+    std::memcpy(h.magic, MAGIC, 4);
+    h.version = VERSION;
+    h.systems = (uint32_t)pos_.size();
+    h.pois = (uint32_t)pois_.size();
+    h.nameUnits = (uint32_t)names_.size();
+    h.sectorSize = sectorSize;
+    h.width = std::max(width_, 1u);
+    h.height = std::max(height_, 1u);
+    for (size_t i = 0; i < pos_.size(); i++) {
+        if (pos_[i].gx < 0 || pos_[i].gy < 0) { err = "system " + std::to_string(i) + " has negative coordinates"; return false; }
+        if (systems_[i].poiCount == 0) { err = "system " + std::to_string(i) + " has no POIs"; return false; }
+        if (systems_[i].poiCount > MAX_POIS) { err = "system " + std::to_string(i) + " has over " + std::to_string(MAX_POIS) + " POIs"; return false; }
+        h.width = std::max(h.width, (uint32_t)pos_[i].gx + 1);
+        h.height = std::max(h.height, (uint32_t)pos_[i].gy + 1);
+    }
+    if (h.width > MAX_EXTENT || h.height > MAX_EXTENT) { err = "extent over " + std::to_string(MAX_EXTENT); return false; }
+    h.sectorsX = (h.width + sectorSize - 1) / sectorSize;
+    h.sectorsY = (h.height + sectorSize - 1) / sectorSize;
+
+    // Same CSR as Galaxy::reset builds from a position list.
+    uint64_t sectors = (uint64_t)h.sectorsX * h.sectorsY;
+    auto sectorOf = [&](const Pos& p) { return (uint32_t)(p.gy / (int)sectorSize) * h.sectorsX + (uint32_t)(p.gx / (int)sectorSize); };
+    std::vector<uint32_t> start((size_t)sectors + 1, 0), ids(pos_.size()), local(pos_.size());
+    for (const Pos& p : pos_) start[sectorOf(p) + 1]++;
+    for (uint64_t k = 0; k < sectors; k++) start[k + 1] += start[k];
+    std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+    for (uint32_t id = 0; id < h.systems; id++) {
+        uint32_t sec = sectorOf(pos_[id]);
+        local[id] = fill[sec] - start[sec];
+        ids[fill[sec]++] = id;
+    }
+
+    Sections s(h);
+    h.fileSize = s.end;
+    std::vector<uint8_t> buf((size_t)s.end, 0);
+    auto put = [&buf](uint64_t at, const void* p, size_t n) { if (n) std::memcpy(buf.data() + at, p, n); };
+    put(s.pos, pos_.data(), pos_.size() * sizeof(Pos));
+    put(s.sectorStart, start.data(), start.size() * sizeof(uint32_t));
+    put(s.sectorIds, ids.data(), ids.size() * sizeof(uint32_t));
+    put(s.localIndex, local.data(), local.size() * sizeof(uint32_t));
+    put(s.systems, systems_.data(), systems_.size() * sizeof(SystemRec));
+    put(s.pois, pois_.data(), pois_.size() * sizeof(PoiRec));
+    put(s.names, names_.data(), names_.size() * sizeof(uint16_t));
+    h.checksum = checksum(buf.data() + sizeof(Header), s.end - sizeof(Header));
+    put(0, &h, sizeof(Header));
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) { err = "cannot write " + path; return false; }
+    bool ok = std::fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) err = "cannot write " + path;
+    return ok;
+}
+
+// ---------------- Text source ----------------
+// Splits one line on commas; "quoted" fields may hold commas and "" quotes.
+static std::vector<std::string> splitFields(const std::string& line) {
+    std::vector<std::string> out(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') { out.back() += '"'; i++; }
+            else if (c == '"') quoted = false;
+            else out.back() += c;
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            out.emplace_back();
+        } else {
+            out.back() += c;
+        }
+    }
+    for (auto& f : out) {
+        size_t a = f.find_first_not_of(" \t"), b = f.find_last_not_of(" \t");
+        f = (a == std::string::npos) ? std::string() : f.substr(a, b - a + 1);
+    }
+    return out;
+}
+
+static std::wstring fromUtf8(const std::string& s) {
+    std::wstring out;
+    for (size_t i = 0; i < s.size();) {
+        unsigned char c = (unsigned char)s[i];
+        int extra = c < 0x80 ? 0 : (c >> 5) == 6 ? 1 : (c >> 4) == 14 ? 2 : (c >> 3) == 30 ? 3 : -1;
+        if (extra < 0 || i + extra >= s.size() + (extra ? 0 : 1)) { out.push_back(L'?'); i++; continue; }
+        uint32_t cp = extra ? (c & (0x3F >> extra)) : c;
+        for (int k = 1; k <= extra; k++) cp = (cp << 6) | ((unsigned char)s[i + k] & 0x3F);
+        out.push_back((wchar_t)cp);
+        i += 1 + extra;
+    }
+    return out;
+}
+
+static bool parseInt(const std::string& s, long long lo, long long hi, long long& out) {
+    if (s.empty()) return false;
+    char* end = nullptr;
+    long long v = std::strtoll(s.c_str(), &end, 0);
+    if (*end != '\0' || v < lo || v > hi) return false;
+    out = v;
+    return true;
+}
+
+bool convertCsv(const std::string& csvPath, const std::string& outPath, uint32_t sectorSize, std::string& err) {
+    FILE* f = std::fopen(csvPath.c_str(), "rb");
+    if (!f) { err = "cannot open " + csvPath; return false; }
+
+    Builder b;
+    uint32_t sysSeed = 0, poiIndex = 0;
+    std::string line;
+    int lineNo = 0;
+    bool ok = true;
+    auto fail = [&](const std::string& what) {
+        err = csvPath + ":" + std::to_string(lineNo) + ": " + what;
+        ok = false;
+    };
+
+    for (int c = 0; ok && c != EOF;) {
+        line.clear();
+        while ((c = std::fgetc(f)) != EOF && c != '\n') if (c != '\r') line += (char)c;
+        lineNo++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos && line.find('"') == std::string::npos) line.resize(hash);
+        if (line.find_first_not_of(" \t") == std::string::npos) continue;
+
+        std::vector<std::string> v = splitFields(line);
+        long long x, y, n;
+        if (v[0] == "extent") {
+            if (v.size() != 3 || !parseInt(v[1], 1, MAX_EXTENT, x) || !parseInt(v[2], 1, MAX_EXTENT, y)) {
+                fail("expected extent,<width>,<height> up to " + std::to_string(MAX_EXTENT));
+                break;
+            }
+            b.setExtent((uint32_t)x, (uint32_t)y);
+        } else if (v[0] == "system") {
+            if (v.size() < 4 || v.size() > 5 || v[1].empty()) { fail("expected system,<name>,<gx>,<gy>[,<seed>]"); break; }
+            if (!parseInt(v[2], 0, MAX_EXTENT - 1, x) || !parseInt(v[3], 0, MAX_EXTENT - 1, y)) { fail("bad coordinates"); break; }
+            sysSeed = defaultSystemSeed(b.systemCount());
+            if (v.size() == 5) {
+                if (!parseInt(v[4], 0, 0xFFFFFFFFll, n)) { fail("bad seed"); break; }
+                sysSeed = (uint32_t)n;
+            }
+            b.addSystem(fromUtf8(v[1]), (int)x, (int)y, sysSeed);
+            poiIndex = 0;
+        } else if (v[0] == "poi") {
+            if (b.systemCount() == 0) { fail("poi before the first system"); break; }
+            if (v.size() < 3 || v.size() > 3 + (size_t)MAX_GOODS || v[1].empty()) { fail("expected poi,<name>,<type>[,<price %>...]"); break; }
+            uint8_t type = v[2] == "planet" ? 0 : v[2] == "station" ? 1 : v[2] == "outpost" ? 2 : 255;
+            if (type == 255) { fail("type must be planet, station or outpost"); break; }
+            if (poiIndex == MAX_POIS) { fail("over " + std::to_string(MAX_POIS) + " POIs in one system"); break; }
+            int8_t mod[MAX_GOODS] = {};
+            for (size_t k = 3; k < v.size(); k++) {
+                if (!parseInt(v[k], -99, 127, n)) { fail("price % must be -99..127"); break; }
+                mod[k - 3] = (int8_t)n;
+            }
+            if (!ok) break;
+            b.addPoi(fromUtf8(v[1]), type, sysSeed + 1 + poiIndex++, mod);
+        } else {
+            fail("unknown record '" + v[0] + "'");
+        }
+    }
+    std::fclose(f);
+    return ok && b.write(outPath, sectorSize, err);
+}
+
+} // namespace catalog
@@ -0,0 +1,143 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Galaxy catalog files: the universe as data instead of compiled-in tables.
+//
+// A catalog is memory-mapped and used in place. The arrays the galaxy needs
+// (positions, systems per sector) are stored ready to use, so opening one
+// costs a checksum and a bounds pass over the mapped pages, not a parse.
+//
+// File layout (little endian). Sections follow the header in this order,
+// each starting on an 8-byte boundary; their sizes follow from the counts.
+//   Header       64 bytes, see below
+//   positions    i32 gx, i32 gy                      x systems
+//   sectorStart  u32                                 x sectorsX * sectorsY + 1
+//   sectorIds    u32 (ids by sector, id order)       x systems
+//   localIndex   u32 (id -> position in its sector)  x systems
+//   systems      SystemRec                           x systems
+//   pois         PoiRec (grouped by system)          x pois
+//   names        u16 UTF-16 code units               x nameUnits
+// Sector (sx, sy) is index sy * sectorsX + sx and covers sectorSize x
+// sectorSize coordinates. The checksum is FNV-1a over the file after the
+// header, taken as little-endian u64 words (the file is zero-padded to 8).
+//
+// Every system has 1..MAX_POIS POIs (somewhere to dock), and the extent is
+// at most MAX_EXTENT on each side.
+//
+// Text source for convertCsv(), one record per line ('#' starts a comment,
+// fields may be double-quoted):
+//   extent,<width>,<height>                  optional, grown to fit the systems
+//   system,<name>,<gx>,<gy>[,<seed>]
+//   poi,<name>,<planet|station|outpost>[,<price % per good>...]
+// A poi belongs to the system above it. Seeds default to the ones of the
+// built-in universe (system id * 1337 + 0xC0FFEE, POI system seed + 1 + i),
+// so a catalog of the known systems plays like the compiled-in table.
+
+namespace catalog {
+
+constexpr uint32_t VERSION = 1;
+constexpr int MAX_GOODS = 8;               // price modifiers per POI
+constexpr uint32_t MAX_POIS = 200;         // per system: the most a system map lays out
+constexpr uint32_t MAX_EXTENT = 4096;      // per side: the map grids keep a cell per coordinate
+
+struct Header {
+    char magic[4];                         // "STCG"
+    uint32_t version;
+    uint32_t systems, pois, nameUnits;
+    uint32_t width, height;                // galaxy extent in coordinates
+    uint32_t sectorSize, sectorsX, sectorsY;
+    uint64_t fileSize;
+    uint64_t checksum;
+    uint8_t reserved[8];
+};
+
+struct Pos { int32_t gx, gy; };
+
+struct SystemRec {
+    uint32_t name;                         // offset into names
+    uint16_t nameLen;
+    uint16_t poiCount;
+    uint32_t firstPoi;
+    uint32_t seed;                         // orbit layout
+};
+
+struct PoiRec {
+    uint32_t name;
+    uint16_t nameLen;
+    uint8_t type;                          // 0 planet, 1 station, 2 outpost
+    uint8_t reserved;
+    uint32_t seed;                         // market
+    int8_t priceMod[MAX_GOODS];            // percent on the generated base price
+};
+
+static_assert(sizeof(Header) == 64, "catalog header layout");
+static_assert(sizeof(Pos) == 8 && sizeof(SystemRec) == 16 && sizeof(PoiRec) == 20, "catalog record layout");
+
+// A read-only mapped catalog.
+class Catalog {
+public:
+    Catalog() = default;
+    ~Catalog();
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    // Maps and validates `path`; the catalog must use `sectorSize`.
+    bool open(const std::string& path, uint32_t sectorSize, std::string& err);
+    void close();
+
+    const Header& header() const { return *h_; }
+    const Pos* positions() const { return pos_; }
+    const uint32_t* sectorStart() const { return sectorStart_; }
+    const uint32_t* sectorIds() const { return sectorIds_; }
+    const uint32_t* localIndex() const { return localIndex_; }
+    const SystemRec* systems() const { return systems_; }
+    const PoiRec* pois() const { return pois_; }
+    std::wstring name(uint32_t offset, uint16_t len) const;
+
+private:
+    bool validate(uint64_t size, uint32_t sectorSize, std::string& err);
+
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+    const uint8_t* view_ = nullptr;
+    const Header* h_ = nullptr;
+    const Pos* pos_ = nullptr;
+    const uint32_t* sectorStart_ = nullptr;
+    const uint32_t* sectorIds_ = nullptr;
+    const uint32_t* localIndex_ = nullptr;
+    const SystemRec* systems_ = nullptr;
+    const PoiRec* pois_ = nullptr;
+    const uint16_t* names_ = nullptr;
+};
+
+// Collects systems and POIs in id order and writes a catalog file.
+class Builder {
+public:
+    void addSystem(const std::wstring& name, int gx, int gy, uint32_t seed);
+    void addPoi(const std::wstring& name, uint8_t type, uint32_t seed, const int8_t* priceMod = nullptr);
+
+    void setExtent(uint32_t width, uint32_t height) { width_ = width; height_ = height; }
+
+    uint32_t systemCount() const { return (uint32_t)pos_.size(); }
+    bool write(const std::string& path, uint32_t sectorSize, std::string& err) const;
+
+private:
+    uint32_t addName(const std::wstring& name, uint16_t& len, bool share);
+
+    uint32_t width_ = 1, height_ = 1;
+    std::vector<Pos> pos_;
+    std::vector<SystemRec> systems_;
+    std::vector<PoiRec> pois_;
+    std::vector<uint16_t> names_;
+    std::unordered_map<std::wstring, uint32_t> shared_;   // POI names repeat; stored once
+};
+
+uint32_t defaultSystemSeed(uint32_t id);
+
+// Text source (see above) to catalog file. Errors name the line.
+bool convertCsv(const std::string& csvPath, const std::string& outPath, uint32_t sectorSize, std::string& err);
+
+} // namespace catalog
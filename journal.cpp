@@ -0,0 +1,438 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "journal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+
+namespace journal {
+
+static const char MAGIC[4] = { 'S', 'T', 'J', 'L' };
+static const uint8_t VERSION = 1;
+static const uint64_t HEADER = 5;
+static const size_t TAIL_KEEP = 64 * 1024;   // flushed bytes kept in memory before remapping
+
+static void putVarint(std::vector<uint8_t>& b, uint64_t v) {
+    while (v >= 0x80) { b.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+    b.push_back((uint8_t)v);
+}
+
+static void put32(std::vector<uint8_t>& b, uint32_t v) {
+    for (int i = 0; i < 4; i++) b.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+namespace {
+// One record at a time out of a contiguous byte range.
+struct Decoder {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) { ok = false; return 0; }
+            uint8_t c = *p++;
+            v |= (uint64_t)(c & 0x7F) << shift;
+            if (!(c & 0x80)) break;
+        }
+        return v;
+    }
+
+    // Kind and week always; the text only into a non-null `text`.
+    bool record(Kind& kind, uint32_t& week, std::wstring* text) {
+        if (p >= end) return ok = false;
+        kind = (Kind)*p++;
+        week = (uint32_t)varint();
+        uint64_t n = varint();
+        if (text) text->clear();
+        for (uint64_t i = 0; i < n && ok; i++) {
+            uint64_t c = varint();
+            if (text) text->push_back((wchar_t)c);
+        }
+        return ok;
+    }
+};
+}
+
+bool Filter::matches(const Entry& e) const {
+    if (!(kinds & (1u << (int)e.kind))) return false;
+    if (text.empty()) return true;
+    auto eq = [](wchar_t a, wchar_t b) { return std::towlower(a) == std::towlower(b); };
+    return std::search(e.text.begin(), e.text.end(), text.begin(), text.end(), eq) != e.text.end();
+}
+
+// ---------------- Journal ----------------
+Journal::~Journal() { close(); }
+
+bool Journal::open(const std::string& path) {
+    close();
+    path_ = path;
+    if (!load()) {
+        count_ = 0;
+        bytes_ = HEADER;
+        blocks_.clear();
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) return false;
+        std::fwrite(MAGIC, 1, 4, f);
+        std::fputc(VERSION, f);
+        if (std::fclose(f) != 0) return false;
+    }
+    sessionStart_ = count_;
+
+    // Older records are read through the mapping, so it must cover them.
+    if (bytes_ > HEADER && !remap(bytes_)) { count_ = 0; blocks_.clear(); return false; }
+    f_ = std::fopen(path.c_str(), "ab");
+    idx_ = f_ ? std::fopen((path + ".idx").c_str(), "wb") : nullptr;
+    if (!idx_) {
+        if (f_) std::fclose(f_);
+        f_ = nullptr;
+        unmap();
+        count_ = 0;
+        blocks_.clear();
+        return false;
+    }
+    // The index is rewritten from the whole blocks; the open one follows when full.
+    std::vector<uint8_t> idx;
+    for (uint64_t b = 0; b < count_ / BLOCK; b++) putBlock(idx, blocks_[(size_t)b]);
+    if (!idx.empty()) std::fwrite(idx.data(), 1, idx.size(), idx_);
+    std::fflush(idx_);
+
+    tailBase_ = bytes_;
+    tail_.clear();
+    flushed_.store(bytes_);
+    stop_ = false;
+    writer_ = std::thread([this, start = bytes_]() { writerLoop(start); });
+    return true;
+}
+
+// Picks up the journal already at path_: whole blocks from its index, then
+// the records after them decoded from the data file itself (the index is a
+// block behind, or more after a crash). A torn last record is cut off.
+// False if there is no journal there to continue.
+bool Journal::load() {
+    count_ = 0;
+    bytes_ = HEADER;
+    blocks_.clear();
+
+    HANDLE file = CreateFileA(path_.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE || !file) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)HEADER) { CloseHandle(file); return false; }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const uint8_t* view = mapping ? (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    uint64_t total = (uint64_t)size.QuadPart;
+    bool ok = view && std::memcmp(view, MAGIC, 4) == 0 && view[4] == VERSION;
+
+    if (ok) {
+        if (FILE* f = std::fopen((path_ + ".idx").c_str(), "rb")) {
+            uint8_t e[20];
+            while (std::fread(e, 1, sizeof e, f) == sizeof e) {
+                Block b;
+                for (int i = 0; i < 8; i++) b.offset |= (uint64_t)e[i] << (8 * i);
+                b.firstWeek = get32(e + 8);
+                b.lastWeek = get32(e + 12);
+                b.kinds = get32(e + 16);
+                if (b.offset < (blocks_.empty() ? HEADER : blocks_.back().offset + 1) || b.offset >= total) break;
+                blocks_.push_back(b);
+            }
+            std::fclose(f);
+        }
+        // The last entry may be close()'s for a part block: decode from there.
+        if (!blocks_.empty()) { bytes_ = blocks_.back().offset; blocks_.pop_back(); }
+        count_ = (uint64_t)blocks_.size() * BLOCK;
+
+        Decoder d{ view + bytes_, view + total };
+        Kind kind;
+        uint32_t week;
+        while (d.record(kind, week, nullptr) && kind < Kind::COUNT) {
+            note(week, kind);
+            bytes_ = (uint64_t)(d.p - view);
+        }
+    }
+    if (view) UnmapViewOfFile(view);
+    if (mapping) CloseHandle(mapping);
+    if (ok && bytes_ < total) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)bytes_;
+        ok = SetFilePointerEx(file, end, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+    }
+    CloseHandle(file);
+    return ok;
+}
+
+void Journal::close() {
+    if (!f_) return;
+    // The open block gets its index entry too, so the index covers every record.
+    if (count_ % BLOCK) {
+        std::lock_guard<std::mutex> lk(mu_);
+        putBlock(queuedIdx_, blocks_.back());
+    }
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+    unmap();
+    std::fclose(f_);
+    std::fclose(idx_);
+    f_ = idx_ = nullptr;
+    count_ = 0;
+    blocks_.clear();
+    tail_.clear();
+}
+
+void Journal::writerLoop(uint64_t written) {
+    for (;;) {
+        std::vector<uint8_t> data, idx;
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [this]() { return stop_ || !queued_.empty() || !queuedIdx_.empty(); });
+            data.swap(queued_);
+            idx.swap(queuedIdx_);
+            stop = stop_;
+        }
+        if (data.empty() && idx.empty() && stop) return;
+        if (!data.empty()) std::fwrite(data.data(), 1, data.size(), f_);
+        if (!idx.empty()) std::fwrite(idx.data(), 1, idx.size(), idx_);
+        std::fflush(f_);
+        std::fflush(idx_);
+        written += data.size();
+        flushed_.store(written, std::memory_order_release);
+    }
+}
+
+void Journal::putBlock(std::vector<uint8_t>& out, const Block& b) {
+    for (int i = 0; i < 8; i++) out.push_back((uint8_t)(b.offset >> (8 * i)));
+    put32(out, b.firstWeek);
+    put32(out, b.lastWeek);
+    put32(out, b.kinds);
+}
+
+// Counts a record starting at bytes_ into its block.
+void Journal::note(uint32_t week, Kind kind) {
+    if (count_ % BLOCK == 0) {
+        Block b;
+        b.offset = bytes_;
+        b.firstWeek = week;
+        blocks_.push_back(b);
+    }
+    Block& b = blocks_.back();
+    b.lastWeek = week;
+    b.kinds |= 1u << (int)kind;
+    count_++;
+}
+
+void Journal::append(uint32_t week, Kind kind, const std::wstring& text) {
+    if (!f_) return;
+    note(week, kind);
+
+    size_t start = tail_.size();
+    tail_.push_back((uint8_t)kind);
+    putVarint(tail_, week);
+    putVarint(tail_, text.size());
+    for (wchar_t c : text) putVarint(tail_, (uint32_t)c);
+    bytes_ += tail_.size() - start;
+
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        queued_.insert(queued_.end(), tail_.begin() + start, tail_.end());
+        if (count_ % BLOCK == 0) putBlock(queuedIdx_, blocks_.back());
+    }
+    cv_.notify_one();
+    settle();
+}
+
+// Once enough of the tail is on disk, map it and stop holding it in memory.
+// A failed mapping just keeps the bytes in the tail.
+void Journal::settle() const {
+    uint64_t fl = flushed_.load(std::memory_order_acquire);
+    if (fl > mapped_ && fl - tailBase_ >= TAIL_KEEP) remap(fl);
+    if (mapped_ > tailBase_) {
+        tail_.erase(tail_.begin(), tail_.begin() + (size_t)(mapped_ - tailBase_));
+        tailBase_ = mapped_;
+    }
+}
+
+// Maps the whole file as it is now; the first `size` bytes are whole,
+// flushed records. The old view stays in place if this fails.
+bool Journal::remap(uint64_t size) const {
+    HANDLE file = CreateFileA(path_.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE || !file) return false;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    unmap();
+    file_ = file;
+    mapping_ = mapping;
+    view_ = (const uint8_t*)view;
+    mapped_ = size;
+    return true;
+}
+
+void Journal::unmap() const {
+    if (view_) UnmapViewOfFile(view_);
+    if (mapping_) CloseHandle((HANDLE)mapping_);
+    if (file_) CloseHandle((HANDLE)file_);
+    view_ = nullptr;
+    mapping_ = file_ = nullptr;
+    mapped_ = 0;
+}
+
+const uint8_t* Journal::bytesAt(uint64_t offset, const uint8_t*& end) const {
+    if (offset >= tailBase_) {
+        end = tail_.data() + tail_.size();
+        return tail_.data() + (offset - tailBase_);
+    }
+    end = view_ + mapped_;
+    return view_ + offset;   // below tailBase_ is always mapped, see settle()
+}
+
+bool Journal::read(uint64_t i, Entry& out) const {
+    if (i >= count_) return false;
+    settle();
+    const Block& b = blocks_[(size_t)(i / BLOCK)];
+    uint64_t off = b.offset;
+    for (uint64_t k = i - i % BLOCK; k <= i; k++) {
+        const uint8_t* end;
+        const uint8_t* p = bytesAt(off, end);
+        Decoder d{ p, end };
+        if (!d.record(out.kind, out.week, k == i ? &out.text : nullptr)) return false;
+        off += (uint64_t)(d.p - p);
+    }
+    return true;
+}
+
+uint64_t Journal::findBack(uint64_t before, const Filter& f) const {
+    before = std::min(before, count_);
+    settle();
+    Entry e;
+    while (before > 0) {
+        uint64_t first = (before - 1) - (before - 1) % BLOCK;
+        const Block& b = blocks_[(size_t)(first / BLOCK)];
+        uint64_t found = NONE;
+        if (b.kinds & f.kinds) {
+            uint64_t off = b.offset;
+            for (uint64_t k = first; k < before; k++) {
+                const uint8_t* end;
+                const uint8_t* p = bytesAt(off, end);
+                Decoder d{ p, end };
+                if (!d.record(e.kind, e.week, f.text.empty() ? nullptr : &e.text)) return NONE;
+                if (f.matches(e)) found = k;
+                off += (uint64_t)(d.p - p);
+            }
+        }
+        if (found != NONE) return found;
+        before = first;
+    }
+    return NONE;
+}
+
+uint64_t Journal::findForward(uint64_t from, const Filter& f) const {
+    settle();
+    Entry e;
+    while (from < count_) {
+        uint64_t first = from - from % BLOCK;
+        uint64_t next = std::min(first + BLOCK, count_);
+        const Block& b = blocks_[(size_t)(first / BLOCK)];
+        if (b.kinds & f.kinds) {
+            uint64_t off = b.offset;
+            for (uint64_t k = first; k < next; k++) {
+                const uint8_t* end;
+                const uint8_t* p = bytesAt(off, end);
+                Decoder d{ p, end };
+                if (!d.record(e.kind, e.week, k >= from && !f.text.empty() ? &e.text : nullptr)) return NONE;
+                if (k >= from && f.matches(e)) return k;
+                off += (uint64_t)(d.p - p);
+            }
+        }
+        from = next;
+    }
+    return NONE;
+}
+
+uint64_t Journal::firstAtWeek(uint32_t week) const {
+    auto it = std::partition_point(blocks_.begin() + (size_t)(sessionStart_ / BLOCK), blocks_.end(),
+                                   [week](const Block& b) { return b.lastWeek < week; });
+    if (it == blocks_.end()) return count_;
+    uint64_t i = std::max((uint64_t)(it - blocks_.begin()) * BLOCK, sessionStart_);
+    Entry e;
+    while (read(i, e) && e.week < week) i++;   // at most one block
+    return i;
+}
+
+// ---------------- Search ----------------
+void Search::reset(const Filter& f) {
+    f_ = f;
+    fresh_ = true;
+    low_ = high_ = 0;
+    newer_.clear();
+    older_.clear();
+}
+
+uint64_t Search::sync(const Journal& J) {
+    if (fresh_) {
+        fresh_ = false;
+        low_ = high_ = J.size();
+        return 0;
+    }
+    uint64_t added = 0;
+    if (f_.any()) {
+        added = J.size() - high_;
+    } else {
+        for (uint64_t i = J.findForward(high_, f_); i != Journal::NONE; i = J.findForward(i + 1, f_)) {
+            newer_.push_back(i);
+            added++;
+        }
+    }
+    high_ = J.size();
+    return added;
+}
+
+bool Search::extend(const Journal& J) {
+    if (low_ == 0) return false;
+    uint64_t i = J.findBack(low_, f_);
+    if (i == Journal::NONE) { low_ = 0; return false; }
+    older_.push_back(i);
+    low_ = i;
+    return true;
+}
+
+bool Search::at(const Journal& J, uint64_t rank, uint64_t& index) {
+    if (f_.any()) {
+        if (rank >= high_) return false;
+        index = high_ - 1 - rank;
+        return true;
+    }
+    if (rank < newer_.size()) { index = newer_[newer_.size() - 1 - rank]; return true; }
+    while (older_.size() <= rank - newer_.size())
+        if (!extend(J)) return false;
+    index = older_[(size_t)(rank - newer_.size())];
+    return true;
+}
+
+uint64_t Search::rankBefore(const Journal& J, uint64_t before) {
+    if (f_.any()) return high_ - std::min(before, high_);
+    auto it = std::lower_bound(newer_.begin(), newer_.end(), before);
+    if (it != newer_.begin()) return (uint64_t)(newer_.end() - it);
+    while (older_.empty() || older_.back() >= before)
+        if (!extend(J)) break;
+    auto jt = std::partition_point(older_.begin(), older_.end(), [before](uint64_t i) { return i >= before; });
+    return newer_.size() + (uint64_t)(jt - older_.begin());
+}
+
+} // namespace journal
@@ -0,0 +1,144 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// On-disk event journal: every log line the game ever printed.
+//
+// Data file (little endian):
+//   "STJL" u8 version
+//   records:  u8 kind  varint week  varint length  length x varint char
+// Index file (<data>.idx), one entry per BLOCK records:
+//   u64 offset of the block's first record  u32 first week  u32 last week
+//   u32 kinds present (bit per Kind)
+//
+// append() only encodes into memory; a writer thread does the fwrite and
+// fflush, so the caller never waits on the disk. Reads decode from a
+// read-only mapping of the flushed part of the data file (only the pages a
+// read touches are faulted in) and from memory for the rest. The index lets
+// filters skip whole blocks by kind and seek by week without touching the
+// data file.
+//
+// open() continues the journal already on disk, so history spans sessions.
+// Weeks restart with each game; firstAtWeek() looks only at records
+// appended since the last open().
+
+namespace journal {
+
+enum class Kind : uint8_t { Info, Trade, Travel, Mission, Fleet, COUNT };
+
+constexpr uint32_t ALL_KINDS = (1u << (int)Kind::COUNT) - 1;
+constexpr uint32_t BLOCK = 64;                    // records per index entry
+
+struct Entry {
+    uint32_t week = 0;
+    Kind kind = Kind::Info;
+    std::wstring text;
+};
+
+struct Filter {
+    uint32_t kinds = ALL_KINDS;     // bit per Kind
+    std::wstring text;              // case-insensitive substring, empty = any
+
+    bool any() const { return kinds == ALL_KINDS && text.empty(); }
+    bool matches(const Entry& e) const;
+};
+
+class Journal {
+public:
+    static const uint64_t NONE = ~(uint64_t)0;
+
+    Journal() = default;
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    bool open(const std::string& path);   // appends to any journal there; starts the writer
+    void close();                         // drains the writer
+    bool isOpen() const { return f_ != nullptr; }
+
+    void append(uint32_t week, Kind kind, const std::wstring& text);
+
+    uint64_t size() const { return count_; }
+    bool read(uint64_t i, Entry& out) const;          // i: 0 = oldest
+
+    // Newest match below `before` / oldest match at or above `from`, or NONE.
+    uint64_t findBack(uint64_t before, const Filter& f) const;
+    uint64_t findForward(uint64_t from, const Filter& f) const;
+
+    // First record since open() written in `week` or later (size() if none).
+    uint64_t firstAtWeek(uint32_t week) const;
+
+private:
+    struct Block {
+        uint64_t offset = 0;
+        uint32_t firstWeek = 0, lastWeek = 0;
+        uint32_t kinds = 0;
+    };
+
+    bool load();                          // adopts the journal at path_, see open()
+    void note(uint32_t week, Kind kind);  // counts a record into blocks_
+    static void putBlock(std::vector<uint8_t>& out, const Block& b);
+
+    // Contiguous bytes holding the record at `offset`, up to `end`.
+    const uint8_t* bytesAt(uint64_t offset, const uint8_t*& end) const;
+    void settle() const;                  // maps flushed data, drops it from tail_
+    bool remap(uint64_t size) const;
+    void unmap() const;
+    void writerLoop(uint64_t written);
+
+    FILE* f_ = nullptr;
+    FILE* idx_ = nullptr;
+    std::string path_;
+    uint64_t count_ = 0;
+    uint64_t sessionStart_ = 0;           // count_ when open() returned
+    uint64_t bytes_ = 0;                  // data file size once everything is written
+    std::vector<Block> blocks_;           // all blocks, including the open one
+
+    // Records not yet known to be flushed, starting at tailBase_.
+    mutable std::vector<uint8_t> tail_;
+    mutable uint64_t tailBase_ = 0;
+
+    // Read-only view of the data file's first mapped_ bytes.
+    mutable void* file_ = nullptr;
+    mutable void* mapping_ = nullptr;
+    mutable const uint8_t* view_ = nullptr;
+    mutable uint64_t mapped_ = 0;
+
+    // Writer thread: queued bytes for each file, and how much is flushed.
+    std::thread writer_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::vector<uint8_t> queued_, queuedIdx_;   // guarded by mu_
+    bool stop_ = false;                         // guarded by mu_
+    std::atomic<uint64_t> flushed_{ 0 };
+};
+
+// Matches of one filter, newest first, found lazily: sync() scans records
+// appended since the last call, and older ones are scanned backward only as
+// far as a caller has asked for. Rank 0 is the newest match.
+class Search {
+public:
+    void reset(const Filter& f);
+    const Filter& filter() const { return f_; }
+
+    uint64_t sync(const Journal& J);                   // new matches at the top
+    bool at(const Journal& J, uint64_t rank, uint64_t& index);
+    uint64_t rankBefore(const Journal& J, uint64_t before);   // newest match below `before`
+
+private:
+    bool extend(const Journal& J);        // one more older match; false at the start
+
+    Filter f_;
+    bool fresh_ = true;                   // first sync() starts at the newest record
+    uint64_t low_ = 0, high_ = 0;         // records [low_, high_) have been scanned
+    std::vector<uint64_t> newer_;         // matches found by sync(), ascending
+    std::vector<uint64_t> older_;         // matches found by extend(), descending
+};
+
+} // namespace journal
@@ -1,4 +1,11 @@
 #include "termui.h"
+#include "trace.h"
+#include "perf.h"
+#include "replay.h"
+#include "rng.h"
+#include "net.h"
+#include "journal.h"
+#include "catalog.h"
 
 #include <string>
 #include <vector>
@@ -8,10 +15,38 @@
 #include <cmath>
 #include <algorithm>
 #include <cstdint>
+#include <climits>
 #include <ctime>
 #include <cstdlib>
+#include <cctype>
 #include <iostream>
 #include <random>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <set>
+#include <map>
+#include <list>
+#include <functional>
+#include <array>
+#include <tuple>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Galaxy map extent in coordinates (built-in universe)
+static constexpr int GALAXY_W = 120;
+static constexpr int GALAXY_H = 80;
+
+// POIs per system: three, a few more in generated systems, up to MAX_POIS
+// in the one-in-POI_HUB_ODDS hubs. The system map grows with the count.
+static constexpr int MAX_POIS = 200;
+static_assert(MAX_POIS == (int)catalog::MAX_POIS, "catalog files are checked against MAX_POIS");
+static constexpr uint32_t POI_HUB_ODDS = 128;
 
 static constexpr int GALAXY_JUMP_RANGE = 3;
 static constexpr int SYSTEM_JUMP_RANGE = 6;
@@ -19,6 +54,8 @@ static constexpr int SYSTEM_JUMP_RANGE = 6;
 // Balance knobs (tweak later)
 static constexpr int GALAXY_FUEL_PER_JUMP = 3;
 static constexpr int SYSTEM_FUEL_PER_JUMP = 1;
+static constexpr int RUMOR_JUMPS = 3;            // market rumors cover this many jumps
+static constexpr int ARBITRAGE_JUMPS = 3;        // trade index pairs markets up to this many jumps apart
 
 // Chebyshev distance = max(|dx|, |dy|) (fits square jump range)
 static int chebyshev(int x0,int y0,int x1,int y1){
@@ -52,19 +89,37 @@ static std::wstring ellipsize(const std::wstring& s, int maxw) {
 }
 static int manhattan(int x0,int y0,int x1,int y1){ return std::abs(x0-x1)+std::abs(y0-y1); }
 
+// Index of the lowest set bit; v must not be 0.
+static int ctz64(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (int)i;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
 // ---------------- Time ----------------
+// Stored as an absolute week count; year/month/week are derived from it, so
+// advancing by any number of weeks is O(1).
 struct GameDate {
-    int year=2336, month=0, week=0; // Jan 2336
-    void advanceWeeks(int n) {
-        for(int i=0;i<n;i++){
-            week++;
-            if(week>=4){ week=0; month++; if(month>=12){ month=0; year++; } }
-        }
-    }
+    static constexpr int START_YEAR = 2336;
+    static constexpr int WEEKS_PER_MONTH = 4;
+    static constexpr int WEEKS_PER_YEAR = WEEKS_PER_MONTH * 12;
+
+    int weeks = 0; // since Jan 2336, W1
+
+    int year()  const { return START_YEAR + weeks / WEEKS_PER_YEAR; }
+    int month() const { return (weeks / WEEKS_PER_MONTH) % 12; }
+    int week()  const { return weeks % WEEKS_PER_MONTH; }
+
+    void advanceWeeks(int n) { weeks += n; }
+
     std::wstring toString() const {
         static const wchar_t* M[12]={L"Jan",L"Feb",L"Mar",L"Apr",L"May",L"Jun",L"Jul",L"Aug",L"Sep",L"Oct",L"Nov",L"Dec"};
         std::wstringstream oss;
-        oss<<M[month]<<L" "<<year<<L"  W"<<(week+1)<<L"/4";
+        oss<<M[month()]<<L" "<<year()<<L"  W"<<(week()+1)<<L"/"<<WEEKS_PER_MONTH;
         return oss.str();
     }
 };
@@ -73,10 +128,227 @@ struct GameDate {
 enum class Good : int { Food, Water, Ore, Fuel, Electronics, Meds, COUNT };
 static const wchar_t* GOOD_NAME[] = { L"Food", L"Water", L"Ore", L"Fuel", L"Electronics", L"Meds" };
 
+// Trading moves prices: a market quotes its base price plus 1 CR for every
+// TRADE_PRICE_STEP units of net buying (minus for net selling), never below 1.
+// Every unit is charged the quote at the pressure it was traded at, so an
+// order costs the same whether it is placed in one go or unit by unit, and
+// buying then selling the same units is a wash.
+static constexpr int TRADE_PRICE_STEP = 10;
+
+static long long floorDivLL(long long a, long long b) {
+    long long q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+// sum of floor(x / step) for x in [a, b), closed form
+static long long sumFloorDiv(long long a, long long b, long long step) {
+    auto F = [&](long long x) { long long t = x / step, r = x % step; return step * t * (t - 1) / 2 + t * r; };
+    long long k = (a < 0) ? (-a + step - 1) / step : 0;  // shift into x >= 0
+    return F(b + k * step) - F(a + k * step) - k * (b - a);
+}
+
 struct Market {
-    int price[(int)Good::COUNT]{};
+    int price[(int)Good::COUNT]{};     // base price
     int stock[(int)Good::COUNT]{};
-    int priceOf(Good g) const { return price[(int)g]; }
+    int pressure[(int)Good::COUNT]{};  // net units bought (+) / sold (-) here
+    uint32_t version = 0;              // bumped on every write, see writeMarket
+
+    static int quote(int base, long long pressure) {
+        return (int)std::max(1LL, base + floorDivLL(pressure, TRADE_PRICE_STEP));
+    }
+    int priceOf(Good g) const { return quote(price[(int)g], pressure[(int)g]); }
+
+    // Total of the quotes while pressure runs over [from, to).
+    long long costOver(Good g, long long from, long long to) const {
+        long long base = price[(int)g];
+        long long floorStart = (1 - base) * TRADE_PRICE_STEP;   // first pressure quoted above 1
+        long long c = std::max(from, std::min(to, floorStart));
+        return (c - from) + base * (to - c) + sumFloorDiv(c, to, TRADE_PRICE_STEP);
+    }
+    long long buyCost(Good g, int units) const  { long long q = pressure[(int)g]; return costOver(g, q, q + units); }
+    long long sellValue(Good g, int units) const { long long q = pressure[(int)g]; return costOver(g, q - units, q); }
+};
+
+// ---------------- Price history ----------------
+// Price and stock history for one (system, POI, good). Markets only move when
+// traded, so a series carries the value in effect forward lazily: whenever it
+// is touched, every week since the last touch is closed with that value.
+//
+// Storage is fixed per series: the last 16 weekly samples as int16 deltas from
+// the oldest one, then 12 monthly and 8 yearly min/max/avg rollups. Values are
+// clamped to 0..32767 so any delta fits.
+struct PriceRollup { uint16_t minPrice = 0, maxPrice = 0, avgPrice = 0, avgStock = 0; };
+
+struct PriceStats { int min = 0, max = 0, avg = 0, weeks = 0; };
+
+class PriceSeries {
+public:
+    static constexpr int WEEKS = 16, MONTHS = 12, YEARS = 8;
+
+    PriceSeries(int week, int price, int stock) : week_(week), price_(clampValue(price)), stock_(clampValue(stock)) {}
+
+    // Closes every week before `week` with the value in effect.
+    void advanceTo(int week) {
+        if (week <= week_) return;
+        if (week - week_ > SPAN_WEEKS) {
+            // Longer than every tier holds: only the last SPAN_WEEKS can show.
+            week_ = (week - SPAN_WEEKS) / GameDate::WEEKS_PER_YEAR * GameDate::WEEKS_PER_YEAR;
+            monthAcc_ = Acc{}; yearAcc_ = Acc{};
+        }
+        for (; week_ < week; week_++) closeWeek(week_);
+    }
+    // The value from `week` on.
+    void set(int week, int price, int stock) {
+        advanceTo(week);
+        price_ = clampValue(price);
+        stock_ = clampValue(stock);
+    }
+
+    int price() const { return price_; }
+    int stock() const { return stock_; }
+
+    // Closed samples, oldest first.
+    int weekCount() const  { return wCount_; }
+    int monthCount() const { return mCount_; }
+    int yearCount() const  { return yCount_; }
+    int weekPrice(int i) const { return anchorPrice_ + prefix(dPrice_, i); }
+    int weekStock(int i) const { return anchorStock_ + prefix(dStock_, i); }
+    const PriceRollup& month(int i) const { return months_[(mHead_ + i) % MONTHS]; }
+    const PriceRollup& year(int i) const  { return years_[(yHead_ + i) % YEARS]; }
+
+    // Price over the last `weeks` closed weeks, at the finest tier that covers
+    // them; coarser tiers round the window up to whole months or years.
+    PriceStats stats(int weeks) const {
+        PriceStats s{};
+        long long sum = 0;
+        auto add = [&](int lo, int hi, long long total, int n) {
+            if (n <= 0) return;
+            s.min = s.weeks ? std::min(s.min, lo) : lo;
+            s.max = s.weeks ? std::max(s.max, hi) : hi;
+            sum += total; s.weeks += n;
+        };
+        if (weeks <= wCount_) {
+            for (int i = wCount_ - weeks; i < wCount_; i++) { int p = weekPrice(i); add(p, p, p, 1); }
+        } else if (weeks <= monthAcc_.n + mCount_ * GameDate::WEEKS_PER_MONTH || yCount_ == 0) {
+            add(monthAcc_.minPrice, monthAcc_.maxPrice, monthAcc_.sumPrice, monthAcc_.n);
+            for (int i = mCount_ - 1; i >= 0 && s.weeks < weeks; i--) {
+                const PriceRollup& m = month(i);
+                add(m.minPrice, m.maxPrice, (long long)m.avgPrice * GameDate::WEEKS_PER_MONTH, GameDate::WEEKS_PER_MONTH);
+            }
+        } else {
+            add(yearAcc_.minPrice, yearAcc_.maxPrice, yearAcc_.sumPrice, yearAcc_.n);
+            for (int i = yCount_ - 1; i >= 0 && s.weeks < weeks; i--) {
+                const PriceRollup& y = year(i);
+                add(y.minPrice, y.maxPrice, (long long)y.avgPrice * GameDate::WEEKS_PER_YEAR, GameDate::WEEKS_PER_YEAR);
+            }
+        }
+        if (s.weeks == 0) return PriceStats{ price_, price_, price_, 0 };
+        s.avg = (int)(sum / s.weeks);
+        return s;
+    }
+
+private:
+    static constexpr int SPAN_WEEKS = GameDate::WEEKS_PER_YEAR * (YEARS + 1);
+
+    struct Acc {
+        uint16_t minPrice = 0, maxPrice = 0, n = 0;
+        uint32_t sumPrice = 0, sumStock = 0;
+
+        void add(uint16_t p, uint16_t s) {
+            minPrice = n ? std::min(minPrice, p) : p;
+            maxPrice = n ? std::max(maxPrice, p) : p;
+            sumPrice += p; sumStock += s; n++;
+        }
+        PriceRollup rollup() const {
+            return { minPrice, maxPrice, (uint16_t)(sumPrice / n), (uint16_t)(sumStock / n) };
+        }
+    };
+
+    static uint16_t clampValue(int v) { return (uint16_t)std::max(0, std::min(v, 32767)); }
+
+    // Sum of the deltas of samples 1..i (sample 0 is the anchor).
+    int prefix(const int16_t* d, int i) const {
+        int v = 0;
+        for (int k = 1; k <= i; k++) v += d[(wHead_ + k) % WEEKS];
+        return v;
+    }
+
+    void closeWeek(int week) {
+        if (wCount_ == 0) {
+            anchorPrice_ = price_; anchorStock_ = stock_; wCount_ = 1;
+        } else {
+            if (wCount_ == WEEKS) {   // drop the oldest: the next one becomes the anchor
+                wHead_ = (wHead_ + 1) % WEEKS;
+                anchorPrice_ += dPrice_[wHead_]; anchorStock_ += dStock_[wHead_];
+                wCount_--;
+            }
+            int slot = (wHead_ + wCount_) % WEEKS;
+            dPrice_[slot] = (int16_t)(price_ - lastPrice_);
+            dStock_[slot] = (int16_t)(stock_ - lastStock_);
+            wCount_++;
+        }
+        lastPrice_ = price_; lastStock_ = stock_;
+
+        monthAcc_.add(price_, stock_);
+        yearAcc_.add(price_, stock_);
+        if ((week + 1) % GameDate::WEEKS_PER_MONTH == 0) {
+            push(months_, mHead_, mCount_, MONTHS, monthAcc_.rollup());
+            monthAcc_ = Acc{};
+        }
+        if ((week + 1) % GameDate::WEEKS_PER_YEAR == 0) {
+            push(years_, yHead_, yCount_, YEARS, yearAcc_.rollup());
+            yearAcc_ = Acc{};
+        }
+    }
+
+    static void push(PriceRollup* ring, uint8_t& head, uint8_t& count, int cap, const PriceRollup& r) {
+        if (count == cap) { ring[head] = r; head = (uint8_t)((head + 1) % cap); }
+        else ring[(head + count++) % cap] = r;
+    }
+
+    int32_t week_ = 0;                        // first week not yet closed
+    uint16_t price_ = 0, stock_ = 0;          // value in effect
+    uint16_t lastPrice_ = 0, lastStock_ = 0;  // newest weekly sample
+    uint16_t anchorPrice_ = 0, anchorStock_ = 0;
+    int16_t dPrice_[WEEKS]{}, dStock_[WEEKS]{};
+    uint8_t wHead_ = 0, wCount_ = 0, mHead_ = 0, mCount_ = 0, yHead_ = 0, yCount_ = 0;
+    Acc monthAcc_, yearAcc_;
+    PriceRollup months_[MONTHS], years_[YEARS];
+};
+
+// All price series, created on the first change to a market good. Untouched
+// markets have no series: their value has not moved since week 0.
+class PriceHistory {
+public:
+    void clear() { index_.clear(); series_.clear(); }
+    size_t size() const { return series_.size(); }
+    size_t bytes() const { return series_.capacity() * sizeof(PriceSeries) + index_.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void*)); }
+
+    // The market good moved from (price0, stock0) to (price, stock) in `week`.
+    void record(int system, int poi, Good g, int week, int price0, int stock0, int price, int stock) {
+        auto it = index_.find(key(system, poi, g));
+        if (it == index_.end()) {
+            it = index_.emplace(key(system, poi, g), (uint32_t)series_.size()).first;
+            series_.emplace_back(0, price0, stock0);
+        }
+        series_[it->second].set(week, price, stock);
+    }
+
+    // The series as of `week`; a flat one at the market's value if untouched.
+    PriceSeries at(int system, int poi, Good g, int week, const Market& m) const {
+        auto it = index_.find(key(system, poi, g));
+        PriceSeries s = (it != index_.end()) ? series_[it->second] : PriceSeries(0, m.priceOf(g), m.stock[(int)g]);
+        s.advanceTo(week);
+        return s;
+    }
+
+private:
+    static uint64_t key(int system, int poi, Good g) {
+        return ((uint64_t)(uint32_t)system << 16) | ((uint64_t)(poi & 0xFF) << 8) | (uint64_t)g;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> index_;
+    std::vector<PriceSeries> series_;
 };
 
 // ---------------- POIs ----------------
@@ -94,37 +366,628 @@ static std::wstring poiTypeNameW(PoiType t) {
 struct SystemPoi {
     std::wstring name;
     PoiType type;
-    int x=0, y=0;
+    int ring=0, phase=0;    // orbit: ring around the star, cell on it at week 0
     Market market;
 };
 
 struct StarSystem {
     std::wstring name;
     int gx=0, gy=0;
+    int size=0;             // system map is size x size, star in the middle
     std::vector<SystemPoi> pois;
+    uint32_t marketsVersion = 0;   // bumped with any of its markets' versions, so their sum
+};
+
+// ---------------- Galaxy sectors ----------------
+// The galaxy is split into SECTOR_SIZE x SECTOR_SIZE coordinate sectors. Only
+// a compact catalog (position of every system, system ids per sector) stays
+// resident; the systems themselves (names, POIs, markets) are generated per
+// sector on demand, cached, and evicted least-recently-used first once the
+// cache is over its memory budget. Markets that were traded at are saved on
+// eviction and put back when the sector is generated again.
+//
+// References returned by operator[] / mut() stay valid until the next
+// beginFrame(): sectors touched during a frame are never evicted inside it.
+// prefetch() queues sectors for a background thread to generate; they are
+// adopted by the main thread, which is the only one touching the cache.
+//
+// The catalog is either built from a position list or used in place from
+// arrays someone else owns (a mapped catalog file, see catalog.h).
+static constexpr int SECTOR_SIZE = 16;
+
+struct SystemPos { int gx = 0, gy = 0; };
+static_assert(sizeof(SystemPos) == sizeof(catalog::Pos), "catalog positions are used as SystemPos in place");
+
+// Read-only view of the catalog's positions, indexed by system id.
+struct SystemSpan {
+    const SystemPos* first = nullptr;
+    size_t count = 0;
+
+    const SystemPos* begin() const { return first; }
+    const SystemPos* end() const { return first + count; }
+    size_t size() const { return count; }
+    const SystemPos& operator[](size_t i) const { return first[i]; }
+};
+
+class Galaxy {
+public:
+    // Fills out[i] for ids[i]: everything except gx/gy, which come from the
+    // catalog. Called from the prefetch thread too, so it must be pure.
+    using Generator = std::function<void(const uint32_t* ids, size_t n, StarSystem* out)>;
+
+    static constexpr size_t DEFAULT_BUDGET = 64u << 20;
+
+    struct Stats {
+        size_t residentSectors = 0, residentBytes = 0, budgetBytes = 0;
+        uint64_t loads = 0, prefetched = 0, evictions = 0;
+    };
+
+    Galaxy() = default;
+    ~Galaxy() { stopWorker(); }
+    Galaxy(const Galaxy&) = delete;
+    Galaxy& operator=(const Galaxy&) = delete;
+
+    // A finished catalog index owned elsewhere; `backing` keeps it alive.
+    struct Index {
+        const SystemPos* pos = nullptr;
+        size_t count = 0;
+        const uint32_t* sectorStart = nullptr;   // CSR offsets, sectorsX * sectorsY + 1
+        const uint32_t* sectorIds = nullptr;
+        const uint32_t* localIndex = nullptr;
+        int sectorsX = 1, sectorsY = 1;
+    };
+
+    void reset(std::vector<SystemPos> catalog, Generator gen, size_t budgetBytes = DEFAULT_BUDGET) {
+        stopWorker();
+        impl_.reset(new Impl);
+        Impl& I = *impl_;
+        I.ownedPos = std::move(catalog);
+        I.gen = std::move(gen);
+        I.budget = budgetBytes;
+
+        for (const SystemPos& p : I.ownedPos) {
+            I.sectorsX = std::max(I.sectorsX, p.gx / SECTOR_SIZE + 1);
+            I.sectorsY = std::max(I.sectorsY, p.gy / SECTOR_SIZE + 1);
+        }
+        // CSR: ids of each sector, in id order
+        size_t nSectors = (size_t)I.sectorsX * I.sectorsY;
+        I.ownedStart.assign(nSectors + 1, 0);
+        for (const SystemPos& p : I.ownedPos) I.ownedStart[sectorOfPos(p.gx, p.gy) + 1]++;
+        for (size_t k = 0; k < nSectors; k++) I.ownedStart[k + 1] += I.ownedStart[k];
+        I.ownedIds.resize(I.ownedPos.size());
+        I.ownedLocal.resize(I.ownedPos.size());
+        std::vector<uint32_t> fill(I.ownedStart.begin(), I.ownedStart.end() - 1);
+        for (uint32_t id = 0; id < (uint32_t)I.ownedPos.size(); id++) {
+            int sec = sectorOfPos(I.ownedPos[id].gx, I.ownedPos[id].gy);
+            I.ownedLocal[id] = fill[sec] - I.ownedStart[sec];
+            I.ownedIds[fill[sec]++] = id;
+        }
+        I.pos = I.ownedPos.data();
+        I.count = I.ownedPos.size();
+        I.sectorStart = I.ownedStart.data();
+        I.sectorIds = I.ownedIds.data();
+        I.localIndex = I.ownedLocal.data();
+    }
+
+    // Uses `index` in place: nothing is copied or rebuilt.
+    void reset(const Index& index, std::shared_ptr<const void> backing, Generator gen, size_t budgetBytes = DEFAULT_BUDGET) {
+        stopWorker();
+        impl_.reset(new Impl);
+        Impl& I = *impl_;
+        I.backing = std::move(backing);
+        I.gen = std::move(gen);
+        I.budget = budgetBytes;
+        I.pos = index.pos;
+        I.count = index.count;
+        I.sectorStart = index.sectorStart;
+        I.sectorIds = index.sectorIds;
+        I.localIndex = index.localIndex;
+        I.sectorsX = index.sectorsX;
+        I.sectorsY = index.sectorsY;
+    }
+
+    int size() const { return impl_ ? (int)impl_->count : 0; }
+    SystemPos pos(int id) const { return impl_->pos[id]; }
+    SystemSpan catalog() const { return impl_ ? SystemSpan{ impl_->pos, impl_->count } : SystemSpan{}; }
+
+    // Sectors are row-major; these are the ids in one, in id order.
+    int sectorsX() const { return impl_ ? impl_->sectorsX : 0; }
+    int sectorsY() const { return impl_ ? impl_->sectorsY : 0; }
+    const uint32_t* sectorBegin(int sec) const { return impl_->sectorIds + impl_->sectorStart[sec]; }
+    const uint32_t* sectorEnd(int sec) const   { return impl_->sectorIds + impl_->sectorStart[sec + 1]; }
+
+    int systemAt(int gx, int gy) const {
+        if (!impl_ || gx < 0 || gy < 0) return -1;
+        const Impl& I = *impl_;
+        if (gx / SECTOR_SIZE >= I.sectorsX || gy / SECTOR_SIZE >= I.sectorsY) return -1;
+        int sec = sectorOfPos(gx, gy);
+        for (uint32_t k = I.sectorStart[sec]; k < I.sectorStart[sec + 1]; k++) {
+            const SystemPos& p = I.pos[I.sectorIds[k]];
+            if (p.gx == gx && p.gy == gy) return (int)I.sectorIds[k];
+        }
+        return -1;
+    }
+
+    const StarSystem& operator[](int id) const {
+        Sector& sec = touch(sectorOfPos(impl_->pos[id].gx, impl_->pos[id].gy));
+        return sec.systems[impl_->localIndex[id]];
+    }
+    StarSystem& mut(int id) {
+        Sector& sec = touch(sectorOfPos(impl_->pos[id].gx, impl_->pos[id].gy));
+        return sec.systems[impl_->localIndex[id]];
+    }
+    // Call after a write through mut() so eviction keeps the change.
+    void markDirty(int id) {
+        touch(sectorOfPos(impl_->pos[id].gx, impl_->pos[id].gy)).dirty = true;
+    }
+
+    // Ends the current frame: adopts prefetched sectors and evicts down to budget.
+    void beginFrame() {
+        if (!impl_) return;
+        Impl& I = *impl_;
+        I.epoch++;
+        adoptReady();
+        while (I.residentBytes > I.budget && !I.lru.empty()) {
+            Sector* victim = I.lru.back();
+            if (victim->epoch == I.epoch) break;
+            evict(*victim);
+        }
+    }
+
+    void prefetch(int gx, int gy, int radiusSectors) {
+        if (!impl_) return;
+        Impl& I = *impl_;
+        int cx = gx / SECTOR_SIZE, cy = gy / SECTOR_SIZE;
+        std::vector<int> want;
+        for (int sy = std::max(0, cy - radiusSectors); sy <= std::min(I.sectorsY - 1, cy + radiusSectors); sy++)
+            for (int sx = std::max(0, cx - radiusSectors); sx <= std::min(I.sectorsX - 1, cx + radiusSectors); sx++) {
+                int sec = sy * I.sectorsX + sx;
+                if (I.sectorStart[sec] != I.sectorStart[sec + 1] && !I.resident.count(sec)) want.push_back(sec);
+            }
+        if (want.empty()) return;
+
+        startWorker();
+        {
+            std::lock_guard<std::mutex> lk(I.mu);
+            for (int sec : want)
+                if (I.requested.insert(sec).second) I.requests.push_back(sec);
+        }
+        I.cv.notify_one();
+    }
+
+    void setBudget(size_t bytes) { if (impl_) impl_->budget = bytes; }
+
+    Stats stats() const {
+        Stats st{};
+        if (!impl_) return st;
+        st.residentSectors = impl_->resident.size();
+        st.residentBytes = impl_->residentBytes;
+        st.budgetBytes = impl_->budget;
+        st.loads = impl_->loads;
+        st.prefetched = impl_->prefetched;
+        st.evictions = impl_->evictions;
+        return st;
+    }
+
+    // Markets that differ from freshly generated ones (traded at), by id.
+    std::map<uint32_t, std::vector<Market>> modifiedMarkets() const {
+        std::map<uint32_t, std::vector<Market>> out;
+        if (!impl_) return out;
+        out = impl_->savedMarkets;
+        for (const auto& kv : impl_->resident) {
+            const Sector& sec = *kv.second;
+            if (!sec.dirty) continue;
+            for (size_t k = 0; k < sec.systems.size(); k++) out[sec.ids[k]] = marketsOf(sec.systems[k]);
+        }
+        return out;
+    }
+
+private:
+    struct Sector {
+        int index = -1;
+        std::vector<uint32_t> ids;
+        std::vector<StarSystem> systems;
+        size_t bytes = 0;
+        uint64_t epoch = 0;
+        bool dirty = false;
+        std::list<Sector*>::iterator lruPos;
+    };
+
+    struct Impl {
+        const SystemPos* pos = nullptr;
+        size_t count = 0;
+        const uint32_t* localIndex = nullptr;   // id -> position inside its sector
+        const uint32_t* sectorStart = nullptr;  // CSR offsets into sectorIds
+        const uint32_t* sectorIds = nullptr;
+        int sectorsX = 1, sectorsY = 1;
+        // what the pointers above point into: built here, or someone else's
+        std::vector<SystemPos> ownedPos;
+        std::vector<uint32_t> ownedLocal, ownedStart, ownedIds;
+        std::shared_ptr<const void> backing;
+        Generator gen;
+        size_t budget = DEFAULT_BUDGET;
+
+        // main thread only
+        std::unordered_map<int, std::unique_ptr<Sector>> resident;
+        std::list<Sector*> lru;             // front = most recently used
+        std::map<uint32_t, std::vector<Market>> savedMarkets;
+        size_t residentBytes = 0;
+        uint64_t epoch = 1;
+        uint64_t loads = 0, prefetched = 0, evictions = 0;
+
+        // shared with the prefetch thread
+        std::mutex mu;
+        std::condition_variable cv;
+        std::deque<int> requests;
+        std::set<int> requested;
+        std::vector<std::unique_ptr<Sector>> ready;
+        bool stop = false;
+        std::thread worker;
+    };
+
+    int sectorOfPos(int gx, int gy) const {
+        return (gy / SECTOR_SIZE) * impl_->sectorsX + (gx / SECTOR_SIZE);
+    }
+
+    static std::vector<Market> marketsOf(const StarSystem& sys) {
+        std::vector<Market> m;
+        m.reserve(sys.pois.size());
+        for (const auto& p : sys.pois) m.push_back(p.market);
+        return m;
+    }
+
+    static size_t systemBytes(const StarSystem& sys) {
+        size_t b = sizeof(StarSystem) + sys.name.capacity() * sizeof(wchar_t)
+                 + sys.pois.capacity() * sizeof(SystemPoi);
+        for (const auto& p : sys.pois) b += p.name.capacity() * sizeof(wchar_t);
+        return b;
+    }
+
+    // Thread-safe: reads only the immutable catalog and generator.
+    std::unique_ptr<Sector> generate(int sec) const {
+        const Impl& I = *impl_;
+        std::unique_ptr<Sector> out(new Sector);
+        out->index = sec;
+        out->ids.assign(I.sectorIds + I.sectorStart[sec], I.sectorIds + I.sectorStart[sec + 1]);
+        out->systems.resize(out->ids.size());
+        if (!out->ids.empty()) I.gen(out->ids.data(), out->ids.size(), out->systems.data());
+        out->bytes = sizeof(Sector) + out->ids.capacity() * sizeof(uint32_t);
+        for (size_t k = 0; k < out->ids.size(); k++) {
+            out->systems[k].gx = I.pos[out->ids[k]].gx;
+            out->systems[k].gy = I.pos[out->ids[k]].gy;
+            out->bytes += systemBytes(out->systems[k]);
+        }
+        return out;
+    }
+
+    Sector& adopt(std::unique_ptr<Sector> sec) const {
+        Impl& I = *impl_;
+        auto it = I.resident.find(sec->index);
+        if (it != I.resident.end()) return *it->second;   // generated twice; keep the first
+
+        for (size_t k = 0; k < sec->ids.size(); k++) {
+            auto saved = I.savedMarkets.find(sec->ids[k]);
+            if (saved == I.savedMarkets.end()) continue;
+            StarSystem& sys = sec->systems[k];
+            for (size_t p = 0; p < sys.pois.size() && p < saved->second.size(); p++) {
+                sys.pois[p].market = saved->second[p];
+                sys.marketsVersion += saved->second[p].version;   // memos keyed on it stay valid
+            }
+            sec->dirty = true;
+            I.savedMarkets.erase(saved);
+        }
+        I.residentBytes += sec->bytes;
+        I.lru.push_front(sec.get());
+        sec->lruPos = I.lru.begin();
+        Sector& ref = *sec;
+        I.resident.emplace(sec->index, std::move(sec));
+        return ref;
+    }
+
+    void adoptReady() const {
+        Impl& I = *impl_;
+        std::vector<std::unique_ptr<Sector>> ready;
+        {
+            std::lock_guard<std::mutex> lk(I.mu);
+            ready.swap(I.ready);
+            for (const auto& sec : ready) I.requested.erase(sec->index);
+        }
+        for (auto& sec : ready) { I.prefetched++; adopt(std::move(sec)); }
+    }
+
+    Sector& touch(int sec) const {
+        Impl& I = *impl_;
+        auto it = I.resident.find(sec);
+        Sector* s = nullptr;
+        if (it != I.resident.end()) {
+            s = it->second.get();
+        } else {
+            adoptReady();
+            it = I.resident.find(sec);
+            if (it != I.resident.end()) s = it->second.get();
+            else { I.loads++; s = &adopt(generate(sec)); }
+        }
+        s->epoch = I.epoch;
+        I.lru.splice(I.lru.begin(), I.lru, s->lruPos);
+        return *s;
+    }
+
+    void evict(Sector& sec) {
+        Impl& I = *impl_;
+        if (sec.dirty)
+            for (size_t k = 0; k < sec.ids.size(); k++) I.savedMarkets[sec.ids[k]] = marketsOf(sec.systems[k]);
+        I.residentBytes -= sec.bytes;
+        I.lru.erase(sec.lruPos);
+        I.evictions++;
+        int index = sec.index;
+        I.resident.erase(index);
+    }
+
+    void startWorker() {
+        Impl& I = *impl_;
+        if (I.worker.joinable()) return;
+        I.worker = std::thread([this, &I]() {
+            std::unique_lock<std::mutex> lk(I.mu);
+            while (true) {
+                I.cv.wait(lk, [&] { return I.stop || !I.requests.empty(); });
+                if (I.stop) return;
+                int sec = I.requests.front();
+                I.requests.pop_front();
+                lk.unlock();
+                std::unique_ptr<Sector> out = generate(sec);
+                lk.lock();
+                I.ready.push_back(std::move(out));
+            }
+        });
+    }
+
+    void stopWorker() {
+        if (!impl_ || !impl_->worker.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lk(impl_->mu);
+            impl_->stop = true;
+        }
+        impl_->cv.notify_all();
+        impl_->worker.join();
+    }
+
+    std::unique_ptr<Impl> impl_;
+};
+
+// ---------------- Orbits ----------------
+// POIs circle their star one cell per week. Ring k is every cell whose
+// distance from the star rounds to 3 + 2k, in angle order, so rings never
+// share a cell; a POI's cell at week w is ring[(phase + w) % ring size].
+// POIs on one ring move in lockstep, so none ever collide.
+static constexpr int ORBIT_RINGS = 32;
+static constexpr int ORBIT_SPACING = 6;      // min cells between POIs on a ring
+
+struct PoiPos { int x = 0, y = 0; };
+
+static int orbitRadius(int ring) { return 3 + 2 * ring; }
+
+// Cell offsets from the star, per ring. Built once; safe from any thread.
+static const std::vector<std::vector<PoiPos>>& orbitRings() {
+    static const std::vector<std::vector<PoiPos>> rings = [] {
+        std::vector<std::vector<PoiPos>> out(ORBIT_RINGS);
+        for (int k = 0; k < ORBIT_RINGS; k++) {
+            int r = orbitRadius(k);
+            // (2r-1)^2 <= 4d^2 < (2r+1)^2, i.e. distance rounds to r
+            for (int y = -r - 1; y <= r + 1; y++)
+                for (int x = -r - 1; x <= r + 1; x++) {
+                    int d4 = 4 * (x * x + y * y);
+                    if (d4 >= (2 * r - 1) * (2 * r - 1) && d4 < (2 * r + 1) * (2 * r + 1)) out[k].push_back({ x, y });
+                }
+            // Exact angle order: half-plane first, then cross product.
+            auto half = [](const PoiPos& p) { return (p.y < 0 || (p.y == 0 && p.x < 0)) ? 1 : 0; };
+            std::sort(out[k].begin(), out[k].end(), [&](const PoiPos& a, const PoiPos& b) {
+                if (half(a) != half(b)) return half(a) < half(b);
+                return (long long)a.x * b.y - (long long)a.y * b.x > 0;
+            });
+        }
+        return out;
+    }();
+    return rings;
+}
+
+static int orbitCapacity(int ring) { return std::max(1, (int)orbitRings()[ring].size() / ORBIT_SPACING); }
+
+// Spreads sys.pois over rings (at least one ring each for the first three)
+// and sizes the system to the outermost ring used.
+static void layoutOrbits(StarSystem& sys, uint32_t sysSeed) {
+    int n = (int)sys.pois.size();
+    int rings = 0, cap = 0;
+    while ((rings < std::min(n, 3) || cap < n) && rings < ORBIT_RINGS) cap += orbitCapacity(rings++);
+
+    int p = 0;
+    for (int k = 0; k < rings; k++) {
+        int here = std::min(orbitCapacity(k), (n - p) * orbitCapacity(k) / std::max(1, cap) + 1);
+        if (k == rings - 1) here = n - p;
+        cap -= orbitCapacity(k);
+        int cells = (int)orbitRings()[k].size();
+        int base = (int)(rng::hash32(sysSeed ^ (0x9E3779B9u * (uint32_t)(k + 1))) % (uint32_t)cells);
+        for (int j = 0; j < here && p < n; j++, p++) {
+            sys.pois[p].ring = k;
+            sys.pois[p].phase = (base + j * cells / here) % cells;
+        }
+    }
+    sys.size = 2 * (orbitRadius(std::max(rings, 1) - 1) + 2) + 1;
+}
+
+static PoiPos orbitPos(const StarSystem& sys, int poi, int week) {
+    const SystemPoi& p = sys.pois[poi];
+    const std::vector<PoiPos>& ring = orbitRings()[p.ring];
+    int n = (int)ring.size();
+    const PoiPos& o = ring[(size_t)(((p.phase + week) % n + n) % n)];
+    return { sys.size / 2 + o.x, sys.size / 2 + o.y };
+}
+
+// Where the POIs of recently viewed systems are this week, plus a cell grid
+// for O(1) "what is here" lookups. A few systems are kept (the one on screen
+// and the ones travelled through); moving a layout forward only moves each
+// POI along its ring and touches the two grid cells involved.
+class OrbitCache {
+public:
+    struct Layout {
+        int system = -1, week = 0, size = 0;
+        uint64_t used = 0;
+        std::vector<int> step;        // per POI: index on its ring
+        std::vector<PoiPos> pos;      // per POI
+        std::vector<int16_t> grid;    // size x size, POI index or -1
+
+        int poiAt(int x, int y) const {
+            if (x < 0 || y < 0 || x >= size || y >= size) return -1;
+            return grid[(size_t)y * size + x];
+        }
+        int nearest(int x, int y) const {
+            int best = -1, bestD = INT_MAX;
+            for (int i = 0; i < (int)pos.size(); i++) {
+                int d = manhattan(x, y, pos[i].x, pos[i].y);
+                if (d < bestD) { bestD = d; best = i; }
+            }
+            return best;
+        }
+    };
+
+    static constexpr int SLOTS = 8;
+
+    // The system is only read from the galaxy when its layout has to move.
+    const Layout& at(const Galaxy& G, int id, int week) const {
+        Layout* L = nullptr;
+        for (auto& l : slots_) if (l.system == id) { L = &l; break; }
+        if (!L) {
+            slots_.reserve(SLOTS);    // layouts handed out never move
+            if ((int)slots_.size() < SLOTS) slots_.emplace_back();
+            L = &slots_.back();
+            for (auto& l : slots_) if (l.used < L->used) L = &l;
+            build(*L, G[id], id, week);
+        } else if (week < L->week) {
+            build(*L, G[id], id, week);
+        } else if (week > L->week) {
+            advance(*L, G[id], week);
+        }
+        L->used = ++clock_;
+        return *L;
+    }
+
+    void clear() { slots_.clear(); clock_ = 0; }
+
+private:
+    void build(Layout& L, const StarSystem& sys, int id, int week) const {
+        L.system = id; L.week = week; L.size = sys.size;
+        L.step.resize(sys.pois.size());
+        L.pos.resize(sys.pois.size());
+        L.grid.assign((size_t)sys.size * sys.size, -1);
+        for (int i = 0; i < (int)sys.pois.size(); i++) {
+            int n = (int)orbitRings()[sys.pois[i].ring].size();
+            L.step[i] = (int)(((long long)sys.pois[i].phase + week) % n);
+            L.pos[i] = orbitPos(sys, i, week);
+            L.grid[(size_t)L.pos[i].y * L.size + L.pos[i].x] = (int16_t)i;
+        }
+    }
+
+    // Two passes so a POI moving into a cell another one just left is kept.
+    void advance(Layout& L, const StarSystem& sys, int week) const {
+        int dt = week - L.week;
+        int c = L.size / 2;
+        for (const PoiPos& p : L.pos) L.grid[(size_t)p.y * L.size + p.x] = -1;
+        for (int i = 0; i < (int)L.pos.size(); i++) {
+            const std::vector<PoiPos>& ring = orbitRings()[sys.pois[i].ring];
+            L.step[i] = (int)(((long long)L.step[i] + dt) % (int)ring.size());
+            L.pos[i] = { c + ring[L.step[i]].x, c + ring[L.step[i]].y };
+            L.grid[(size_t)L.pos[i].y * L.size + L.pos[i].x] = (int16_t)i;
+        }
+        L.week = week;
+    }
+
+    mutable std::vector<Layout> slots_;
+    mutable uint64_t clock_ = 0;
+};
+
+// ---------------- Memo ----------------
+// A derived value cached against the generations of its inputs. The mutable
+// parts of the state carry counters bumped on every write (Market::version,
+// Fleet::gen, GameState::gen); get() recomputes only when the key built from
+// them differs from the one the value was computed at.
+template <class T, class Key = uint64_t>
+class Memo {
+public:
+    template <class Compute>
+    const T& get(const Key& key, Compute compute) const {
+        if (!valid_ || !(key == key_)) { value_ = compute(); key_ = key; valid_ = true; }
+        return value_;
+    }
+    void reset() { valid_ = false; }
+
+private:
+    mutable T value_{};
+    mutable Key key_{};
+    mutable bool valid_ = false;
 };
 
 // ---------------- Player ----------------
 struct Player {
     int credits = 2500;
 
-    int fuel = 40;
-    int fuelMax = 60;
-
-    int cargoMax = 40;
-    int cargo[(int)Good::COUNT]{};
-
     int crew = 1;       // NEW: starting crew = 1
     int crewMax = 12;
+};
 
-    int cargoUsed() const {
-        int s=0;
-        for(int i=0;i<(int)Good::COUNT;i++){
-            if ((Good)i == Good::Fuel) continue;
-            s += cargo[i];
-        }
-        return s;
+// ---------------- Fleet ----------------
+// Every ship the player owns, one array per field. The weekly update walks
+// these arrays front to back without per-ship objects, so it stays linear in
+// fleet size and vectorizes. Manned ships are flown by hand (GameState::pilot
+// is the one this seat flies); the others follow their standing orders (see
+// fleetTick).
+static constexpr int SHIP_PRICE = 2000;
+
+enum class ShipOrder : uint8_t { Hold, Travel, Manned };
+
+struct Fleet {
+    // Galaxy position (can be empty space) and position inside that system
+    std::vector<int> gx, gy, sx, sy;
+
+    std::vector<int> fuel, fuelMax, cargoMax;
+    std::vector<int> cargo[(int)Good::COUNT];   // cargo[good][ship]; Fuel lives in `fuel`
+
+    // Standing order; Travel heads for (tx,ty) and docks on arrival
+    std::vector<uint8_t> order;
+    std::vector<int> tx, ty;
+
+    // Hold generation: bumped whenever the ship's cargo changes. Fuel is a
+    // single column read directly, and fleetMove burns it without bumping.
+    std::vector<uint32_t> gen;
+    void touch(int ship) { gen[ship]++; }
+
+    int size() const { return (int)gx.size(); }
+
+    void clear() { *this = Fleet{}; }
+
+    int add(int atGX, int atGY, int fuel0 = 40, int fuelCap = 60, int cargoCap = 40) {
+        gx.push_back(atGX); gy.push_back(atGY);
+        sx.push_back(0); sy.push_back(0);
+        fuel.push_back(fuel0); fuelMax.push_back(fuelCap); cargoMax.push_back(cargoCap);
+        for (auto& c : cargo) c.push_back(0);
+        order.push_back((uint8_t)ShipOrder::Hold);
+        tx.push_back(atGX); ty.push_back(atGY);
+        gen.push_back(0);
+        used_.emplace_back();
+        return size() - 1;
+    }
+
+    int cargoUsed(int ship) const {
+        return used_[ship].get(gen[ship], [&]() {
+            int s=0;
+            for(int i=0;i<(int)Good::COUNT;i++){
+                if ((Good)i == Good::Fuel) continue;
+                s += cargo[i][ship];
+            }
+            return s;
+        });
     }
+
+private:
+    std::vector<Memo<int, uint32_t>> used_;
 };
 
 // ---------------- Missions ----------------
@@ -141,17 +1004,1070 @@ struct Mission {
     Good good = Good::Ore;
     int amount = 0;
     int reward = 0;
-    int deadlineWeeks = 0;
+    int deadlineWeeks = 0;  // time allowed, as offered
+    int dueWeek = 0;        // absolute last week for delivery, set on accept
 };
 
 static std::wstring goodNameW(Good g){ return GOOD_NAME[(int)g]; }
 
+// ---------------- Galaxy mipmaps ----------------
+// Pyramid over the galaxy grid for the zoomable map. Level 0 is one cell per
+// galaxy coordinate; each level above halves both dimensions. Every tile
+// keeps the number of systems and mission targets inside it plus a ship bit,
+// so drawing a zoomed-out view costs O(screen cells) regardless of how many
+// systems the galaxy holds. Ship and mission updates touch one tile per
+// level.
+struct GalaxyMip {
+    static constexpr uint8_t SHIP = 1;
+
+    struct Level {
+        int w = 0, h = 0;
+        std::vector<uint32_t> systems;
+        std::vector<uint32_t> missions;
+        std::vector<uint8_t> flags;
+        int at(int x, int y) const { return y * w + x; }
+    };
+
+    std::vector<Level> levels;
+    std::vector<int> sysAt;          // level 0 only: system index or -1
+    int shipX = -1, shipY = -1;
+
+    int levelCount() const { return (int)levels.size(); }
+    bool contains(int x, int y) const {
+        return !levels.empty() && x >= 0 && y >= 0 && x < levels[0].w && y < levels[0].h;
+    }
+
+    void build(SystemSpan galaxy, int w, int h) {
+        levels.clear();
+        int lw = std::max(1, w), lh = std::max(1, h);
+        while (true) {
+            Level L;
+            L.w = lw; L.h = lh;
+            L.systems.assign((size_t)lw * lh, 0);
+            L.missions.assign((size_t)lw * lh, 0);
+            L.flags.assign((size_t)lw * lh, 0);
+            levels.push_back(std::move(L));
+            if (lw == 1 && lh == 1) break;
+            lw = (lw + 1) / 2; lh = (lh + 1) / 2;
+        }
+        sysAt.assign((size_t)levels[0].w * levels[0].h, -1);
+        for (int i = 0; i < (int)galaxy.size(); i++) {
+            int x = galaxy[i].gx, y = galaxy[i].gy;
+            if (!contains(x, y)) continue;
+            int& slot = sysAt[levels[0].at(x, y)];
+            if (slot < 0) slot = i;
+            for (int k = 0; k < levelCount(); k++) levels[k].systems[levels[k].at(x >> k, y >> k)]++;
+        }
+        shipX = shipY = -1;
+    }
+
+    void addMissionTarget(int x, int y, int delta) {
+        if (!contains(x, y)) return;
+        for (int k = 0; k < levelCount(); k++) {
+            uint32_t& c = levels[k].missions[levels[k].at(x >> k, y >> k)];
+            c = (uint32_t)std::max<int64_t>(0, (int64_t)c + delta);
+        }
+    }
+
+    void setShip(int x, int y) {
+        if (contains(shipX, shipY))
+            for (int k = 0; k < levelCount(); k++) levels[k].flags[levels[k].at(shipX >> k, shipY >> k)] &= (uint8_t)~SHIP;
+        shipX = x; shipY = y;
+        if (contains(x, y))
+            for (int k = 0; k < levelCount(); k++) levels[k].flags[levels[k].at(x >> k, y >> k)] |= SHIP;
+    }
+};
+
+// ---------------- Fuel reachability ----------------
+// Which galaxy cells the pilot can get to. "Now" is every cell within the
+// jumps the tank holds. "With refuelling" adds every cell within one full tank
+// of a system chained to those in range now by hops of at most one tank,
+// assuming fuel is on sale at every system. Both are one bit per cell, grown
+// by Chebyshev dilation 64 cells at a time.
+//
+// Which systems chain together depends only on the tank size, so that is
+// worked out once per tank size (union-find over tank-sized buckets) and the
+// overlay itself is cached until the ship's position or fuel changes.
+class FuelReach {
+public:
+    void setSystems(SystemSpan catalog, int w, int h) {
+        systems_.resize(w, h);
+        for (const SystemPos& p : catalog) systems_.set(p.gx, p.gy);
+        labelRadius_ = -1;
+        valid_ = false;
+    }
+
+    // Recomputes only if something it depends on changed.
+    void update(int gx, int gy, int fuel, int fuelMax) {
+        if (valid_ && gx == gx_ && gy == gy_ && fuel == fuel_ && fuelMax == fuelMax_) return;
+        TRACE_SCOPE("FuelReach::update");
+        gx_ = gx; gy_ = gy; fuel_ = fuel; fuelMax_ = fuelMax; valid_ = true;
+
+        int range = fuel / GALAXY_FUEL_PER_JUMP * GALAXY_JUMP_RANGE;
+        now_.resize(systems_.w, systems_.h);
+        if (systems_.contains(gx, gy)) now_.set(gx, gy);
+        dilate(now_, range);
+
+        refuel_ = now_;
+        int tank = fuelMax / GALAXY_FUEL_PER_JUMP * GALAXY_JUMP_RANGE;
+        if (tank <= 0) return;
+        labelComponents(tank);
+
+        // Chains with a system in range now, as a bucket mask over the grid.
+        std::vector<char> seeded(root_.size(), 0);
+        bool any = false;
+        for (int y = std::max(0, gy - range); y <= std::min(systems_.h - 1, gy + range); y++)
+            for (int x = std::max(0, gx - range); x <= std::min(systems_.w - 1, gx + range); x++)
+                if (systems_.get(x, y)) { seeded[root_[(y / tank) * bucketsX_ + x / tank]] = 1; any = true; }
+        if (!any) return;
+
+        Bits chained;
+        chained.resize(systems_.w, systems_.h);
+        for (int y = 0; y < systems_.h; y++) {
+            uint64_t* row = chained.row(y);
+            const uint64_t* sys = systems_.row(y);
+            const int* roots = root_.data() + (size_t)(y / tank) * bucketsX_;
+            for (int bx = 0; bx < bucketsX_; bx++) {
+                if (roots[bx] < 0 || !seeded[roots[bx]]) continue;
+                int x0 = bx * tank, x1 = std::min(systems_.w, x0 + tank);   // [x0, x1)
+                for (int k = x0 >> 6; k <= (x1 - 1) >> 6; k++) {
+                    uint64_t m = ~0ull;
+                    if (k == x0 >> 6) m &= ~0ull << (x0 & 63);
+                    if (k == (x1 - 1) >> 6) m &= ~0ull >> (63 - ((x1 - 1) & 63));
+                    row[k] |= sys[k] & m;
+                }
+            }
+        }
+        dilate(chained, tank);
+        refuel_.orWith(chained);
+    }
+    void invalidate() { valid_ = false; }
+
+    // Any cell of [x0, x1] x [y0, y1] reachable now / with refuelling.
+    bool now(int x0, int y0, int x1, int y1) const    { return now_.anyIn(x0, y0, x1, y1); }
+    bool refuel(int x0, int y0, int x1, int y1) const { return refuel_.anyIn(x0, y0, x1, y1); }
+    bool anySystemWithin(int x, int y, int radius) const {
+        return systems_.anyIn(x - radius, y - radius, x + radius, y + radius);
+    }
+
+private:
+    struct Bits {
+        int w = 0, h = 0, wpr = 0;          // wpr = 64-bit words per row
+        std::vector<uint64_t> words;
+
+        void resize(int nw, int nh) {
+            w = std::max(0, nw); h = std::max(0, nh); wpr = (w + 63) / 64;
+            words.assign((size_t)wpr * h, 0);
+        }
+        bool contains(int x, int y) const { return x >= 0 && y >= 0 && x < w && y < h; }
+        uint64_t* row(int y) { return words.data() + (size_t)y * wpr; }
+        const uint64_t* row(int y) const { return words.data() + (size_t)y * wpr; }
+        void set(int x, int y) { if (contains(x, y)) row(y)[x >> 6] |= 1ull << (x & 63); }
+        bool get(int x, int y) const { return (row(y)[x >> 6] >> (x & 63)) & 1; }
+
+        void orWith(const Bits& o) { for (size_t i = 0; i < words.size(); i++) words[i] |= o.words[i]; }
+
+        bool anyIn(int x0, int y0, int x1, int y1) const {
+            x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+            x1 = std::min(x1, w - 1); y1 = std::min(y1, h - 1);
+            if (x0 > x1 || y0 > y1) return false;
+            int w0 = x0 >> 6, w1 = x1 >> 6;
+            uint64_t m0 = ~0ull << (x0 & 63), m1 = ~0ull >> (63 - (x1 & 63));
+            for (int y = y0; y <= y1; y++) {
+                const uint64_t* r = row(y);
+                if (w0 == w1) { if (r[w0] & m0 & m1) return true; continue; }
+                if ((r[w0] & m0) || (r[w1] & m1)) return true;
+                for (int k = w0 + 1; k < w1; k++) if (r[k]) return true;
+            }
+            return false;
+        }
+    };
+
+    // Chains are systems linked by hops of at most r. Cut the grid into r x r
+    // buckets: everything inside one is linked, and only the 8 neighbouring
+    // buckets can hold a partner, so union-find runs over buckets, each pair
+    // settled by one test on extremes (side by side) or one prefix scan
+    // (diagonal). root_[bucket] = its chain, -1 if empty.
+    void labelComponents(int r) {
+        if (r == labelRadius_) return;
+        labelRadius_ = r;
+        int bw = (systems_.w + r - 1) / r, bh = (systems_.h + r - 1) / r, nb = bw * bh;
+        bucketsX_ = bw;
+
+        // Extents of each bucket, in one row-major sweep over the system bits.
+        struct Extent { int minX = INT_MAX, maxX = INT_MIN, minY = INT_MAX, maxY = INT_MIN; };
+        std::vector<Extent> ext((size_t)nb);
+        root_.assign((size_t)nb, -1);
+        for (int y = 0; y < systems_.h; y++)
+            forBits(systems_, y, 0, systems_.w, [&](int x) {
+                int b = (y / r) * bw + x / r;
+                Extent& e = ext[b];
+                e.minX = std::min(e.minX, x); e.maxX = std::max(e.maxX, x);
+                e.minY = std::min(e.minY, y); e.maxY = y;
+                root_[b] = b;
+            });
+        auto find = [&](int x) {
+            while (root_[x] != x) { root_[x] = root_[root_[x]]; x = root_[x]; }
+            return x;
+        };
+
+        // Diagonal pair (b right of a, below it if `down`): for each x offset
+        // inside b, the nearest y among b's systems at or left of it.
+        std::vector<int> best((size_t)r);
+        auto diagonal = [&](int a, int b, bool down) {
+            int bx0 = (b % bw) * r, by0 = (b / bw) * r, by1 = std::min(systems_.h, by0 + r);
+            std::fill(best.begin(), best.end(), down ? INT_MAX : INT_MIN);
+            for (int y = by0; y < by1; y++)
+                forBits(systems_, y, bx0, std::min(systems_.w, bx0 + r), [&](int x) {
+                    int& v = best[x - bx0];
+                    v = down ? std::min(v, y) : std::max(v, y);
+                });
+            for (int t = 1; t < r; t++) best[t] = down ? std::min(best[t], best[t - 1]) : std::max(best[t], best[t - 1]);
+
+            int ax0 = (a % bw) * r, ay0 = (a / bw) * r, ay1 = std::min(systems_.h, ay0 + r);
+            bool found = false;
+            for (int y = ay0; y < ay1 && !found; y++)
+                forBits(systems_, y, ax0, ax0 + r, [&](int x) {
+                    int v = best[x - ax0];   // partners need gx <= x + r, i.e. this offset
+                    found |= down ? v <= y + r : v >= y - r;
+                });
+            return found;
+        };
+
+        for (int by = 0; by < bh; by++)
+            for (int bx = 0; bx < bw; bx++) {
+                int a = by * bw + bx;
+                if (root_[a] < 0) continue;
+                auto link = [&](int nx, int ny, int kind) {
+                    if (nx < 0 || ny < 0 || nx >= bw || ny >= bh) return;
+                    int b = ny * bw + nx;
+                    if (root_[b] < 0) return;
+                    int ra = find(a), rb = find(b);
+                    if (ra == rb) return;
+                    bool ok = (kind == 0) ? ext[b].minX - ext[a].maxX <= r
+                            : (kind == 1) ? ext[b].minY - ext[a].maxY <= r
+                            : diagonal(a, b, kind == 2);
+                    if (ok) root_[std::max(ra, rb)] = std::min(ra, rb);
+                };
+                link(bx + 1, by, 0);
+                link(bx, by + 1, 1);
+                link(bx + 1, by + 1, 2);
+                link(bx + 1, by - 1, 3);
+            }
+        for (int b = 0; b < nb; b++) if (root_[b] >= 0) root_[b] = find(b);
+    }
+
+    // fn(x) for each set bit of row y in [x0, x1).
+    template <class Fn>
+    static void forBits(const Bits& B, int y, int x0, int x1, Fn fn) {
+        if (x0 >= x1) return;
+        const uint64_t* row = B.row(y);
+        for (int k = x0 >> 6; k <= (x1 - 1) >> 6; k++) {
+            uint64_t v = row[k];
+            if (k == x0 >> 6) v &= ~0ull << (x0 & 63);
+            if (k == (x1 - 1) >> 6) v &= ~0ull >> (63 - ((x1 - 1) & 63));
+            while (v) {
+                fn(k * 64 + ctz64(v));
+                v &= v - 1;
+            }
+        }
+    }
+
+    // Every set cell grows to the (2r+1)^2 square around it, only inside the
+    // set's bounding box grown by r. Rows: each pass ORs in copies shifted
+    // both ways, doubling the covered span, so log r passes. Columns: a van
+    // Herk / Gil-Werman running OR, three passes whatever r is.
+    void dilate(Bits& B, int r) {
+        if (r <= 0 || B.words.empty()) return;
+        int ylo = B.h, yhi = -1, klo = B.wpr, khi = -1;
+        for (int y = 0; y < B.h; y++) {
+            const uint64_t* row = B.row(y);
+            for (int k = 0; k < B.wpr; k++)
+                if (row[k]) { ylo = std::min(ylo, y); yhi = y; klo = std::min(klo, k); khi = std::max(khi, k); }
+        }
+        if (yhi < 0) return;
+
+        int c0 = std::max(0, klo * 64 - r) >> 6, c1 = std::min(B.w - 1, khi * 64 + 63 + r) >> 6;
+        int n = c1 - c0 + 1;
+        int pad = r / 64 + 2;                        // zero words either side: no bounds checks
+        rowA_.assign((size_t)n + 2 * pad, 0);
+        rowB_.assign((size_t)n + 2 * pad, 0);
+        for (int y = ylo; y <= yhi; y++) {
+            uint64_t* row = B.row(y) + c0;
+            std::copy(row, row + n, rowA_.begin() + pad);
+            for (int covered = 0; covered < r;) {
+                int s = std::min(covered + 1, r - covered);
+                int q = s >> 6, b = s & 63;
+                const uint64_t* a = rowA_.data() + pad;
+                uint64_t* o = rowB_.data() + pad;
+                // (v >> 1) >> (63 - b) is v >> (64 - b), defined for b == 0
+                for (int i = 0; i < n; i++)
+                    o[i] = a[i] | (a[i - q] << b) | ((a[i - q - 1] >> 1) >> (63 - b))
+                                | (a[i + q] >> b) | ((a[i + q + 1] << 1) << (63 - b));
+                rowA_.swap(rowB_);
+                covered += s;
+            }
+            std::copy(rowA_.begin() + pad, rowA_.begin() + pad + n, row);
+            if (c1 == B.wpr - 1 && (B.w & 63)) row[n - 1] &= ~0ull >> (64 - (B.w & 63));
+        }
+
+        // out[y] = OR of rows [y - r, y + r]. Cut into blocks of k = 2r + 1
+        // rows, that window is the suffix OR of one block plus the prefix OR
+        // of the next.
+        int y0 = std::max(0, ylo - r), y1 = std::min(B.h - 1, yhi + r);
+        int k = 2 * r + 1;
+        pre_.resize((size_t)(y1 - y0 + 1) * n);
+        suf_.resize((size_t)(y1 - y0 + 1) * n);
+        auto at = [&](std::vector<uint64_t>& v, int y) { return v.data() + (size_t)(y - y0) * n; };
+        for (int y = y0; y <= y1; y++) {
+            const uint64_t* src = B.row(y) + c0;
+            uint64_t* p = at(pre_, y);
+            if ((y - y0) % k == 0) std::copy(src, src + n, p);
+            else { const uint64_t* q = at(pre_, y - 1); for (int i = 0; i < n; i++) p[i] = q[i] | src[i]; }
+        }
+        for (int y = y1; y >= y0; y--) {
+            const uint64_t* src = B.row(y) + c0;
+            uint64_t* p = at(suf_, y);
+            if ((y - y0) % k == k - 1 || y == y1) std::copy(src, src + n, p);
+            else { const uint64_t* q = at(suf_, y + 1); for (int i = 0; i < n; i++) p[i] = q[i] | src[i]; }
+        }
+        for (int y = y0; y <= y1; y++) {
+            int lo = std::max(y0, y - r), hi = std::min(y1, y + r);
+            uint64_t* d = B.row(y) + c0;
+            if ((lo - y0) / k != (hi - y0) / k) {
+                const uint64_t* a = at(suf_, lo);
+                const uint64_t* b = at(pre_, hi);
+                for (int i = 0; i < n; i++) d[i] = a[i] | b[i];
+            } else {
+                // one block: either it starts at lo, or the window was cut short at y1
+                const uint64_t* a = ((lo - y0) % k == 0) ? at(pre_, hi) : at(suf_, lo);
+                std::copy(a, a + n, d);
+            }
+        }
+    }
+
+    Bits systems_, now_, refuel_;
+    std::vector<int> root_;                           // per bucket, see labelComponents
+    int bucketsX_ = 0, labelRadius_ = -1;
+    std::vector<uint64_t> rowA_, rowB_, pre_, suf_;   // dilate() scratch
+    bool valid_ = false;
+    int gx_ = 0, gy_ = 0, fuel_ = 0, fuelMax_ = 0;
+};
+
+// ---------------- Galaxy price index ----------------
+// Answers "cheapest Ore within N jumps" style queries without visiting every
+// system. Cells match the galaxy sectors; each keeps the quotes of its POIs
+// plus a per-good min/max. A query ranks the cells overlapping its square by
+// that bound and stops as soon as no remaining cell can beat its results.
+// A cell is filled the first time a query reaches it (loading its sector) and
+// kept current by update() when a market moves.
+class PriceIndex {
+public:
+    struct Hit { int system = -1, poi = -1; long long value = 0; };
+
+    void clear() { cells_.clear(); }
+
+    // Quotes at (system, poi) changed.
+    void update(const Galaxy& G, int system, int poi, const Market& m) {
+        if (!sync(G)) return;
+        SystemPos p = G.pos(system);
+        Cell& c = cells_[(size_t)(p.gy / SECTOR_SIZE) * G.sectorsX() + p.gx / SECTOR_SIZE];
+        if (!c.built) return;   // filled from the current markets when first needed
+        for (Entry& e : c.entries)
+            if (e.system == (uint32_t)system && e.poi == poi)
+                for (int g = 0; g < (int)Good::COUNT; g++) e.price[g] = clampPrice(m.priceOf((Good)g));
+        aggregate(c);
+    }
+
+    // Cheapest / priciest quote for g within `radius` (Chebyshev) of (gx, gy).
+    Hit cheapest(const Galaxy& G, Good g, int gx, int gy, int radius) const {
+        auto best = search(G, gx, gy, radius, 1,
+                           [g](const Cell& c) { return -(long long)c.minPrice[(int)g]; },
+                           [g](const Entry& e) { return -(long long)e.price[(int)g]; });
+        if (best.empty()) return Hit{};
+        best[0].value = -best[0].value;
+        return best[0];
+    }
+    Hit priciest(const Galaxy& G, Good g, int gx, int gy, int radius) const {
+        auto best = search(G, gx, gy, radius, 1,
+                           [g](const Cell& c) { return (long long)c.maxPrice[(int)g]; },
+                           [g](const Entry& e) { return (long long)e.price[(int)g]; });
+        return best.empty() ? Hit{} : best[0];
+    }
+
+    // Up to k cheapest quotes for g, cheapest first (value is the price).
+    std::vector<Hit> cheapestPoints(const Galaxy& G, Good g, int gx, int gy, int radius, int k) const {
+        auto best = search(G, gx, gy, radius, k,
+                           [g](const Cell& c) { return -(long long)c.minPrice[(int)g]; },
+                           [g](const Entry& e) { return -(long long)e.price[(int)g]; });
+        for (Hit& h : best) h.value = -h.value;
+        return best;
+    }
+
+    // Up to k POIs paying the most for units[good] of every good, best first.
+    std::vector<Hit> bestSellPoints(const Galaxy& G, const int* units, int gx, int gy, int radius, int k) const {
+        return search(G, gx, gy, radius, k,
+                      [units](const Cell& c) {
+                          long long v = 0;
+                          for (int g = 0; g < (int)Good::COUNT; g++) v += (long long)units[g] * c.maxPrice[g];
+                          return v;
+                      },
+                      [units](const Entry& e) {
+                          long long v = 0;
+                          for (int g = 0; g < (int)Good::COUNT; g++) v += (long long)units[g] * e.price[g];
+                          return v;
+                      });
+    }
+
+private:
+    struct Entry {
+        int32_t gx = 0, gy = 0;
+        uint32_t system = 0;
+        uint8_t poi = 0;
+        uint16_t price[(int)Good::COUNT]{};
+    };
+    struct Cell {
+        bool built = false;
+        uint16_t minPrice[(int)Good::COUNT]{}, maxPrice[(int)Good::COUNT]{};
+        std::vector<Entry> entries;
+    };
+
+    static uint16_t clampPrice(int p) { return (uint16_t)std::max(0, std::min(p, 65535)); }
+
+    bool sync(const Galaxy& G) const {
+        size_t n = (size_t)G.sectorsX() * G.sectorsY();
+        if (G.size() == 0) return false;
+        if (cells_.size() != n) { cells_.clear(); cells_.resize(n); }
+        return true;
+    }
+
+    static void aggregate(Cell& c) {
+        for (int g = 0; g < (int)Good::COUNT; g++) {
+            c.minPrice[g] = 65535; c.maxPrice[g] = 0;
+            for (const Entry& e : c.entries) {
+                c.minPrice[g] = std::min(c.minPrice[g], e.price[g]);
+                c.maxPrice[g] = std::max(c.maxPrice[g], e.price[g]);
+            }
+        }
+    }
+
+    Cell& build(const Galaxy& G, int sec) const {
+        Cell& c = cells_[sec];
+        if (c.built) return c;
+        for (const uint32_t* id = G.sectorBegin(sec); id != G.sectorEnd(sec); id++) {
+            const StarSystem& sys = G[(int)*id];
+            for (int p = 0; p < (int)sys.pois.size(); p++) {
+                Entry e;
+                e.gx = sys.gx; e.gy = sys.gy; e.system = *id; e.poi = (uint8_t)p;
+                for (int g = 0; g < (int)Good::COUNT; g++) e.price[g] = clampPrice(sys.pois[p].market.priceOf((Good)g));
+                c.entries.push_back(e);
+            }
+        }
+        aggregate(c);
+        c.built = true;
+        return c;
+    }
+
+    // Best k entries by score (higher first) in the square; bound(cell) must
+    // be at least the score of every entry in the cell.
+    template <class Bound, class Score>
+    std::vector<Hit> search(const Galaxy& G, int gx, int gy, int radius, int k, Bound bound, Score score) const {
+        std::vector<Hit> best;
+        if (k <= 0 || !sync(G)) return best;
+        int x0 = std::max(0, (gx - radius) / SECTOR_SIZE), x1 = std::min(G.sectorsX() - 1, std::max(0, gx + radius) / SECTOR_SIZE);
+        int y0 = std::max(0, (gy - radius) / SECTOR_SIZE), y1 = std::min(G.sectorsY() - 1, std::max(0, gy + radius) / SECTOR_SIZE);
+
+        std::vector<std::pair<long long, int>> order;
+        for (int sy = y0; sy <= y1; sy++)
+            for (int sx = x0; sx <= x1; sx++) {
+                int sec = sy * G.sectorsX() + sx;
+                if (G.sectorBegin(sec) == G.sectorEnd(sec)) continue;
+                order.push_back({ bound(build(G, sec)), sec });
+            }
+        std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        for (const auto& o : order) {
+            if ((int)best.size() == k && o.first <= best.back().value) break;
+            for (const Entry& e : cells_[o.second].entries) {
+                if (chebyshev(e.gx, e.gy, gx, gy) > radius) continue;
+                long long v = score(e);
+                if ((int)best.size() == k && v <= best.back().value) continue;
+                Hit h{ (int)e.system, e.poi, v };
+                best.insert(std::upper_bound(best.begin(), best.end(), h,
+                                             [](const Hit& a, const Hit& b) { return a.value > b.value; }), h);
+                if ((int)best.size() > k) best.pop_back();
+            }
+        }
+        return best;
+    }
+
+    mutable std::vector<Cell> cells_;   // cache, like the galaxy's sectors
+};
+
+// ---------------- Arbitrage index ----------------
+// The best K buy-low / sell-high trades per good around the ship, both inside
+// one system and up to ARBITRAGE_JUMPS apart. Every indexed market keeps its
+// best sell partner per good and kind; the partners' spreads sit in one
+// ordered set per (kind, good), so the top K is a walk from its end.
+//
+// Nothing is rescanned per tick: changed() takes the markets whose quotes
+// moved and touches only markets that could pair with them: the rest of
+// their system and those within range. A partner that got worse is
+// re-queried through the PriceIndex; a market that got better simply
+// replaces worse partners. follow() keeps the sectors around the ship
+// indexed, adding and dropping whole sectors as it moves.
+struct MarketRef { int system = 0, poi = 0; };
+
+class ArbitrageIndex {
+public:
+    enum Kind { InSystem, Nearby, KINDS };
+    static constexpr int K = 5;
+    static constexpr int REGION = 1;    // sectors indexed on each side of the ship's
+
+    struct Trade {
+        int buySystem = -1, buyPoi = -1, buyPrice = 0;
+        int sellSystem = -1, sellPoi = -1, sellPrice = 0;
+        int jumps = 0;
+        int spread() const { return sellPrice - buyPrice; }
+    };
+
+    void clear() { *this = ArbitrageIndex{}; }
+    int indexed() const { return (int)slots_.size() - (int)free_.size(); }
+
+    // Best first, at most K, each with a positive spread.
+    const std::vector<Trade>& top(Good g, Kind k) const {
+        std::vector<Trade>& out = top_[k][(int)g];
+        if (!topDirty_[k][(int)g]) return out;
+        out.clear();
+        const auto& rank = rank_[k][(int)g];
+        for (auto it = rank.rbegin(); it != rank.rend() && (int)out.size() < K; ++it) {
+            const Slot& s = slots_[it->second];
+            const Best& b = s.best[k][(int)g];
+            Trade t;
+            t.buySystem = s.system; t.buyPoi = s.poi; t.buyPrice = b.buy;
+            t.sellSystem = b.system; t.sellPoi = b.poi; t.sellPrice = b.sell;
+            t.jumps = jumpsRequired(chebyshev(s.gx, s.gy, b.gx, b.gy), GALAXY_JUMP_RANGE);
+            out.push_back(t);
+        }
+        topDirty_[k][(int)g] = false;
+        return out;
+    }
+
+    // Indexes the sectors around (gx, gy); sectors left behind are dropped.
+    void follow(const Galaxy& G, const PriceIndex& PI, int gx, int gy) {
+        if (G.size() == 0) return;
+        int cx = gx / SECTOR_SIZE, cy = gy / SECTOR_SIZE;
+        if (centered_ && cx == cx_ && cy == cy_) return;
+        centered_ = true; cx_ = cx; cy_ = cy;
+
+        auto inRegion = [&](int sec) {
+            int sx = sec % G.sectorsX(), sy = sec / G.sectorsX();
+            return std::abs(sx - cx) <= REGION && std::abs(sy - cy) <= REGION;
+        };
+        for (auto it = bySector_.begin(); it != bySector_.end();) {
+            if (inRegion(it->first)) { ++it; continue; }
+            for (int id : it->second) removeSlot(id);
+            it = bySector_.erase(it);
+        }
+        for (int sy = std::max(0, cy - REGION); sy <= std::min(G.sectorsY() - 1, cy + REGION); sy++)
+            for (int sx = std::max(0, cx - REGION); sx <= std::min(G.sectorsX() - 1, cx + REGION); sx++) {
+                int sec = sy * G.sectorsX() + sx;
+                if (bySector_.count(sec) || G.sectorBegin(sec) == G.sectorEnd(sec)) continue;
+                std::vector<int>& ids = bySector_[sec];
+                for (const uint32_t* id = G.sectorBegin(sec); id != G.sectorEnd(sec); id++) {
+                    const StarSystem& sys = G[(int)*id];
+                    for (int p = 0; p < (int)sys.pois.size(); p++) ids.push_back(addSlot((int)*id, p, sys.gx, sys.gy));
+                    refreshSystem(G, (int)*id);
+                    for (int p = 0; p < (int)sys.pois.size(); p++) requery(G, PI, bySlot_[key((int)*id, p)]);
+                }
+            }
+    }
+
+    // Quotes moved at `markets` (call after PriceIndex::update for them).
+    void changed(const Galaxy& G, const PriceIndex& PI, const std::vector<MarketRef>& markets) {
+        if (!centered_) return;
+        int radius = ARBITRAGE_JUMPS * GALAXY_JUMP_RANGE;
+        for (const MarketRef& m : markets) {
+            refreshSystem(G, m.system);
+            auto self = bySlot_.find(key(m.system, m.poi));
+            if (self != bySlot_.end()) requery(G, PI, self->second);   // as a buyer
+
+            // As a seller, to every indexed market in range.
+            SystemPos at = G.pos(m.system);
+            const Market& mk = G[m.system].pois[m.poi].market;
+            int x0 = std::max(0, (at.gx - radius) / SECTOR_SIZE), x1 = (at.gx + radius) / SECTOR_SIZE;
+            int y0 = std::max(0, (at.gy - radius) / SECTOR_SIZE), y1 = (at.gy + radius) / SECTOR_SIZE;
+            for (int sy = y0; sy <= y1; sy++)
+                for (int sx = x0; sx <= x1; sx++) {
+                    auto sec = bySector_.find(sy * G.sectorsX() + sx);
+                    if (sx >= G.sectorsX() || sec == bySector_.end()) continue;
+                    for (int id : sec->second) {
+                        Slot& s = slots_[id];
+                        if ((s.system == m.system && s.poi == m.poi) || chebyshev(s.gx, s.gy, at.gx, at.gy) > radius) continue;
+                        for (int g = 0; g < (int)Good::COUNT; g++) {
+                            const Best& b = s.best[Nearby][g];
+                            int sell = mk.priceOf((Good)g);
+                            if (b.system == m.system && b.poi == m.poi) {
+                                if (sell < b.sell) { requeryGood(G, PI, id, g); continue; }
+                            } else if (sell - b.buy <= b.sell - b.buy) {
+                                continue;
+                            }
+                            setBest(id, Nearby, g, { b.buy, sell, m.system, m.poi, at.gx, at.gy });
+                        }
+                    }
+                }
+        }
+    }
+
+private:
+    struct Best {
+        int buy = 0, sell = 0;                // spread = sell - buy
+        int system = -1, poi = -1, gx = 0, gy = 0;   // sell partner
+    };
+    struct Slot {
+        int system = -1, poi = -1, gx = 0, gy = 0;
+        Best best[KINDS][(int)Good::COUNT];
+    };
+
+    static uint64_t key(int system, int poi) { return ((uint64_t)(uint32_t)system << 8) | (uint8_t)poi; }
+
+    int addSlot(int system, int poi, int gx, int gy) {
+        int id;
+        if (!free_.empty()) { id = free_.back(); free_.pop_back(); }
+        else { id = (int)slots_.size(); slots_.emplace_back(); }
+        Slot& s = slots_[id];
+        s = Slot{};
+        s.system = system; s.poi = poi; s.gx = gx; s.gy = gy;
+        bySlot_[key(system, poi)] = id;
+        return id;
+    }
+
+    void removeSlot(int id) {
+        Slot& s = slots_[id];
+        for (int k = 0; k < KINDS; k++)
+            for (int g = 0; g < (int)Good::COUNT; g++) setBest(id, (Kind)k, g, Best{});
+        bySlot_.erase(key(s.system, s.poi));
+        s.system = -1;
+        free_.push_back(id);
+    }
+
+    // Moves slot `id`'s entry in the (k, g) ranking; only positive spreads rank.
+    void setBest(int id, Kind k, int g, const Best& b) {
+        Best& cur = slots_[id].best[k][g];
+        int before = cur.sell - cur.buy, after = b.sell - b.buy;
+        if (before > 0) rank_[k][g].erase({ before, id });
+        cur = b;
+        if (after > 0) rank_[k][g].insert({ after, id });
+        if (before > 0 || after > 0) topDirty_[k][g] = true;
+    }
+
+    // In-system partners: the priciest POI of the system, one pass per good.
+    void refreshSystem(const Galaxy& G, int system) {
+        const StarSystem& sys = G[system];
+        for (int g = 0; g < (int)Good::COUNT; g++) {
+            int best = -1, bestPrice = 0;
+            for (int p = 0; p < (int)sys.pois.size(); p++) {
+                int price = sys.pois[p].market.priceOf((Good)g);
+                if (best < 0 || price > bestPrice) { best = p; bestPrice = price; }
+            }
+            for (int p = 0; p < (int)sys.pois.size(); p++) {
+                auto it = bySlot_.find(key(system, p));
+                if (it == bySlot_.end()) continue;
+                setBest(it->second, InSystem, g,
+                        { sys.pois[p].market.priceOf((Good)g), bestPrice, system, best, sys.gx, sys.gy });
+            }
+        }
+    }
+
+    void requeryGood(const Galaxy& G, const PriceIndex& PI, int id, int g) {
+        const Slot& s = slots_[id];
+        int buy = G[s.system].pois[s.poi].market.priceOf((Good)g);
+        PriceIndex::Hit h = PI.priciest(G, (Good)g, s.gx, s.gy, ARBITRAGE_JUMPS * GALAXY_JUMP_RANGE);
+        if (h.system < 0) { setBest(id, Nearby, g, { buy, buy }); return; }   // keeps the buy price
+        SystemPos at = G.pos(h.system);
+        setBest(id, Nearby, g, { buy, (int)h.value, h.system, h.poi, at.gx, at.gy });
+    }
+
+    void requery(const Galaxy& G, const PriceIndex& PI, int id) {
+        for (int g = 0; g < (int)Good::COUNT; g++) requeryGood(G, PI, id, g);
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<int> free_;
+    std::unordered_map<uint64_t, int> bySlot_;          // (system, poi) -> slot
+    std::unordered_map<int, std::vector<int>> bySector_; // indexed sector -> slots
+    std::set<std::pair<int, int>> rank_[KINDS][(int)Good::COUNT];   // (spread, slot)
+    mutable std::vector<Trade> top_[KINDS][(int)Good::COUNT];
+    mutable bool topDirty_[KINDS][(int)Good::COUNT]{};
+    bool centered_ = false;
+    int cx_ = 0, cy_ = 0;
+};
+
+// ---------------- Route overlay ----------------
+// A plotted route, rasterized once onto its map: each cell on the leg into
+// hop i holds i (1-based, 0 = off the route), at every zoom level. Whether a
+// cell is behind or ahead of the ship is one compare against reached(), so
+// drawing is O(1) per cell and a jump only moves reached() forward.
+class RouteLayer {
+public:
+    enum Mark { Off = 0, Travelled = 1, Ahead = 2 };
+
+    void clear() { levels_.clear(); hops_.clear(); reached_ = 0; }
+    bool empty() const { return hops_.empty(); }
+    const std::vector<std::pair<int,int>>& hops() const { return hops_; }
+    std::pair<int,int> from() const { return from_; }
+    std::pair<int,int> to() const { return hops_.empty() ? from_ : hops_.back(); }
+
+    // `route` is the hop endpoints after (fromX, fromY), as buildRoute makes them.
+    void set(int fromX, int fromY, const std::vector<std::pair<int,int>>& route, int w, int h, int levelCount = 1) {
+        clear();
+        from_ = { fromX, fromY };
+        hops_ = route;
+        int lw = std::max(1, w), lh = std::max(1, h);
+        for (int k = 0; k < std::max(1, levelCount); k++) {
+            levels_.push_back({ lw, lh, std::vector<uint16_t>((size_t)lw * lh, 0) });
+            lw = (lw + 1) / 2; lh = (lh + 1) / 2;
+        }
+        int x0 = fromX, y0 = fromY;
+        for (int i = 0; i < (int)route.size(); i++) {
+            int x1 = route[i].first, y1 = route[i].second;
+            int n = chebyshev(x0, y0, x1, y1);
+            for (int t = 1; t <= n; t++)
+                mark(x0 + (int)std::lround((double)(x1 - x0) * t / n), y0 + (int)std::lround((double)(y1 - y0) * t / n), i + 1);
+            x0 = x1; y0 = y1;
+        }
+    }
+
+    // (x, y) in tiles of 2^level coordinates.
+    Mark at(int x, int y, int level = 0) const {
+        if (level >= (int)levels_.size()) return Off;
+        const Level& L = levels_[level];
+        if (x < 0 || y < 0 || x >= L.w || y >= L.h) return Off;
+        uint16_t hop = L.hop[(size_t)y * L.w + x];
+        return hop == 0 ? Off : (hop <= reached_ ? Travelled : Ahead);
+    }
+
+    // The ship arrived at (x, y); a later hop there marks the route up to it travelled.
+    void arrive(int x, int y) {
+        if (levels_.empty() || x < 0 || y < 0 || x >= levels_[0].w || y >= levels_[0].h) return;
+        int hop = levels_[0].hop[(size_t)y * levels_[0].w + x];
+        if (hop > reached_ && hops_[hop - 1] == std::make_pair(x, y)) reached_ = hop;
+    }
+    int reached() const { return reached_; }
+    void setReached(int hop) { reached_ = termui::clampi(hop, 0, (int)hops_.size()); }
+
+private:
+    struct Level { int w = 0, h = 0; std::vector<uint16_t> hop; };
+
+    // Tiles keep the latest leg through them, so a tile reads "ahead" while
+    // any of it is.
+    void mark(int x, int y, int hop) {
+        for (int k = 0; k < (int)levels_.size(); k++) {
+            Level& L = levels_[k];
+            int tx = x >> k, ty = y >> k;
+            if (x < 0 || y < 0 || tx >= L.w || ty >= L.h) return;
+            uint16_t& c = L.hop[(size_t)ty * L.w + tx];
+            c = (uint16_t)std::max<int>(c, hop);
+        }
+    }
+
+    std::vector<Level> levels_;
+    std::vector<std::pair<int,int>> hops_;
+    std::pair<int,int> from_{ 0, 0 };
+    int reached_ = 0;
+};
+
+// ---------------- Scheduler ----------------
+// Timed events keyed on absolute game week (GameDate::weeks). Advancing time
+// pops only the events that came due, so a tick costs O(fired * log pending)
+// no matter how many missions or docks exist. Handlers whose subject changed
+// meanwhile (a mission already delivered, a ship that left the dock) check
+// for that and do nothing. Ties fire in the order they were scheduled.
+// An event may also carry a `live` check so waiting for the next event skips
+// ones that would do nothing.
+struct GameState;
+
+class Scheduler {
+public:
+    using Handler = std::function<void(GameState&)>;
+    using Live = std::function<bool(const GameState&)>;
+
+    void at(int week, Handler fn, Live live = nullptr) {
+        events_.push_back({ week, seq_++, std::move(fn), std::move(live) });
+        std::push_heap(events_.begin(), events_.end(), Later{});
+    }
+
+    // Week of the earliest pending event, or -1 if none.
+    int nextWeek() const { return events_.empty() ? -1 : events_.front().week; }
+
+    // Like nextWeek, but first drops leading events whose live check fails.
+    int nextLiveWeek(const GameState& S) {
+        while (!events_.empty() && events_.front().live && !events_.front().live(S)) {
+            std::pop_heap(events_.begin(), events_.end(), Later{});
+            events_.pop_back();
+        }
+        return nextWeek();
+    }
+    size_t pending() const { return events_.size(); }
+    void clear() { events_.clear(); seq_ = 0; }
+
+    // Removes the earliest event due at or before `week` into `fn`.
+    bool popDue(int week, Handler& fn) {
+        if (events_.empty() || events_.front().week > week) return false;
+        std::pop_heap(events_.begin(), events_.end(), Later{});
+        fn = std::move(events_.back().fn);
+        events_.pop_back();
+        return true;
+    }
+
+private:
+    struct Event { int week; uint64_t seq; Handler fn; Live live; };
+    struct Later {
+        bool operator()(const Event& a, const Event& b) const {
+            return a.week != b.week ? a.week > b.week : a.seq > b.seq;
+        }
+    };
+    std::vector<Event> events_;
+    uint64_t seq_ = 0;
+};
+
+// ---------------- Contract scoring ----------------
+// Rates every offered and active contract: weeks to deliver against the
+// deadline, fuel against the tank, room in the hold, and the cheapest buy
+// point near the ship, giving an expected net profit and risk flags.
+//
+// The main thread snapshots what a score needs into a Job (plain data; the
+// price lookups happen there, since the galaxy cache is main-thread only)
+// and submit()s it. evaluate() runs on a worker thread; poll() adopts the
+// finished Result. Jobs carry a key of their inputs, so a score is reused
+// until something it depends on changes. A newer job replaces a queued one.
+enum ContractRisk : uint8_t {
+    RISK_LATE  = 1,     // cannot make the deadline
+    RISK_TIGHT = 2,     // uses over 3/4 of the time left
+    RISK_FUEL  = 4,     // needs more fuel than aboard: refuel on the way
+    RISK_RANGE = 8,     // a leg is longer than a full tank reaches
+    RISK_CARGO = 16,    // not enough free hold for the goods
+    RISK_CASH  = 32,    // cannot afford the goods
+    RISK_SOURCE = 64,   // no seller of the goods within a tank
+};
+constexpr int RISK_BITS = 7;    // flags above, lowest bit first
+static_assert(RISK_SOURCE == 1 << (RISK_BITS - 1), "RISK_BITS must cover every ContractRisk flag");
+
+struct ContractScore {
+    bool valid = false;
+    int net = 0;                    // reward - goods - fuel, in CR
+    int weeks = 0, weeksLeft = 0;   // route time vs time allowed
+    int fuel = 0;                   // fuel units the route burns
+    uint8_t risk = 0;               // ContractRisk bits
+    int buySystem = -1, buyPoi = -1, buyPrice = 0;   // -1: nothing to buy
+};
+
+class ContractScorer {
+public:
+    struct Contract { bool open = false; int toGx = 0, toGy = 0; Good good = Good::Ore; int amount = 0, reward = 0, weeksLeft = 0; };
+    struct BuyPoint { int gx = 0, gy = 0, system = -1, poi = -1, price = 0; };
+    struct Job {
+        uint64_t key = 0;
+        int gx = 0, gy = 0, fuel = 0, fuelMax = 0, cargoFree = 0, credits = 0, fuelPrice = 0;
+        int have[(int)Good::COUNT]{};
+        std::vector<Contract> offers, missions;
+        std::vector<BuyPoint> buy[(int)Good::COUNT];   // candidates per good, any order
+    };
+    struct Result { uint64_t key = 0; std::vector<ContractScore> offers, missions; };
+
+    ContractScorer() = default;
+    ~ContractScorer() { stop(); }
+    ContractScorer(const ContractScorer&) = delete;
+    ContractScorer& operator=(const ContractScorer&) = delete;
+
+    // Called on the worker thread after each result, e.g. to wake a loop.
+    void setOnReady(std::function<void()> fn) {
+        std::lock_guard<std::mutex> lk(mu_);
+        onReady_ = std::move(fn);
+    }
+
+    uint64_t submittedKey() const { return submitted_; }
+    void submit(Job job) {
+        submitted_ = job.key;
+        start();
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            pending_.reset(new Job(std::move(job)));
+        }
+        cv_.notify_one();
+    }
+
+    // Adopts a finished result, if any. True if result() changed.
+    bool poll() {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!ready_) return false;
+        result_ = std::move(*ready_);
+        ready_.reset();
+        return true;
+    }
+    const Result& result() const { return result_; }
+
+    static Result evaluate(const Job& J) {
+        Result R;
+        R.key = J.key;
+        auto score = [&](const Contract& c) {
+            ContractScore s;
+            if (!c.open) return s;
+            s.valid = true;
+            s.weeksLeft = c.weeksLeft;
+            int tankRange = J.fuelMax / GALAXY_FUEL_PER_JUMP * GALAXY_JUMP_RANGE;
+            int units = std::max(0, c.amount - J.have[(int)c.good]);
+
+            // Route ship -> buy point -> destination; with nothing to buy, direct.
+            auto plan = [&](const BuyPoint* b, ContractScore& out) {
+                int d1 = b ? chebyshev(J.gx, J.gy, b->gx, b->gy) : 0;
+                int d2 = b ? chebyshev(b->gx, b->gy, c.toGx, c.toGy) : chebyshev(J.gx, J.gy, c.toGx, c.toGy);
+                out.weeks = jumpsRequired(d1, GALAXY_JUMP_RANGE) + jumpsRequired(d2, GALAXY_JUMP_RANGE);
+                out.fuel = out.weeks * GALAXY_FUEL_PER_JUMP;
+                int goods = b ? units * b->price : 0;
+                out.net = c.reward - goods - out.fuel * J.fuelPrice;
+                out.risk = 0;
+                if (out.weeks > c.weeksLeft) out.risk |= RISK_LATE;
+                else if (out.weeks * 4 > c.weeksLeft * 3) out.risk |= RISK_TIGHT;
+                if (out.fuel > J.fuel) out.risk |= RISK_FUEL;
+                if (std::max(d1, d2) > tankRange) out.risk |= RISK_RANGE;
+                if (units > J.cargoFree) out.risk |= RISK_CARGO;
+                if (goods > J.credits) out.risk |= RISK_CASH;
+                out.buySystem = b ? b->system : -1;
+                out.buyPoi = b ? b->poi : -1;
+                out.buyPrice = b ? b->price : 0;
+            };
+
+            if (units == 0) { plan(nullptr, s); return s; }
+            // Best net among routes that make the deadline, else the fastest.
+            bool have = false;
+            for (const BuyPoint& b : J.buy[(int)c.good]) {
+                ContractScore t = s;
+                plan(&b, t);
+                bool late = (t.risk & RISK_LATE) != 0, bestLate = (s.risk & RISK_LATE) != 0;
+                if (!have || (late != bestLate ? !late : late ? t.weeks < s.weeks : t.net > s.net)) { s = t; have = true; }
+            }
+            if (!have) { plan(nullptr, s); s.risk |= RISK_SOURCE; }
+            return s;
+        };
+        for (const Contract& c : J.offers) R.offers.push_back(score(c));
+        for (const Contract& c : J.missions) R.missions.push_back(score(c));
+        return R;
+    }
+
+private:
+    void start() {
+        if (worker_.joinable()) return;
+        worker_ = std::thread([this]() {
+            ALLOC_SCOPE(Missions);
+            std::unique_lock<std::mutex> lk(mu_);
+            while (true) {
+                cv_.wait(lk, [&] { return stop_ || pending_; });
+                if (stop_) return;
+                std::unique_ptr<Job> job = std::move(pending_);
+                lk.unlock();
+                Result r = evaluate(*job);
+                lk.lock();
+                ready_.reset(new Result(std::move(r)));
+                if (onReady_) onReady_();
+            }
+        });
+    }
+
+    void stop() {
+        if (!worker_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    uint64_t submitted_ = 0;
+    Result result_;                 // main thread only
+
+    // shared with the worker
+    std::function<void()> onReady_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::unique_ptr<Job> pending_;
+    std::unique_ptr<Result> ready_;
+    bool stop_ = false;
+    std::thread worker_;
+};
+
+// ---------------- System best-price helpers (word-of-mouth) ----------------
+struct BestInfo {
+    int minPrice = 0, maxPrice = 0;
+    int minPoi = -1, maxPoi = -1;
+};
+
+static BestInfo computeBestInSystem(const StarSystem& sys, Good g) {
+    BestInfo bi{};
+    bi.minPrice = 1e9; bi.maxPrice = -1e9;
+
+    for (int i=0;i<(int)sys.pois.size();i++) {
+        int p = sys.pois[i].market.priceOf(g);
+        if (p < bi.minPrice) { bi.minPrice = p; bi.minPoi = i; }
+        if (p > bi.maxPrice) { bi.maxPrice = p; bi.maxPoi = i; }
+    }
+    if (bi.minPoi < 0) bi.minPoi = 0;
+    if (bi.maxPoi < 0) bi.maxPoi = 0;
+    return bi;
+}
+
 // ---------------- Game ----------------
 enum class Screen { Galaxy, System, Market };
-enum class SidebarPage { Status, Cargo, Missions }; // NEW: Missions page
+enum class SidebarPage { Status, Cargo, Missions, Fleet, Prices, Trades };
+
+// What the map panel showed when it was last drawn (see drawMapView).
+struct MapFrame {
+    bool valid = false;
+    uint32_t clears = 0;            // Canvas::clearCount() then
+    termui::Rect view;              // cell area, in console coordinates
+    uint64_t content = 0;           // mapContentKey() then
+    int camX = 0, camY = 0, curX = 0, curY = 0;   // in map cells
+};
+
+// Write generations of the shared state (see Memo). Markets and ships keep
+// their own: Market::version, StarSystem::marketsVersion, Fleet::gen.
+struct StateGen {
+    uint64_t world = 0;         // galaxy reset (new seed or catalog)
+    uint64_t date = 0;
+    uint64_t markets = 0;       // any market anywhere
+    uint64_t missions = 0;      // activeMissions
+    uint64_t offers = 0;        // poiOffers
+};
+
+// Delivery targets of the active missions, for map markers and hover lines.
+struct MissionTargets {
+    std::unordered_map<int, int> perSystem;   // active deliveries per system
+    std::vector<int> firstAtPoi;              // currentSystem's POIs: first mission there, or -1
+};
+
+// The log panel as a window onto the journal. Rows are matches of the
+// filter, newest first; `top` is the rank of the first row shown.
+struct LogView {
+    journal::Search search;
+    uint64_t top = 0;
+    bool live = true;           // at the newest entry, following new ones
+    uint64_t floor = 0;         // the live view starts here (L, travel)
+    int kind = -1;              // journal::Kind shown, -1 = all
+    std::wstring text;          // search text
+    bool editing = false;       // search prompt open
+    std::wstring draft;
+    int rows = 0, shown = 0;    // panel rows / rows filled, as last drawn
+};
 
 struct GameState {
     GameDate date;
+    Scheduler events;           // timed events, see Scheduler
+    int visitCounter = 0;       // source of dockVisit ids
+
+    // Server mode: runs `fn` with the seat whose dockVisit is `visit` swapped
+    // in, for events that come due while another operator is acting.
+    std::function<void(int visit, const Scheduler::Handler& fn)> withVisitSeat;
 
 	int seed;
 
@@ -160,65 +2076,127 @@ struct GameState {
 
 
     Player P;
-    std::vector<StarSystem> galaxy;
+    Fleet fleet;
+    int pilot = 0;              // fleet ship this seat flies
+    Galaxy galaxy;              // sector cache; see Galaxy
+    int galaxyW = GALAXY_W, galaxyH = GALAXY_H;   // extent; a catalog file sets its own
+    PriceHistory prices;        // per-market price/stock history
+    PriceIndex priceIndex;      // galaxy-wide price queries
+    ArbitrageIndex arbitrage;   // best trades around the ship (Trades page)
+    ContractScorer scorer;      // offer / mission scores, see refreshContractScores
 
     Screen screen = Screen::Galaxy;
     SidebarPage sidePage = SidebarPage::Status;
 
     // Galaxy
-    int gCurX=0, gCurY=0, gCamX=0, gCamY=0;
+    int gCurX=0, gCurY=0, gCamX=0, gCamY=0;   // camera is in tiles at gZoom
+    int gZoom = 0;                            // map shows 2^gZoom coordinates per cell
+    int gViewCols = 0, gViewRows = 0;         // last drawn map size in cells
     int currentSystem = 0;
+    GalaxyMip galaxyMip;
+    FuelReach reach;                          // galaxy map fuel overlay
 
     // System
     int sCurX=0, sCurY=0, sCamX=0, sCamY=0;
-    int shipX=0, shipY=0;
+
+    MapFrame lastMap;                         // map panel as last drawn, for in-place pans
 
     // Market
     int marketSel = 0;
     bool marketModeBuy = true;
 
-    // Log
+    // Log: the latest lines in memory, and every line in the journal
     std::deque<std::wstring> log;
+    journal::Journal journal;   // open in interactive play only
+    LogView logView;
 
     // Missions
     std::vector<Mission> activeMissions;
 
     // NEW: offers available at current POI
     int dockPoiIndex = 0;
+    int dockVisit = 0;          // unique per dock/undock; stale refreshes check it
     std::vector<Mission> poiOffers;
     int offerSel = 0;
 
-    void pushLog(const std::wstring& s) {
+    void pushLog(const std::wstring& s, journal::Kind kind = journal::Kind::Info) {
+        ALLOC_SCOPE(Log);
         log.push_front(s);
         while(log.size()>200) log.pop_back();
+        journal.append((uint32_t)date.weeks, kind, s);
     }
-    void clearLog() { log.clear(); }
+    // Clears the panel; the journal keeps everything for scrollback.
+    void clearLog() { log.clear(); logView.floor = journal.size(); }
 	
-	// Galaxy ship position (can be empty space)
-	int shipGX = 0, shipGY = 0;
-	
-	// Route overlay
-	std::vector<std::pair<int,int>> routeGalaxy;
-	std::vector<std::pair<int,int>> routeSystem;
+	// Route overlay (R); the system route belongs to currentSystem
+	RouteLayer routeGalaxy;
+	RouteLayer routeSystem;
 	bool showRouteGalaxy = false;
 	bool showRouteSystem = false;
 
+	// Where POIs are this week, for the systems being viewed or travelled
+	OrbitCache orbits;
+
+	// Performance overlay (F3), drawn in the HUD
+	bool showPerf = false;
+	perf::FrameStats frameStats;
+
+	// Write generations and the derived views memoized against them
+	StateGen gen;
+	Memo<std::array<BestInfo, (int)Good::COUNT>, std::tuple<uint64_t, int, uint32_t>> bestInSystem;
+	Memo<MissionTargets, std::tuple<uint64_t, uint64_t, int>> missionTargets;
+
 };
 
+// Scanned once per change of the active set (or of the current system).
+static const MissionTargets& missionTargets(const GameState& S) {
+    return S.missionTargets.get(std::make_tuple(S.gen.world, S.gen.missions, S.currentSystem), [&]() {
+        MissionTargets t;
+        t.firstAtPoi.assign(S.galaxy.size() ? S.galaxy[S.currentSystem].pois.size() : 0, -1);
+        for (int i = 0; i < (int)S.activeMissions.size(); i++) {
+            const Mission& m = S.activeMissions[i];
+            if (!m.active || m.completed) continue;
+            t.perSystem[m.toSystem]++;
+            if (m.toSystem == S.currentSystem && m.toPoi >= 0 && m.toPoi < (int)t.firstAtPoi.size()
+                && t.firstAtPoi[m.toPoi] < 0)
+                t.firstAtPoi[m.toPoi] = i;
+        }
+        return t;
+    });
+}
+
 bool hasMissionAtSystem(const GameState& S, int systemIndex)
 {
-    for (const Mission& m : S.activeMissions)
-    {
-        if (m.active && !m.completed && m.toSystem == systemIndex)
-            return true;
-    }
-    return false;
+    return missionTargets(S).perSystem.count(systemIndex) != 0;
+}
+
+// Keeps the galaxy map's mission-target counts in step with the active set.
+static void missionTargetChanged(GameState& S, const Mission& m, int delta) {
+    S.gen.missions++;
+    if (m.toSystem < 0 || m.toSystem >= S.galaxy.size()) return;
+    SystemPos p = S.galaxy.pos(m.toSystem);
+    S.galaxyMip.addMissionTarget(p.gx, p.gy, delta);
+}
+
+// Every market write goes through writeMarket, and once something has
+// actually changed, marketWritten: views cached against the market's version
+// (and its system's) see the change and the sector keeps it when evicted.
+static Market& writeMarket(GameState& S, int system, int poi) {
+    return S.galaxy.mut(system).pois[poi].market;
+}
+
+static void marketWritten(GameState& S, int system, int poi) {
+    StarSystem& sys = S.galaxy.mut(system);
+    S.gen.markets++;
+    sys.marketsVersion++;
+    sys.pois[poi].market.version++;
+    S.galaxy.markDirty(system);
 }
 
 int estimateGalaxyTravelWeeks(const GameState& S, int fromSystem, int toSystem)
 {
-    const StarSystem& a = S.galaxy[fromSystem];
-    const StarSystem& b = S.galaxy[toSystem];
+    SystemPos a = S.galaxy.pos(fromSystem);
+    SystemPos b = S.galaxy.pos(toSystem);
 
     int dist = chebyshev(a.gx, a.gy, b.gx, b.gy);
 
@@ -237,59 +2215,36 @@ static std::vector<std::pair<int,int>> buildRoute(int sx,int sy,int tx,int ty,in
     }
     return out;
 }
-static bool routeContains(const std::vector<std::pair<int,int>>& r, int x, int y){
-    for (auto& p : r) if (p.first==x && p.second==y) return true;
-    return false;
-}
 
 static int systemIndexAtGalaxy(const GameState& S, int gx, int gy){
-    for (int i=0;i<(int)S.galaxy.size();i++){
-        if (S.galaxy[i].gx==gx && S.galaxy[i].gy==gy) return i;
-    }
-    return -1;
+    return S.galaxy.systemAt(gx, gy);
 }
 
 
 
-// Returns true if any active mission targets this system. Also counts how many.
+// Active missions delivering to this system.
 static int countMissionsToSystem(const GameState& S, int systemIndex) {
-    int c = 0;
-    for (const auto& m : S.activeMissions) {
-        if (!m.active || m.completed) continue;
-        if (m.toSystem == systemIndex) c++;
-    }
-    return c;
+    const auto& per = missionTargets(S).perSystem;
+    auto it = per.find(systemIndex);
+    return it == per.end() ? 0 : it->second;
 }
 
 // Returns true if any active mission targets this exact POI in the current system.
 // If found, fills out short details for display.
-static bool firstMissionToPoiHere(const GameState& S, int poiIndex, Mission& out) {
-    for (const auto& m : S.activeMissions) {
-        if (!m.active || m.completed) continue;
-        if (m.toSystem == S.currentSystem && m.toPoi == poiIndex) {
-            out = m;
-            return true;
-        }
-    }
-    return false;
-}
-
-// ---------------- RNG ----------------
-static uint32_t hash32(uint32_t x){
-    x ^= x >> 16; x *= 0x7feb352dU;
-    x ^= x >> 15; x *= 0x846ca68bU;
-    x ^= x >> 16;
-    return x;
-}
-
-static Market makeMarket(uint32_t seed, PoiType t) {
-    Market m{};
-    uint32_t s = hash32(seed);
-    auto rand01 = [&]() -> int { s = hash32(s); return (int)(s % 100); };
+static bool firstMissionToPoiHere(const GameState& S, int poiIndex, Mission& out) {
+    const auto& first = missionTargets(S).firstAtPoi;
+    if (poiIndex < 0 || poiIndex >= (int)first.size() || first[poiIndex] < 0) return false;
+    out = S.activeMissions[first[poiIndex]];
+    return true;
+}
+
+// ---------------- RNG ----------------
+using rng::hash32;
 
-    int base[(int)Good::COUNT] = { 18, 10, 32, 25, 80, 60 };
-    int mod[(int)Good::COUNT]{};
+static const int MARKET_BASE_PRICE[(int)Good::COUNT] = { 18, 10, 32, 25, 80, 60 };
 
+static void marketTypeModifiers(PoiType t, int mod[(int)Good::COUNT]) {
+    for (int i=0;i<(int)Good::COUNT;i++) mod[i] = 0;
     if (t == PoiType::Planet) {
         mod[(int)Good::Food] = -4; mod[(int)Good::Water] = -2;
         mod[(int)Good::Ore]  = +4; mod[(int)Good::Fuel]  = +2;
@@ -298,10 +2253,19 @@ static Market makeMarket(uint32_t seed, PoiType t) {
     } else {
         mod[(int)Good::Meds] = +10; mod[(int)Good::Fuel] = +8;
     }
+}
+
+static Market makeMarket(uint32_t seed, PoiType t) {
+    Market m{};
+    uint32_t s = hash32(seed);
+    auto rand01 = [&]() -> int { s = hash32(s); return (int)(s % 100); };
+
+    int mod[(int)Good::COUNT];
+    marketTypeModifiers(t, mod);
 
     for(int i=0;i<(int)Good::COUNT;i++){
         int jitter = (rand01() - 50) / 5;
-        int p = base[i] + mod[i] + jitter;
+        int p = MARKET_BASE_PRICE[i] + mod[i] + jitter;
         if (p < 1) p = 1;
         m.price[i] = p;
         m.stock[i] = 50 + rand01();
@@ -309,48 +2273,328 @@ static Market makeMarket(uint32_t seed, PoiType t) {
     return m;
 }
 
+// Batch makeMarket: out[i] == makeMarket(seeds[i], types[i]). Each market's
+// hash chain is sequential, so the chains of many markets run side by side,
+// one SIMD lane per market.
+static void makeMarkets(const uint32_t* seeds, const PoiType* types, Market* out, size_t n) {
+    constexpr size_t BLOCK = 256;
+    uint32_t s[BLOCK];
+    int mod[3][(int)Good::COUNT];
+    marketTypeModifiers(PoiType::Planet,  mod[(int)PoiType::Planet]);
+    marketTypeModifiers(PoiType::Station, mod[(int)PoiType::Station]);
+    marketTypeModifiers(PoiType::Outpost, mod[(int)PoiType::Outpost]);
+
+    for (size_t b = 0; b < n; b += BLOCK) {
+        size_t cnt = std::min(BLOCK, n - b);
+        Market* m = out + b;
+        const PoiType* t = types + b;
+        for (size_t i = 0; i < cnt; i++) m[i] = Market{};
+
+        rng::hash32Batch(seeds + b, s, cnt);
+        for (int g = 0; g < (int)Good::COUNT; g++) {
+            rng::hash32Batch(s, s, cnt);
+            for (size_t i = 0; i < cnt; i++) {
+                int jitter = ((int)(s[i] % 100) - 50) / 5;
+                m[i].price[g] = std::max(1, MARKET_BASE_PRICE[g] + mod[(int)t[i]][g] + jitter);
+            }
+            rng::hash32Batch(s, s, cnt);
+            for (size_t i = 0; i < cnt; i++) m[i].stock[g] = 50 + (int)(s[i] % 100);
+        }
+    }
+}
+
 // ---------------- POI helpers ----------------
-static int poiIndexAt(const StarSystem& sys, int x, int y) {
-    for (int i=0;i<(int)sys.pois.size();i++) if (sys.pois[i].x==x && sys.pois[i].y==y) return i;
-    return -1;
+// All of these see the POIs where they are this week.
+static const OrbitCache::Layout& systemLayout(const GameState& S, int system) {
+    return S.orbits.at(S.galaxy, system, S.date.weeks);
 }
-static int nearestPoiIndex(const StarSystem& sys, int x, int y) {
-    int best=-1, bestD=1e9;
-    for(int i=0;i<(int)sys.pois.size();i++){
-        int d = manhattan(x,y,sys.pois[i].x,sys.pois[i].y);
-        if (d < bestD){ bestD=d; best=i; }
+static int poiIndexAt(const GameState& S, int system, int x, int y) {
+    return systemLayout(S, system).poiAt(x, y);
+}
+static int nearestPoiIndex(const GameState& S, int system, int x, int y) {
+    return systemLayout(S, system).nearest(x, y);
+}
+static PoiPos poiPos(const GameState& S, int system, int poi) {
+    return systemLayout(S, system).pos[poi];
+}
+
+// ---------------- Fleet orders ----------------
+// Moves every travelling ship through `weeks` of jumps toward (tx,ty) in one
+// step. A ship jumps once per week while it has fuel and has not arrived, and
+// each jump moves each axis up to GALAXY_JUMP_RANGE (as stepToward does), so
+// after j jumps an axis has covered min(|d|, j * range). That closed form
+// keeps the loop branch-free and independent of `weeks`. The columns never
+// alias, and saying so on the parameters lets the compiler vectorize it
+// without runtime overlap checks. Returns how many travelling ships now sit
+// on their target.
+static int fleetJumpColumns(int n, int weeks, int* __restrict gx, int* __restrict gy, int* __restrict fuel,
+                            const int* __restrict tx, const int* __restrict ty,
+                            const uint8_t* __restrict order) {
+    const int R = GALAXY_JUMP_RANGE;
+    int arrivals = 0;
+    for (int i = 0; i < n; i++) {
+        int travel = (order[i] == (uint8_t)ShipOrder::Travel);
+        int dx = tx[i] - gx[i], ax = std::abs(dx);
+        int dy = ty[i] - gy[i], ay = std::abs(dy);
+        int need = (std::max(ax, ay) + R - 1) / R;
+        int jumps = travel * std::min(std::min(weeks, fuel[i] / GALAXY_FUEL_PER_JUMP), need);
+        int mx = std::min(ax, jumps * R);
+        int my = std::min(ay, jumps * R);
+        gx[i] += (dx < 0) ? -mx : mx;
+        gy[i] += (dy < 0) ? -my : my;
+        fuel[i] -= jumps * GALAXY_FUEL_PER_JUMP;
+        arrivals += travel & (mx == ax) & (my == ay);
     }
-    return best;
+    return arrivals;
+}
+
+// Runs `weeks` of standing orders. Ships that reached their target switch to
+// Hold and are appended to `arrived`.
+static void fleetMove(Fleet& F, int weeks, std::vector<int>& arrived) {
+    const int n = F.size();
+    int arrivals = fleetJumpColumns(n, weeks, F.gx.data(), F.gy.data(), F.fuel.data(), F.tx.data(), F.ty.data(), F.order.data());
+    if (arrivals == 0) return;
+
+    // Arrivals are rare; collect them in a second pass so the jump loop
+    // stays free of branches.
+    for (int i = 0; i < n; i++) {
+        if (F.order[i] == (uint8_t)ShipOrder::Travel && F.gx[i] == F.tx[i] && F.gy[i] == F.ty[i]) {
+            F.order[i] = (uint8_t)ShipOrder::Hold;
+            arrived.push_back(i);
+        }
+    }
+}
+
+// Applies `weeks` of fleet orders and docks arriving ships at the first POI of
+// the system they reached. Manned ships never have a standing order.
+static void fleetTick(GameState& S, int weeks) {
+    TRACE_SCOPE("fleetTick");
+    Fleet& F = S.fleet;
+    std::vector<int> arrived;
+    fleetMove(F, weeks, arrived);
+    if (arrived.empty()) return;
+
+    int docked = 0;
+    for (int ship : arrived) {
+        int sys = systemIndexAtGalaxy(S, F.gx[ship], F.gy[ship]);
+        if (sys < 0) continue;
+        PoiPos poi = poiPos(S, sys, 0);
+        F.sx[ship] = poi.x;
+        F.sy[ship] = poi.y;
+        docked++;
+    }
+
+    std::wstringstream oss;
+    oss << L"Fleet: " << arrived.size() << L" ship(s) arrived, " << docked << L" docked.";
+    S.pushLog(oss.str(), journal::Kind::Fleet);
+}
+
+// Sends every holding ship (not the manned ones) to galaxy position (tx,ty).
+static void fleetOrderTravel(GameState& S, int tx, int ty) {
+    Fleet& F = S.fleet;
+    int sent = 0, weeks = 0;
+    for (int i = 0; i < F.size(); i++) {
+        if (F.order[i] != (uint8_t)ShipOrder::Hold) continue;
+        F.order[i] = (uint8_t)ShipOrder::Travel;
+        F.tx[i] = tx; F.ty[i] = ty;
+        weeks = std::max(weeks, jumpsRequired(chebyshev(F.gx[i], F.gy[i], tx, ty), GALAXY_JUMP_RANGE));
+        sent++;
+    }
+
+    std::wstringstream oss;
+    if (sent == 0) oss << L"Fleet: No idle ships to send.";
+    else oss << L"Fleet: " << sent << L" ship(s) ordered to (" << tx << L"," << ty << L"), ETA " << weeks << L"w.";
+    S.pushLog(oss.str(), journal::Kind::Fleet);
+}
+
+// Buys a new ship at the current dock; it starts next to yours.
+static void buyShip(GameState& S) {
+    const SystemPoi& poi = S.galaxy[S.currentSystem].pois[S.dockPoiIndex];
+    if (poi.type != PoiType::Station) { S.pushLog(L"Shipyard: Ships are sold at stations.", journal::Kind::Fleet); return; }
+    if (S.P.credits < SHIP_PRICE) { S.pushLog(L"Shipyard: Not enough credits.", journal::Kind::Fleet); return; }
+
+    S.P.credits -= SHIP_PRICE;
+    int ship = S.fleet.add(S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
+    PoiPos at = poiPos(S, S.currentSystem, S.dockPoiIndex);
+    S.fleet.sx[ship] = at.x;
+    S.fleet.sy[ship] = at.y;
+
+    std::wstringstream oss;
+    oss << L"Shipyard: Bought ship #" << (ship + 1) << L" for " << SHIP_PRICE << L" CR.";
+    S.pushLog(oss.str(), journal::Kind::Fleet);
 }
 
 // ---------------- Economy & travel ----------------
 static void advanceWeek(GameState& S, int weeks) {
     S.date.advanceWeeks(weeks);
+    S.gen.date++;
     S.P.credits += S.incomeWeekly * weeks;   // currently 0
+    fleetTick(S, weeks);
 }
 static int ftlFuelCost(int dist) { return std::max(1, dist / 3); }
 
 // ---------------- Missions: deadlines + completion ----------------
-static void tickMissionDeadlines(GameState& S, int weeksAdvanced) {
-    for (auto& m : S.activeMissions) {
-        if (!m.active || m.completed) continue;
-        m.deadlineWeeks -= weeksAdvanced;
-    }
-    for (auto& m : S.activeMissions) {
-        if (!m.active || m.completed) continue;
-        if (m.deadlineWeeks < 0) {
-            m.active = false;
-			S.P.credits -= m.reward;
-            std::wstringstream oss;
-            oss << L"Mission FAILED: Delivery to " << S.galaxy[m.toSystem].name << L" expired.";
-            S.pushLog(oss.str());
+// Fires the week after a mission's last delivery week.
+static void expireMission(GameState& S, int missionIndex) {
+    ALLOC_SCOPE(Missions);
+    Mission& m = S.activeMissions[missionIndex];
+    if (!m.active || m.completed) return;   // delivered in time
+    m.active = false;
+    missionTargetChanged(S, m, -1);
+    S.P.credits -= m.reward;
+    std::wstringstream oss;
+    oss << L"Mission FAILED: Delivery to " << S.galaxy[m.toSystem].name << L" expired.";
+    S.pushLog(oss.str(), journal::Kind::Mission);
+}
+
+static void scheduleMissionExpiry(GameState& S, int missionIndex) {
+    S.events.at(S.activeMissions[missionIndex].dueWeek + 1,
+                [missionIndex](GameState& G) { expireMission(G, missionIndex); },
+                [missionIndex](const GameState& G) {
+                    if (missionIndex >= (int)G.activeMissions.size()) return false;
+                    const Mission& m = G.activeMissions[missionIndex];
+                    return m.active && !m.completed;
+                });
+}
+
+static int weeksLeft(const GameState& S, const Mission& m) { return m.dueWeek - S.date.weeks; }
+
+// ---- Contract scores ----
+// Everything a contract score depends on: ship, hold, wallet, dock, date,
+// prices and the contracts themselves, by their write generations.
+static uint64_t contractScoreKey(const GameState& S) {
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&](long long v) {
+        for (int i = 0; i < 8; i++) { h ^= (uint64_t)((v >> (8 * i)) & 0xFF); h *= 1099511628211ull; }
+    };
+    const Fleet& F = S.fleet;
+    mix(S.gen.world); mix(S.gen.date); mix(S.gen.markets); mix(S.gen.missions); mix(S.gen.offers);
+    mix(S.pilot); mix(F.gen[S.pilot]); mix(S.currentSystem); mix(S.dockPoiIndex); mix(S.dockVisit); mix(S.P.credits);
+    mix(F.gx[S.pilot]); mix(F.gy[S.pilot]); mix(F.fuel[S.pilot]); mix(F.fuelMax[S.pilot]); mix(F.cargoMax[S.pilot]);
+    return h;
+}
+
+// Queues a rescore when the key moved and adopts a finished one. The price
+// lookups run here (the galaxy is main-thread only); the scoring itself on
+// the scorer's worker, so the sidebar never waits for it.
+static void refreshContractScores(GameState& S) {
+    ALLOC_SCOPE(Missions);
+    S.scorer.poll();
+    uint64_t key = contractScoreKey(S);
+    if (key == S.scorer.submittedKey() || S.galaxy.size() == 0) return;
+
+    const Fleet& F = S.fleet;
+    ContractScorer::Job J;
+    J.key = key;
+    J.gx = F.gx[S.pilot]; J.gy = F.gy[S.pilot];
+    J.fuel = F.fuel[S.pilot]; J.fuelMax = F.fuelMax[S.pilot];
+    J.cargoFree = std::max(0, F.cargoMax[S.pilot] - F.cargoUsed(S.pilot));
+    J.credits = S.P.credits;
+    J.fuelPrice = S.galaxy[S.currentSystem].pois[S.dockPoiIndex].market.priceOf(Good::Fuel);
+    for (int g = 0; g < (int)Good::COUNT; g++) J.have[g] = F.cargo[g][S.pilot];
+
+    auto contract = [&](const Mission& m, int left) {
+        ContractScorer::Contract c;
+        c.open = m.active && !m.completed;
+        SystemPos to = S.galaxy.pos(m.toSystem);
+        c.toGx = to.gx; c.toGy = to.gy;
+        c.good = m.good; c.amount = m.amount; c.reward = m.reward; c.weeksLeft = left;
+        return c;
+    };
+    for (const Mission& m : S.poiOffers) J.offers.push_back(contract(m, m.deadlineWeeks));
+    for (const Mission& m : S.activeMissions) J.missions.push_back(contract(m, weeksLeft(S, m)));
+
+    // Buy candidates within a full tank of the ship, for each good a contract needs.
+    int radius = J.fuelMax / GALAXY_FUEL_PER_JUMP * GALAXY_JUMP_RANGE;
+    for (const auto* list : { &J.offers, &J.missions })
+        for (const ContractScorer::Contract& c : *list) {
+            auto& buy = J.buy[(int)c.good];
+            if (!c.open || !buy.empty()) continue;
+            for (const auto& h : S.priceIndex.cheapestPoints(S.galaxy, c.good, J.gx, J.gy, radius, 8)) {
+                SystemPos p = S.galaxy.pos(h.system);
+                buy.push_back({ p.gx, p.gy, h.system, h.poi, (int)h.value });
+            }
         }
+    S.scorer.submit(std::move(J));
+}
+
+// ---------------- Passing time ----------------
+// Every time-dependent system takes the whole delta in one call, so skipping
+// a year costs about as much as a single week.
+static constexpr int MAX_WAIT_WEEKS = GameDate::WEEKS_PER_YEAR;
+
+static void advanceTime(GameState& S, int weeks) {
+    if (weeks <= 0) return;
+    TRACE_SCOPE("advanceTime");
+    // Every ship sitting on a POI (any seat's, docked or parked) rides it
+    // round the star unless it jumped away meanwhile; a cursor on a POI
+    // follows it too.
+    struct Seated { int ship, system, poi; };
+    std::vector<Seated> seated;
+    Fleet& F = S.fleet;
+    for (int i = 0; i < F.size(); i++) {
+        int s = systemIndexAtGalaxy(S, F.gx[i], F.gy[i]);
+        int p = s >= 0 ? poiIndexAt(S, s, F.sx[i], F.sy[i]) : -1;
+        if (p >= 0) seated.push_back({ i, s, p });
+    }
+    int sys = S.currentSystem;
+    int cursorPoi = poiIndexAt(S, sys, S.sCurX, S.sCurY);
+
+    advanceWeek(S, weeks);
+
+    for (const Seated& st : seated) {
+        if (systemIndexAtGalaxy(S, F.gx[st.ship], F.gy[st.ship]) != st.system) continue;
+        PoiPos p = poiPos(S, st.system, st.poi);
+        F.sx[st.ship] = p.x; F.sy[st.ship] = p.y;
+    }
+    if (cursorPoi >= 0) {
+        PoiPos p = poiPos(S, sys, cursorPoi);
+        S.sCurX = p.x; S.sCurY = p.y;
     }
+
+    Scheduler::Handler fn;
+    while (S.events.popDue(S.date.weeks, fn)) fn(S);
+}
+
+// Weeks until something happens on its own: a scheduled event that is still
+// live or a fleet arrival. 0 if nothing is scheduled.
+static int weeksToNextEvent(GameState& S) {
+    int best = 0;
+    auto consider = [&](int w) { if (w > 0 && (best == 0 || w < best)) best = w; };
+
+    int next = S.events.nextLiveWeek(S);
+    if (next >= 0) consider(next - S.date.weeks);
+
+    const Fleet& F = S.fleet;
+    for (int i = 0; i < F.size(); i++) {
+        if (F.order[i] != (uint8_t)ShipOrder::Travel) continue;
+        int need = jumpsRequired(chebyshev(F.gx[i], F.gy[i], F.tx[i], F.ty[i]), GALAXY_JUMP_RANGE);
+        if (need <= F.fuel[i] / GALAXY_FUEL_PER_JUMP) consider(need);
+    }
+    return best;
+}
+
+// Wait in place for `weeks`, or until the next event when weeks <= 0.
+static void doWait(GameState& S, int weeks) {
+    TRACE_SCOPE("doWait");
+    if (weeks <= 0) {
+        weeks = weeksToNextEvent(S);
+        if (weeks <= 0) { S.pushLog(L"Wait: Nothing scheduled."); return; }
+    }
+    weeks = std::min(weeks, MAX_WAIT_WEEKS);
+
+    S.clearLog();
+    advanceTime(S, weeks);
+
+    std::wstringstream oss;
+    oss << L"Waited " << weeks << L" week(s). It is now " << S.date.toString() << L".";
+    S.pushLog(oss.str());
 }
 
 static void tryCompleteMissionsOnDock(GameState& S) {
+    ALLOC_SCOPE(Missions);
     const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
+    int shipSystem = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
 
     for (auto& m : S.activeMissions) {
         if (!m.active || m.completed) continue;
@@ -358,81 +2602,108 @@ static void tryCompleteMissionsOnDock(GameState& S) {
         if (m.toSystem != S.currentSystem) continue;
         if (m.toPoi != S.dockPoiIndex) continue;
 
-        int have = S.P.cargo[(int)m.good];
+        int have = S.fleet.cargo[(int)m.good][S.pilot];
         if (have >= m.amount) {
-            S.P.cargo[(int)m.good] -= m.amount;
+            S.fleet.cargo[(int)m.good][S.pilot] -= m.amount;
+            S.fleet.touch(S.pilot);
             S.P.credits += m.reward;
             m.completed = true;
             m.active = false;
+            missionTargetChanged(S, m, -1);
 
             std::wstringstream oss;
             oss << L"Mission COMPLETE: Delivered " << m.amount << L" " << goodNameW(m.good)
                 << L" to " << sys.pois[m.toPoi].name << L" (+" << m.reward << L" CR).";
-            S.pushLog(oss.str());
+            S.pushLog(oss.str(), journal::Kind::Mission);
         } else {
             std::wstringstream oss;
             oss << L"Delivery pending at " << sys.pois[m.toPoi].name << L": Need "
                 << (m.amount - have) << L" more " << goodNameW(m.good) << L".";
-            S.pushLog(oss.str());
+            S.pushLog(oss.str(), journal::Kind::Mission);
         }
     }
 }
 
 
 // ---------------- NEW: generate offers at a POI ----------------
-static void generateOffersForDock(GameState& S) {
-    const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
-    int poi = S.dockPoiIndex;
+struct DockRef { int system = 0, poi = 0; };
 
-    // deterministic-ish per (system, poi, date)
+// deterministic-ish per (system, poi, date)
+static uint32_t offerSeed(const GameState& S, const DockRef& d) {
     uint32_t seed = 0xBADC0DEu;
-    seed ^= (uint32_t)S.currentSystem * 0x9E3779B9u;
-    seed ^= (uint32_t)poi * 0x85EBCA6Bu;
-    seed ^= (uint32_t)(S.date.year * 131u + S.date.month * 17u + S.date.week);
-
-	seed ^= hash32(S.seed);
-
-    uint32_t r = hash32(seed);
-
-    auto roll = [&](int mod)->int {
-        r = hash32(r + (uint32_t)mod);
-        return (int)(r % 100);
-    };
-
-    S.poiOffers.clear();
-
-    int count = (roll(1) % 4); // 0..3 offers
-    for (int k=0;k<count;k++) {
-		Mission m{};
-		m.active = true;
-		m.fromSystem = S.currentSystem;
-		m.fromPoi    = poi;
-
-		int destSys = (int)(hash32(r + 100 + k) % (uint32_t)S.galaxy.size());
-		if (destSys == S.currentSystem) destSys = (destSys + 1) % (int)S.galaxy.size();
-		m.toSystem = destSys;
-
-		// NEW: pick a destination POI inside that system
-		const StarSystem& dst = S.galaxy[m.toSystem];
-		int destPoi = (int)(hash32(r + 150 + k) % (uint32_t)dst.pois.size());
-		m.toPoi = destPoi;
-
-		int gi = (int)(hash32(r + 200 + k) % (uint32_t)((int)Good::COUNT - 1));
-		Good g = (Good)gi;
-		if (g == Good::Fuel) g = Good::Ore;
-		m.good = g;
-
-		m.amount = 3 + (int)(hash32(r + 300 + k) % 10); // 3..12
+    seed ^= (uint32_t)d.system * 0x9E3779B9u;
+    seed ^= (uint32_t)d.poi * 0x85EBCA6Bu;
+    seed ^= (uint32_t)(S.date.year() * 131u + S.date.month() * 17u + S.date.week());
+    seed ^= hash32(S.seed);
+    return seed;
+}
 
-		int dist = manhattan(S.galaxy[S.currentSystem].gx, S.galaxy[S.currentSystem].gy,
-							 S.galaxy[m.toSystem].gx,      S.galaxy[m.toSystem].gy);
+// Offers posted this week at each of `docks` (out[i] is replaced). All the
+// hashes for a batch are produced by a few rng::hash32Batch calls; results
+// match the original one-hash-at-a-time generator exactly.
+static void generateOffersBatch(const GameState& S, const DockRef* docks, size_t n, std::vector<Mission>* out) {
+    constexpr int MAX_OFFERS = 3;
+    static const uint32_t SALT[5] = { 100, 150, 200, 300, 400 }; // dest sys, dest poi, good, amount, pay
+
+    std::vector<uint32_t> r(n), h(n * MAX_OFFERS * 5);
+    for (size_t d = 0; d < n; d++) r[d] = offerSeed(S, docks[d]);
+    rng::hash32Batch(r.data(), r.data(), n);             // r = hash32(seed)
+    for (auto& v : r) v += 1;
+    rng::hash32Batch(r.data(), r.data(), n);             // r = hash32(r + 1): the count roll
+
+    for (size_t d = 0; d < n; d++)
+        for (int k = 0; k < MAX_OFFERS; k++)
+            for (int j = 0; j < 5; j++)
+                h[(d * MAX_OFFERS + k) * 5 + j] = r[d] + SALT[j] + (uint32_t)k;
+    rng::hash32Batch(h.data(), h.data(), h.size());
+
+    for (size_t d = 0; d < n; d++) {
+        const DockRef& dock = docks[d];
+        std::vector<Mission>& offers = out[d];
+        offers.clear();
+
+        int count = (int)(r[d] % 100) % 4; // 0..3 offers
+        for (int k=0;k<count;k++) {
+            const uint32_t* hk = &h[(d * MAX_OFFERS + k) * 5];
+            Mission m{};
+            m.active = true;
+            m.fromSystem = dock.system;
+            m.fromPoi    = dock.poi;
+
+            int destSys = (int)(hk[0] % (uint32_t)S.galaxy.size());
+            if (destSys == dock.system) destSys = (destSys + 1) % (int)S.galaxy.size();
+            m.toSystem = destSys;
+
+            // NEW: pick a destination POI inside that system
+            const StarSystem& dst = S.galaxy[m.toSystem];
+            m.toPoi = (int)(hk[1] % (uint32_t)dst.pois.size());
+
+            Good g = (Good)(int)(hk[2] % (uint32_t)((int)Good::COUNT - 1));
+            if (g == Good::Fuel) g = Good::Ore;
+            m.good = g;
+
+            m.amount = 3 + (int)(hk[3] % 10); // 3..12
+
+            SystemPos from = S.galaxy.pos(dock.system);
+            int dist = manhattan(from.gx, from.gy, dst.gx, dst.gy);
+
+            m.deadlineWeeks = estimateGalaxyTravelWeeks(S, m.fromSystem, m.toSystem) * 3.0f + 10;
+            m.reward = 150 + m.amount * (25 + (int)(hk[4] % 45)) + dist * 10;
+
+            offers.push_back(m);
+        }
+    }
+}
 
-		m.deadlineWeeks = estimateGalaxyTravelWeeks(S, m.fromSystem, m.toSystem) * 3.0f + 10;
-		m.reward = 150 + m.amount * (25 + (int)(hash32(r + 400 + k) % 45)) + dist * 10;
+static void generateOffersForDock(GameState& S) {
+    TRACE_SCOPE("generateOffersForDock");
+    ALLOC_SCOPE(Missions);
+    const StarSystem& sys = S.galaxy[S.currentSystem];
+    int poi = S.dockPoiIndex;
 
-		S.poiOffers.push_back(m);
-	}
+    DockRef dock{ S.currentSystem, poi };
+    generateOffersBatch(S, &dock, 1, &S.poiOffers);
+    S.gen.offers++;
 
     S.offerSel = 0;
 
@@ -440,27 +2711,44 @@ static void generateOffersForDock(GameState& S) {
     if (!S.poiOffers.empty()) {
         std::wstringstream oss;
         oss << L"New contracts available at " << sys.pois[poi].name << L". Press E to open Missions.";
-        S.pushLog(oss.str());
+        S.pushLog(oss.str(), journal::Kind::Mission);
     } else {
         std::wstringstream oss;
         oss << L"No contracts posted at " << sys.pois[poi].name << L" this week.";
-        S.pushLog(oss.str());
+        S.pushLog(oss.str(), journal::Kind::Mission);
     }
 }
 
+// Contract boards repost at the start of each month while you stay docked.
+static void scheduleContractRefresh(GameState& S) {
+    int visit = S.dockVisit;
+    int nextMonth = (S.date.weeks / GameDate::WEEKS_PER_MONTH + 1) * GameDate::WEEKS_PER_MONTH;
+    S.events.at(nextMonth, [visit](GameState& G) {
+        auto refresh = [visit](GameState& H) {
+            if (H.dockVisit != visit) return;   // left since
+            generateOffersForDock(H);
+            scheduleContractRefresh(H);
+        };
+        if (G.dockVisit != visit && G.withVisitSeat) G.withVisitSeat(visit, refresh);
+        else refresh(G);
+    });
+}
+
 static void dockAtPoi(GameState& S, int poiIndex, bool autoOpenMissions) {
-    const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
+    int shipSystem = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
 
+    S.dockVisit = ++S.visitCounter;
     S.dockPoiIndex = poiIndex;
-    S.shipX = sys.pois[poiIndex].x;
-    S.shipY = sys.pois[poiIndex].y;
+    PoiPos at = poiPos(S, S.currentSystem, poiIndex);
+    S.fleet.sx[S.pilot] = at.x;
+    S.fleet.sy[S.pilot] = at.y;
 
     // NEW: attempt mission completions on docking
     tryCompleteMissionsOnDock(S);
 
     // Generate new offers at this dock
     generateOffersForDock(S);
+    scheduleContractRefresh(S);
 
     if (autoOpenMissions && !S.poiOffers.empty()) {
         S.sidePage = SidebarPage::Missions;
@@ -469,14 +2757,18 @@ static void dockAtPoi(GameState& S, int poiIndex, bool autoOpenMissions) {
 
 
 static void acceptSelectedOffer(GameState& S) {
+    ALLOC_SCOPE(Missions);
     if (S.poiOffers.empty()) return;
     S.offerSel = termui::clampi(S.offerSel, 0, (int)S.poiOffers.size()-1);
 
     Mission m = S.poiOffers[S.offerSel];
+    m.dueWeek = S.date.weeks + m.deadlineWeeks;
     S.activeMissions.push_back(m);
+    scheduleMissionExpiry(S, (int)S.activeMissions.size() - 1);
+    missionTargetChanged(S, m, +1);
 
     const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
+    int shipSystem = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
 	const StarSystem& dst = S.galaxy[m.toSystem];
 
 	std::wstringstream oss;
@@ -484,13 +2776,15 @@ static void acceptSelectedOffer(GameState& S) {
 		<< m.amount << L" " << goodNameW(m.good)
 		<< L" to " << dst.name << L" / " << dst.pois[m.toPoi].name
 		<< L" (" << m.deadlineWeeks << L"w).";
-	S.pushLog(oss.str());
+	S.pushLog(oss.str(), journal::Kind::Mission);
 
     S.poiOffers.erase(S.poiOffers.begin() + S.offerSel);
+    S.gen.offers++;
     if (S.offerSel >= (int)S.poiOffers.size()) S.offerSel = std::max(0, (int)S.poiOffers.size()-1);
 }
 
 static void declineSelectedOffer(GameState& S) {
+    ALLOC_SCOPE(Missions);
     if (S.poiOffers.empty()) return;
     S.offerSel = termui::clampi(S.offerSel, 0, (int)S.poiOffers.size()-1);
 
@@ -499,76 +2793,317 @@ static void declineSelectedOffer(GameState& S) {
 	std::wstringstream oss;
 	oss << L"Declined mission: deliver " << m.amount << L" " << goodNameW(m.good)
 		<< L" to " << dst.name << L" / " << dst.pois[m.toPoi].name << L".";
-	S.pushLog(oss.str());
+	S.pushLog(oss.str(), journal::Kind::Mission);
 
 
     S.poiOffers.erase(S.poiOffers.begin() + S.offerSel);
+    S.gen.offers++;
     if (S.offerSel >= (int)S.poiOffers.size()) S.offerSel = std::max(0, (int)S.poiOffers.size()-1);
 }
 
 // ---------------- World init ----------------
-static void initGalaxy(GameState& S) {
-    S.seed = rand();
-	
-	S.galaxy = {
-		{ L"Sol",              30, 30, {} },
-		{ L"Alpha Centauri",   36, 28, {} },
-		{ L"Proxima Centauri", 37, 27, {} },
-		{ L"Barnard's Star",   26, 34, {} },
-		{ L"Wolf 359",         22, 29, {} },
-		{ L"Lalande 21185",    18, 24, {} },
-		{ L"Sirius",           42, 33, {} },
-		{ L"Luyten 726-8",     24, 20, {} },
-		{ L"Ross 154",         40, 24, {} },
-		{ L"Ross 248",         28, 18, {} },
-		{ L"Epsilon Eridani",  48, 30, {} },
-		{ L"Tau Ceti",         50, 22, {} },
-		{ L"Kapteyn's Star",   16, 36, {} },
-		{ L"Groombridge 34",   34, 40, {} },
-		{ L"61 Cygni",         38, 44, {} },
-		{ L"Struve 2398",      20, 42, {} },
-		{ L"Gliese 876",       12, 28, {} },
-		{ L"YZ Ceti",          46, 16, {} },
-		{ L"Teegarden's Star", 10, 34, {} },
-		{ L"Gliese 667",       52, 38, {} },
-		{ L"HD 85512",         44, 46, {} },
-		{ L"Gliese 581",       14, 18, {} },
-		{ L"Delta Pavonis",    54, 26, {} },
-		{ L"Altair",           32, 12, {} },
-		{ L"Fomalhaut",        58, 32, {} },
-	};
-
-
-    auto addPois = [&](StarSystem& sys, uint32_t sysSeed) {
-        sys.pois.push_back({ sys.name + L" Prime", PoiType::Planet, 10, 8,  makeMarket(sysSeed + 1, PoiType::Planet) });
-        sys.pois.push_back({ L"Highport Station",  PoiType::Station,22, 6,  makeMarket(sysSeed + 2, PoiType::Station) });
-        sys.pois.push_back({ L"Outer Belt",        PoiType::Outpost,32, 14, makeMarket(sysSeed + 3, PoiType::Outpost) });
-        if (sys.name == L"Sol")   sys.pois.push_back({ L"Luna Yard",  PoiType::Station,16, 10, makeMarket(sysSeed + 4, PoiType::Station) });
-        if (sys.name == L"Vesta") sys.pois.push_back({ L"Red Clinic", PoiType::Outpost,26, 12, makeMarket(sysSeed + 5, PoiType::Outpost) });
+struct KnownSystem { const wchar_t* name; int gx, gy; };
+static const KnownSystem KNOWN_SYSTEMS[] = {
+	{ L"Sol",              30, 30 },
+	{ L"Alpha Centauri",   36, 28 },
+	{ L"Proxima Centauri", 37, 27 },
+	{ L"Barnard's Star",   26, 34 },
+	{ L"Wolf 359",         22, 29 },
+	{ L"Lalande 21185",    18, 24 },
+	{ L"Sirius",           42, 33 },
+	{ L"Luyten 726-8",     24, 20 },
+	{ L"Ross 154",         40, 24 },
+	{ L"Ross 248",         28, 18 },
+	{ L"Epsilon Eridani",  48, 30 },
+	{ L"Tau Ceti",         50, 22 },
+	{ L"Kapteyn's Star",   16, 36 },
+	{ L"Groombridge 34",   34, 40 },
+	{ L"61 Cygni",         38, 44 },
+	{ L"Struve 2398",      20, 42 },
+	{ L"Gliese 876",       12, 28 },
+	{ L"YZ Ceti",          46, 16 },
+	{ L"Teegarden's Star", 10, 34 },
+	{ L"Gliese 667",       52, 38 },
+	{ L"HD 85512",         44, 46 },
+	{ L"Gliese 581",       14, 18 },
+	{ L"Delta Pavonis",    54, 26 },
+	{ L"Altair",           32, 12 },
+	{ L"Fomalhaut",        58, 32 },
+};
+static constexpr int KNOWN_SYSTEM_COUNT = (int)(sizeof(KNOWN_SYSTEMS) / sizeof(KNOWN_SYSTEMS[0]));
+
+// Galaxy::Generator for the standard universe. Systems past the known table
+// (large generated universes) get catalogue names. Pure, so the sector
+// prefetch thread can call it.
+static void generateSystems(const uint32_t* ids, size_t n, StarSystem* out) {
+    // Markets are generated in one batch once every POI exists.
+    std::vector<uint32_t> marketSeeds;
+    std::vector<PoiType> marketTypes;
+    auto addPoi = [&](StarSystem& sys, const std::wstring& name, PoiType t, uint32_t seed) {
+        sys.pois.push_back({ name, t, 0, 0, Market{} });
+        marketSeeds.push_back(seed);
+        marketTypes.push_back(t);
+    };
+    // Generated systems past the core three get a few more POIs; about one
+    // in POI_HUB_ODDS is a busy hub with up to MAX_POIS.
+    auto addPois = [&](StarSystem& sys, uint32_t id, uint32_t sysSeed) {
+        addPoi(sys, sys.name + L" Prime", PoiType::Planet, sysSeed + 1);
+        addPoi(sys, L"Highport Station",  PoiType::Station, sysSeed + 2);
+        addPoi(sys, L"Outer Belt",        PoiType::Outpost, sysSeed + 3);
+        if (sys.name == L"Sol")   addPoi(sys, L"Luna Yard",  PoiType::Station, sysSeed + 4);
+        if (sys.name == L"Vesta") addPoi(sys, L"Red Clinic", PoiType::Outpost, sysSeed + 5);
+        if (id < (uint32_t)KNOWN_SYSTEM_COUNT) return;
+
+        uint32_t h = rng::hash32(sysSeed);
+        int extra = (h % POI_HUB_ODDS == 0) ? 13 + (int)((h >> 8) % (uint32_t)(MAX_POIS - 15)) : (int)((h >> 8) % 4u);
+        for (int i = 0; i < extra; i++) {
+            PoiType t = (PoiType)(((h >> 16) + (uint32_t)i) % 3u);
+            addPoi(sys, poiTypeNameW(t) + L" " + std::to_wstring(i + 1), t, sysSeed + 4 + (uint32_t)i);
+        }
+    };
+
+    for (size_t k=0;k<n;k++) {
+        uint32_t id = ids[k];
+        uint32_t sysSeed = catalog::defaultSystemSeed(id);
+        out[k].name = (id < (uint32_t)KNOWN_SYSTEM_COUNT) ? std::wstring(KNOWN_SYSTEMS[id].name)
+                                                          : L"GX-" + std::to_wstring(id);
+        out[k].pois.clear();
+        addPois(out[k], id, sysSeed);
+        layoutOrbits(out[k], sysSeed);
+    }
+
+    std::vector<Market> markets(marketSeeds.size());
+    makeMarkets(marketSeeds.data(), marketTypes.data(), markets.data(), markets.size());
+    size_t mi = 0;
+    for (size_t k=0;k<n;k++)
+        for (auto& poi : out[k].pois) poi.market = markets[mi++];
+}
+
+// Galaxy::Generator for a catalog file: names, POIs, seeds and price
+// modifiers come from the mapped records. Markets are generated as for the
+// built-in universe and then scaled by the POI's modifiers.
+static Galaxy::Generator catalogGenerator(std::shared_ptr<const catalog::Catalog> cat) {
+    return [cat](const uint32_t* ids, size_t n, StarSystem* out) {
+        const catalog::SystemRec* systems = cat->systems();
+        const catalog::PoiRec* pois = cat->pois();
+        std::vector<uint32_t> marketSeeds;
+        std::vector<PoiType> marketTypes;
+        for (size_t k = 0; k < n; k++) {
+            const catalog::SystemRec& r = systems[ids[k]];
+            out[k].name = cat->name(r.name, r.nameLen);
+            out[k].pois.clear();
+            for (uint32_t i = 0; i < r.poiCount; i++) {   // at most MAX_POIS, see Catalog::validate
+                const catalog::PoiRec& p = pois[r.firstPoi + i];
+                out[k].pois.push_back({ cat->name(p.name, p.nameLen), (PoiType)p.type, 0, 0, Market{} });
+                marketSeeds.push_back(p.seed);
+                marketTypes.push_back((PoiType)p.type);
+            }
+            layoutOrbits(out[k], r.seed);
+        }
+
+        std::vector<Market> markets(marketSeeds.size());
+        makeMarkets(marketSeeds.data(), marketTypes.data(), markets.data(), markets.size());
+        size_t mi = 0;
+        for (size_t k = 0; k < n; k++) {
+            const catalog::SystemRec& r = systems[ids[k]];
+            for (size_t i = 0; i < out[k].pois.size(); i++, mi++) {
+                const int8_t* mod = pois[r.firstPoi + i].priceMod;
+                for (int g = 0; g < (int)Good::COUNT; g++)
+                    markets[mi].price[g] = std::max(1, markets[mi].price[g] * (100 + mod[g]) / 100);
+                out[k].pois[i].market = markets[mi];
+            }
+        }
     };
+}
+
+// The catalog's position and sector arrays, for Galaxy to use in place.
+static Galaxy::Index catalogIndex(const catalog::Catalog& cat) {
+    const catalog::Header& h = cat.header();
+    Galaxy::Index index;
+    index.pos = reinterpret_cast<const SystemPos*>(cat.positions());
+    index.count = h.systems;
+    index.sectorStart = cat.sectorStart();
+    index.sectorIds = cat.sectorIds();
+    index.localIndex = cat.localIndex();
+    index.sectorsX = (int)h.sectorsX;
+    index.sectorsY = (int)h.sectorsY;
+    return index;
+}
 
-    for (size_t i=0;i<S.galaxy.size();i++) addPois(S.galaxy[i], (uint32_t)(0xC0FFEEu + i*1337u));
+// `cat` replaces the built-in universe when given; it is used in place.
+static void initGalaxy(GameState& S, uint32_t seed, std::shared_ptr<const catalog::Catalog> cat = nullptr) {
+    TRACE_SCOPE("initGalaxy");
+    ALLOC_SCOPE(Init);
+    S.seed = (int)seed;
+
+    if (cat) {
+        const catalog::Header& h = cat->header();
+        S.galaxy.reset(catalogIndex(*cat), cat, catalogGenerator(cat));
+        S.galaxyW = (int)h.width;
+        S.galaxyH = (int)h.height;
+    } else {
+        std::vector<SystemPos> catalog;
+        for (const KnownSystem& k : KNOWN_SYSTEMS) catalog.push_back({ k.gx, k.gy });
+        S.galaxy.reset(std::move(catalog), generateSystems);
+        S.galaxyW = GALAXY_W;
+        S.galaxyH = GALAXY_H;
+    }
+    S.gen.world++;
 
     S.currentSystem = 0;
-    S.gCurX = S.galaxy[0].gx; S.gCurY = S.galaxy[0].gy;
+    S.gCurX = S.galaxy.pos(0).gx; S.gCurY = S.galaxy.pos(0).gy;
 
     // Start in orbit of the starting system (galaxy-space position)
-    S.shipGX = S.galaxy[0].gx;
-    S.shipGY = S.galaxy[0].gy;
+    S.fleet.clear();
+    S.pilot = S.fleet.add(S.galaxy.pos(0).gx, S.galaxy.pos(0).gy);
+    S.fleet.order[S.pilot] = (uint8_t)ShipOrder::Manned;
+    S.events.clear();
+    S.prices.clear();
+    S.priceIndex.clear();
+    S.arbitrage.clear();
+    S.orbits.clear();
+
+    S.galaxyMip.build(S.galaxy.catalog(), S.galaxyW, S.galaxyH);
+    S.galaxyMip.setShip(S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
+    S.reach.setSystems(S.galaxy.catalog(), S.galaxyW, S.galaxyH);
 
     // Start docked at first POI
-    S.sCurX = S.galaxy[0].pois[0].x;
-    S.sCurY = S.galaxy[0].pois[0].y;
+    S.sCurX = poiPos(S, 0, 0).x;
+    S.sCurY = poiPos(S, 0, 0).y;
 
     S.clearLog();
     S.pushLog(L"Welcome to Space Trader.");
     S.pushLog(L"TAB: Galaxy/System (Market TAB toggles Buy/Sell).");
-    S.pushLog(L"E: Sidebar page (Status/Cargo/Missions).");
+    S.pushLog(L"E: Sidebar page (Status/Cargo/Missions/Fleet/Prices/Trades).");
     S.pushLog(L"In Missions page: Up/Down select, ENTER/Y accept, N decline, Q back.");
+    if (S.journal.isOpen()) S.pushLog(L"Log: PgUp/PgDn/Home/End history, K kind filter, / search.");
 
     dockAtPoi(S, 0, /*autoOpenMissions=*/false);
 }
 
+// ---------------- Market trades ----------------
+// A trade order is validated and applied as one transaction: credits, cargo
+// or fuel, market stock and market price all change together, and a single
+// summary line goes to the log. Cost is O(1) in the number of units.
+enum class TradeQty { Units, MaxAffordable, FillHold, DumpAll };
+
+struct TradeOrder {
+    Good good = Good::Food;
+    bool buy = true;
+    TradeQty qty = TradeQty::Units;
+    int units = 1;              // only for TradeQty::Units
+};
+
+struct TradeResult {
+    bool ok = false;
+    int units = 0;
+    int total = 0;              // credits paid (buy) or received (sell)
+    std::wstring error;
+};
+
+static int freeSpaceFor(const Fleet& F, int ship, Good g) {
+    if (g == Good::Fuel) return std::max(0, F.fuelMax[ship] - F.fuel[ship]);
+    return std::max(0, F.cargoMax[ship] - F.cargoUsed(ship));
+}
+static int heldUnits(const Fleet& F, int ship, Good g) {
+    return (g == Good::Fuel) ? F.fuel[ship] : F.cargo[(int)g][ship];
+}
+
+// Largest buy the player can complete right now (credits, space and stock).
+// Cost grows monotonically with units, so a binary search over the closed-form
+// cost keeps this O(log units).
+static int marketMaxBuy(const GameState& S, const Market& m, Good g) {
+    const Player& P = S.P;
+    int hi = std::max(0, std::min(freeSpaceFor(S.fleet, S.pilot, g), m.stock[(int)g]));
+    int lo = 0;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (m.buyCost(g, mid) <= P.credits) lo = mid; else hi = mid - 1;
+    }
+    return lo;
+}
+
+static TradeResult marketTrade(GameState& S, const TradeOrder& o) {
+    TradeResult res{};
+    Market& market = writeMarket(S, S.currentSystem, S.dockPoiIndex); // dock market
+    Player& P = S.P;
+    Fleet& F = S.fleet;
+    int gi = (int)o.good;
+    int price = market.priceOf(o.good);
+    int stock = market.stock[gi];
+    bool fuel = (o.good == Good::Fuel);
+
+    int want = 0;
+    if (o.buy) {
+        switch (o.qty) {
+            case TradeQty::Units:         want = o.units; break;
+            case TradeQty::MaxAffordable: want = marketMaxBuy(S, market, o.good); break;
+            case TradeQty::FillHold:      want = freeSpaceFor(F, S.pilot, o.good); break;
+            case TradeQty::DumpAll:       want = 0; break;
+        }
+        if (want <= 0) {
+            if (freeSpaceFor(F, S.pilot, o.good) <= 0) res.error = fuel ? L"Fuel tank full." : L"Cargo full.";
+            else if (market.stock[gi] <= 0)   res.error = L"Out of stock.";
+            else if (P.credits < price)       res.error = L"Not enough credits.";
+            else                              res.error = L"Nothing to buy.";
+            return res;
+        }
+        if (want > freeSpaceFor(F, S.pilot, o.good)) { res.error = fuel ? L"Not enough tank space." : L"Not enough cargo space."; return res; }
+        if (want > market.stock[gi])        { res.error = L"Not enough stock."; return res; }
+        long long cost = market.buyCost(o.good, want);
+        if (cost > P.credits) { res.error = L"Not enough credits."; return res; }
+
+        res.total = (int)cost;
+        P.credits -= res.total;
+        if (fuel) F.fuel[S.pilot] += want; else F.cargo[gi][S.pilot] += want;
+        F.touch(S.pilot);
+        market.stock[gi] -= want;
+        market.pressure[gi] += want;
+    } else {
+        int have = heldUnits(F, S.pilot, o.good);
+        want = (o.qty == TradeQty::Units) ? o.units : have;
+        if (have <= 0) { res.error = fuel ? L"No fuel to sell." : L"You have none to sell."; return res; }
+        if (want <= 0) { res.error = L"Nothing to sell."; return res; }
+        if (want > have) { res.error = L"You don't have that many."; return res; }
+
+        res.total = (int)market.sellValue(o.good, want);
+        P.credits += res.total;
+        if (fuel) F.fuel[S.pilot] -= want; else F.cargo[gi][S.pilot] -= want;
+        F.touch(S.pilot);
+        market.stock[gi] += want;
+        market.pressure[gi] -= want;
+    }
+
+    S.prices.record(S.currentSystem, S.dockPoiIndex, o.good, S.date.weeks, price, stock,
+                    market.priceOf(o.good), market.stock[gi]);
+    marketWritten(S, S.currentSystem, S.dockPoiIndex);
+    S.priceIndex.update(S.galaxy, S.currentSystem, S.dockPoiIndex, market);
+    S.arbitrage.changed(S.galaxy, S.priceIndex, { { S.currentSystem, S.dockPoiIndex } });
+    res.ok = true;
+    res.units = want;
+    return res;
+}
+
+// Interactive wrapper: trade the selected good and write one log line.
+static void marketTradeSelected(GameState& S, TradeQty qty, int units = 1) {
+    ALLOC_SCOPE(Market);
+    TradeOrder o;
+    o.good = (Good)S.marketSel;
+    o.buy = S.marketModeBuy;
+    o.qty = qty;
+    o.units = units;
+
+    TradeResult res = marketTrade(S, o);
+    std::wstringstream oss;
+    if (!res.ok) {
+        oss << L"Market: " << res.error;
+    } else {
+        oss << (o.buy ? L"Bought " : L"Sold ") << res.units << L" " << GOOD_NAME[(int)o.good]
+            << L" for " << res.total << L" CR.";
+    }
+    S.pushLog(oss.str(), journal::Kind::Trade);
+}
+
 // ---------------- UI helpers ----------------
 static void panelPrintLine(termui::Canvas& C, const termui::Rect& r, int& y, const std::wstring& s, WORD attr=termui::FG_WHITE) {
     if (y >= r.y + r.h - 1) return;
@@ -583,28 +3118,20 @@ static void panelPrintLine(termui::Canvas& C, const termui::Rect& r, int& y, con
     y++;
 }
 
-// ---------------- System best-price helpers (word-of-mouth) ----------------
-struct BestInfo {
-    int minPrice = 0, maxPrice = 0;
-    int minPoi = -1, maxPoi = -1;
-};
-
-static BestInfo computeBestInSystem(const StarSystem& sys, Good g) {
-    BestInfo bi{};
-    bi.minPrice = 1e9; bi.maxPrice = -1e9;
-
-    for (int i=0;i<(int)sys.pois.size();i++) {
-        int p = sys.pois[i].market.priceOf(g);
-        if (p < bi.minPrice) { bi.minPrice = p; bi.minPoi = i; }
-        if (p > bi.maxPrice) { bi.maxPrice = p; bi.maxPoi = i; }
-    }
-    if (bi.minPoi < 0) bi.minPoi = 0;
-    if (bi.maxPoi < 0) bi.maxPoi = 0;
-    return bi;
+// One block character per value, scaled between the smallest and largest.
+static std::wstring sparkline(const std::vector<int>& v) {
+    static const wchar_t BARS[] = L"▁▂▃▄▅▆▇█";
+    if (v.empty()) return L"-";
+    auto mm = std::minmax_element(v.begin(), v.end());
+    int lo = *mm.first, span = *mm.second - lo;
+    std::wstring out;
+    for (int x : v) out += BARS[span ? (x - lo) * 7 / span : 0];
+    return out;
 }
 
 // ---------------- Rendering ----------------
 static void renderHUD(termui::Canvas& C, const termui::Rect& r, const GameState& S) {
+    TRACE_SCOPE("renderHUD");
     C.drawBox(r, L"HUD");
     C.clearInside(r, termui::FG_WHITE);
 
@@ -620,8 +3147,8 @@ static void renderHUD(termui::Canvas& C, const termui::Rect& r, const GameState&
     std::wstringstream left;
     left << L"CR: " << S.P.credits
          << L"  Crew: " << S.P.crew << L"/" << S.P.crewMax
-         << L"  Fuel: " << S.P.fuel << L"/" << S.P.fuelMax
-         << L"  Cargo: " << S.P.cargoUsed() << L"/" << S.P.cargoMax
+         << L"  Fuel: " << S.fleet.fuel[S.pilot] << L"/" << S.fleet.fuelMax[S.pilot]
+         << L"  Cargo: " << S.fleet.cargoUsed(S.pilot) << L"/" << S.fleet.cargoMax[S.pilot]
          << L"  CR/wk: " << S.incomeWeekly;
 
     C.writeW(ellipsize(left.str(), std::max(0, dateX - x - 2)));
@@ -630,6 +3157,40 @@ static void renderHUD(termui::Canvas& C, const termui::Rect& r, const GameState&
     C.setAttr(termui::FG_BRIGHT | termui::FG_WHITE);
     C.writeW(dateChunk);
     C.setAttr(termui::FG_WHITE);
+
+    if (!S.showPerf) return;
+
+    // Figures are for the previous frame; this one is still being drawn.
+    const perf::FrameStats& fs = S.frameStats;
+    const perf::FrameSample& last = fs.last();
+    int w = r.w - 4;
+    {
+        std::wstringstream oss;
+        oss << std::fixed << std::setprecision(2)
+            << L"Frame ms: " << last.frameMs << L" last  " << fs.avgFrameMs() << L" avg  "
+            << fs.maxFrameMs() << L" max   Input->present: " << last.latencyMs << L" ms";
+        C.writeWAt(x, y + 1, ellipsize(oss.str(), w));
+    }
+    {
+        std::wstringstream oss;
+        oss << L"Calls: goto " << last.gotoXY << L" attr " << last.setAttr
+            << L" write " << last.writeW << L" fill " << last.fill << L" scroll " << last.scroll
+            << L"  Chars: " << last.chars
+            << L"  Allocs: " << last.allocs << L"  Frames: " << fs.frames();
+        C.writeWAt(x, y + 2, ellipsize(oss.str(), w));
+    }
+    {
+        // tag allocs/KB this frame, peak live KB this session
+        std::wstringstream oss;
+        oss << L"By tag:";
+        for (int t = 0; t < perf::ALLOC_TAGS; t++) {
+            const perf::AllocCounters& a = last.alloc[t];
+            perf::AllocCounters total = perf::allocCounters((perf::AllocTag)t);
+            oss << L"  " << perf::allocTagName((perf::AllocTag)t) << L" " << a.allocs << L"/" << (a.bytes + 1023) / 1024
+                << L"K (" << (total.peak + 1023) / 1024 << L"K)";
+        }
+        C.writeWAt(x, y + 3, ellipsize(oss.str(), w));
+    }
 }
 
 static void galaxyEnsureCursorVisible(GameState& S, int viewCols, int viewRows, int worldW, int worldH) {
@@ -649,72 +3210,192 @@ static void systemEnsureCursorVisible(GameState& S, int viewCols, int viewRows,
     S.sCamY = termui::clampi(S.sCamY, 0, std::max(0, worldH - viewRows));
 }
 
+// ---- In-place map pans ----
+// A camera pan shifts what is already on screen: the map panel is scrolled
+// in place and only the strip it exposes is drawn, plus the old and new
+// cursor cells. That holds while nothing else a cell shows has changed,
+// which mapContentKey summarizes; anything else redraws the whole panel.
+
+// Everything besides camera and cursor that decides what a map cell shows.
+static uint64_t mapContentKey(const GameState& S) {
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&](long long v) {
+        for (int i = 0; i < 8; i++) { h ^= (uint64_t)((v >> (8 * i)) & 0xFF); h *= 1099511628211ull; }
+    };
+    const Fleet& F = S.fleet;
+    mix((int)S.screen); mix(S.gZoom); mix(S.currentSystem); mix(S.date.weeks);
+    mix(F.gx[S.pilot]); mix(F.gy[S.pilot]); mix(F.sx[S.pilot]); mix(F.sy[S.pilot]);
+    mix(F.fuel[S.pilot]); mix(F.fuelMax[S.pilot]);
+    for (const RouteLayer* route : { &S.routeGalaxy, &S.routeSystem }) {
+        mix((long long)route->hops().size()); mix(route->reached());
+        mix(route->from().first); mix(route->from().second); mix(route->to().first); mix(route->to().second);
+    }
+    mix(S.showRouteGalaxy); mix(S.showRouteSystem);
+    mix(S.gen.world); mix(S.gen.missions);
+    return h;
+}
+
+// True if the panel still shows the frame `last` describes and the camera
+// moved less than a view since.
+static bool mapFrameKeeps(const termui::Canvas& C, const MapFrame& last, const termui::Rect& view, int cellW,
+                          uint64_t content, int camX, int camY) {
+    return last.valid && last.clears == C.clearCount() && last.content == content
+        && last.view.x == view.x && last.view.y == view.y && last.view.w == view.w && last.view.h == view.h
+        && std::abs(camX - last.camX) * cellW < view.w && std::abs(camY - last.camY) < view.h;
+}
+
+// Draws a map view of `view.w / cellW` x `view.h` cells. drawSpan(row, c0, c1)
+// draws cells [c0, c1) of one view row, including the cursor positioning.
+// With `keep`, shifts the previous frame and draws only what changed.
+template <class DrawSpan>
+static void drawMapView(termui::Canvas& C, MapFrame& last, bool keep, const termui::Rect& view, int cellW,
+                        uint64_t content, int camX, int camY, int curX, int curY, DrawSpan drawSpan) {
+    int cols = view.w / cellW, rows = view.h;
+    if (!keep) {
+        for (int row = 0; row < rows; row++) drawSpan(row, 0, cols);
+    } else {
+        int dx = camX - last.camX, dy = camY - last.camY;
+        C.scroll(view, -dx * cellW, -dy);
+        int r0 = dy > 0 ? rows - dy : 0, r1 = dy > 0 ? rows : -dy;   // exposed rows
+        int c0 = dx > 0 ? cols - dx : 0, c1 = dx > 0 ? cols : -dx;   // exposed columns
+        for (int row = 0; row < rows; row++) {
+            if (row >= r0 && row < r1) drawSpan(row, 0, cols);
+            else if (c0 < c1) drawSpan(row, c0, c1);
+        }
+        auto cell = [&](int x, int y) {
+            int col = x - camX, row = y - camY;
+            if (col >= 0 && col < cols && row >= 0 && row < rows) drawSpan(row, col, col + 1);
+        };
+        cell(last.curX, last.curY);
+        cell(curX, curY);
+    }
+    last.valid = true;
+    last.clears = C.clearCount();
+    last.view = view;
+    last.content = content;
+    last.camX = camX; last.camY = camY; last.curX = curX; last.curY = curY;
+}
+
 // Galaxy QoL markers: Cursor=■, Cursor-on-system=□, Ship=▲, overlap=▣
+// Route cells: hollow once travelled, filled while still ahead.
+static wchar_t routeGlyph(RouteLayer::Mark m, bool onStop) {
+    if (m == RouteLayer::Travelled) return onStop ? L'○' : L'∙';
+    return onStop ? L'●' : L'•';
+}
+
 static void renderGalaxyMap(termui::Canvas& C, const termui::Rect& r, GameState& S) {
-    C.drawBox(r, L"GALAXY MAP  (ENTER=FTL  TAB=System)");
-    C.clearInside(r, termui::FG_WHITE);
+    TRACE_SCOPE("renderGalaxyMap");
+    const GalaxyMip& mip = S.galaxyMip;
+    int z = termui::clampi(S.gZoom, 0, std::max(0, mip.levelCount() - 1));
+    S.gZoom = z;
 
-    const int GW=120, GH=80;
+    const int GW=S.galaxyW, GH=S.galaxyH;
     S.gCurX = termui::clampi(S.gCurX, 0, GW-1);
     S.gCurY = termui::clampi(S.gCurY, 0, GH-1);
+    if (mip.levels.empty()) {
+        C.drawBox(r, L"GALAXY MAP");
+        C.clearInside(r, termui::FG_WHITE);
+        S.lastMap.valid = false;
+        return;
+    }
 
     int ix = r.x + 1, iy = r.y + 1, iw = r.w - 2, ih = r.h - 2;
     int cellW = 2;
     int cols = std::max(1, iw / cellW);
     int rows = std::max(1, ih);
 
-    galaxyEnsureCursorVisible(S, cols, rows, GW, GH);
-
-    auto sysAt = [&](int x,int y)->int{
-        for(int i=0;i<(int)S.galaxy.size();i++)
-            if (S.galaxy[i].gx==x && S.galaxy[i].gy==y) return i;
-        return -1;
-    };
-
-    int shipGX = S.shipGX;
-    int shipGY = S.shipGY;
+    S.gViewCols = cols; S.gViewRows = rows;
+    S.reach.update(S.fleet.gx[S.pilot], S.fleet.gy[S.pilot], S.fleet.fuel[S.pilot], S.fleet.fuelMax[S.pilot]);
 
-    for(int row=0; row<rows; row++){
-        int gy = S.gCamY + row;
-        C.gotoXY((SHORT)ix, (SHORT)(iy+row));
-        std::wstring line; line.reserve((size_t)cols * (size_t)cellW);
+    // Everything below is in tiles of 2^z x 2^z coordinates.
+    const GalaxyMip::Level& lv = mip.levels[z];
+    int curTX = S.gCurX >> z, curTY = S.gCurY >> z;
+    {
+        // galaxyEnsureCursorVisible works on gCur*; feed it tile coordinates.
+        int cx = S.gCurX, cy = S.gCurY;
+        S.gCurX = curTX; S.gCurY = curTY;
+        galaxyEnsureCursorVisible(S, cols, rows, lv.w, lv.h);
+        S.gCurX = cx; S.gCurY = cy;
+    }
 
-        for(int col=0; col<cols; col++){
-            int gx = S.gCamX + col;
+    termui::Rect view{ ix, iy, cols * cellW, rows };
+    uint64_t content = mapContentKey(S);
+    bool keep = mapFrameKeeps(C, S.lastMap, view, cellW, content, S.gCamX, S.gCamY);
+    if (!keep) {
+        std::wstringstream title;
+        title << L"GALAXY MAP";
+        if (z > 0) title << L" x" << (1 << z);
+        title << L"  (ENTER=FTL  R=Route  TAB=System  +/-=Zoom  green=in fuel range)";
+        C.drawBox(r, title.str());
+        C.clearInside(r, termui::FG_WHITE);
+    }
 
-            int si = sysAt(gx, gy);
-            bool isSystem = (si >= 0);
+    // Fuel overlay: green = reachable on the fuel aboard, white = reachable
+    // by refuelling on the way, grey = out of reach. Written in runs per colour.
+    const WORD REACH_ATTR[] = { termui::FG_GREEN, termui::FG_WHITE, FOREGROUND_INTENSITY };
+    drawMapView(C, S.lastMap, keep, view, cellW, content, S.gCamX, S.gCamY, curTX, curTY, [&](int row, int c0, int c1) {
+        int ty = S.gCamY + row;
+        C.gotoXY((SHORT)(ix + c0 * cellW), (SHORT)(iy+row));
+        std::wstring line; line.reserve((size_t)(c1 - c0) * (size_t)cellW);
+        int room = iw - c0 * cellW;   // columns left before the panel edge
+        int runAttr = 0;
+        auto writeRun = [&]() {
+            if ((int)line.size() > room) line.resize(std::max(0, room));
+            room -= (int)line.size();
+            C.setAttr(REACH_ATTR[runAttr]);
+            C.writeW(line);
+        };
+        auto flushRun = [&](int attr) {
+            if (attr == runAttr || line.empty()) { runAttr = attr; return; }
+            writeRun();
+            line.clear();
+            runAttr = attr;
+        };
+
+        for(int col=c0; col<c1; col++){
+            int tx = S.gCamX + col;
+            if (tx >= lv.w || ty >= lv.h) { line.push_back(L' '); line.push_back(L' '); continue; }
+
+            int x0 = tx << z, y0 = ty << z, x1 = x0 + (1 << z) - 1, y1 = y0 + (1 << z) - 1;
+            flushRun(S.reach.now(x0, y0, x1, y1) ? 0 : S.reach.refuel(x0, y0, x1, y1) ? 1 : 2);
+
+            int cell = lv.at(tx, ty);
+            uint32_t systems = lv.systems[cell];
+            bool isSystem = systems > 0;
 
-            wchar_t base = isSystem ? L'◇' : L'·';
+            wchar_t base = L'·';
+            if (systems >= 10)     base = L'█';
+            else if (systems >= 4) base = L'▓';
+            else if (systems >= 2) base = L'◆';
+            else if (systems == 1) base = L'◇';
 
-            bool isShip = (gx == shipGX && gy == shipGY);
-            bool isCur  = (gx == S.gCurX && gy == S.gCurY);
-			bool hasMission = hasMissionAtSystem(S, si);
+            bool isShip = (lv.flags[cell] & GalaxyMip::SHIP) != 0;
+            bool isCur  = (tx == curTX && ty == curTY);
+			bool hasMission = lv.missions[cell] > 0;
+            RouteLayer::Mark route = S.showRouteGalaxy ? S.routeGalaxy.at(tx, ty, z) : RouteLayer::Off;
 
             wchar_t g = base;
             if (isShip && isCur) g = L'▣';
             else if (isShip)     g = L'▲';
             else if (isCur)      g = isSystem ? L'□' : L'■';
 			else if (hasMission) g = L'◈';
+            else if (route != RouteLayer::Off) g = routeGlyph(route, isSystem);
 
             line.push_back(g);
             line.push_back(L' ');
         }
 
-        if ((int)line.size() > iw) line.resize(iw);
-        C.writeW(line);
-    }
+        writeRun();
+    });
+    C.setAttr(termui::FG_WHITE);
 }
 
 static void renderSystemMap(termui::Canvas& C, const termui::Rect& r, GameState& S) {
+    TRACE_SCOPE("renderSystemMap");
     const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
-    std::wstring title =
-        L"SYSTEM: " + sys.name + L"  (ENTER=STL  SPACE=Market  TAB=Galaxy)";
-    C.drawBox(r, title);
-    C.clearInside(r, termui::FG_WHITE);
-
-    const int SW=40, SH=20;
+    int shipSystem = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
+    const OrbitCache::Layout& orbits = systemLayout(S, S.currentSystem);
+    const int SW=sys.size, SH=sys.size, star=sys.size/2;
     S.sCurX = termui::clampi(S.sCurX, 0, SW-1);
     S.sCurY = termui::clampi(S.sCurY, 0, SH-1);
 
@@ -725,51 +3406,69 @@ static void renderSystemMap(termui::Canvas& C, const termui::Rect& r, GameState&
 
     systemEnsureCursorVisible(S, cols, rows, SW, SH);
 
-    for(int row=0; row<rows; row++){
+    termui::Rect view{ ix, iy, cols * cellW, rows };
+    uint64_t content = mapContentKey(S);
+    bool keep = mapFrameKeeps(C, S.lastMap, view, cellW, content, S.sCamX, S.sCamY);
+    if (!keep) {
+        std::wstring title =
+            L"SYSTEM: " + sys.name + L"  (ENTER=STL  R=Route  SPACE=Market  TAB=Galaxy)";
+        C.drawBox(r, title);
+        C.clearInside(r, termui::FG_WHITE);
+    }
+
+    const std::vector<int>& missionAt = missionTargets(S).firstAtPoi;
+    C.setAttr(termui::FG_WHITE);
+    drawMapView(C, S.lastMap, keep, view, cellW, content, S.sCamX, S.sCamY, S.sCurX, S.sCurY, [&](int row, int c0, int c1) {
         int sy = S.sCamY + row;
-        C.gotoXY((SHORT)ix, (SHORT)(iy+row));
-        std::wstring line; line.reserve((size_t)cols * (size_t)cellW);
+        C.gotoXY((SHORT)(ix + c0 * cellW), (SHORT)(iy+row));
+        std::wstring line; line.reserve((size_t)(c1 - c0) * (size_t)cellW);
 
-        for(int col=0; col<cols; col++){
+        for(int col=c0; col<c1; col++){
             int sx = S.sCamX + col;
 
             wchar_t base = L'·';
-            int pi = poiIndexAt(sys, sx, sy);
+            if (sx >= SW || sy >= SH) base = L' ';
+            else if (sx == star && sy == star) base = L'☼';
+            int pi = orbits.poiAt(sx, sy);
             if (pi >= 0) {
                 if (sys.pois[pi].type == PoiType::Planet) base = L'◉';
                 else if (sys.pois[pi].type == PoiType::Station) base = L'⛯';
                 else base = L'◎';
             }
 
-            bool isShip = (sx == S.shipX && sy == S.shipY);
+            bool isShip = (sx == S.fleet.sx[S.pilot] && sy == S.fleet.sy[S.pilot]);
             bool isCur  = (sx == S.sCurX  && sy == S.sCurY);
-			bool hasMission = hasMissionAtSystem(S, pi);
+			bool hasMission = pi >= 0 && missionAt[pi] >= 0;
+            RouteLayer::Mark route = S.showRouteSystem ? S.routeSystem.at(sx, sy) : RouteLayer::Off;
 
             wchar_t g = base;
             if (isShip && isCur) g = L'▣';
             else if (isShip)     g = L'▲';
             else if (isCur)      g = L'■';
 			else if (hasMission) g = L'◈';
+            else if (route != RouteLayer::Off) g = routeGlyph(route, pi >= 0);
 
             line.push_back(g);
             line.push_back(L' ');
         }
-        if ((int)line.size() > iw) line.resize(iw);
+        int room = iw - c0 * cellW;
+        if ((int)line.size() > room) line.resize(std::max(0, room));
         C.writeW(line);
-    }
+    });
 }
 
 static void renderMarket(termui::Canvas& C, const termui::Rect& r, GameState& S) {
+    TRACE_SCOPE("renderMarket");
     const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
+    int shipSystem = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
 
-    int shipPoi = poiIndexAt(sys, S.shipX, S.shipY);
-    if (shipPoi < 0) shipPoi = nearestPoiIndex(sys, S.shipX, S.shipY);
+    int shipPoi = S.dockPoiIndex;   // the market trades go to
     const SystemPoi& poi = sys.pois[shipPoi];
 
     std::wstring title = L"MARKET: " + poi.name + L"  (TAB=Buy/Sell, ENTER=Trade, Q=Back)";
     C.drawBox(r, title);
     C.clearInside(r, termui::FG_WHITE);
+    S.lastMap.valid = false;      // drawn over the map panel
 
     int x0 = r.x + 2;
     int y0 = r.y + 1;
@@ -782,21 +3481,28 @@ static void renderMarket(termui::Canvas& C, const termui::Rect& r, GameState& S)
         std::wstringstream oss;
         oss << (S.marketModeBuy ? L"[BUY] " : L"[SELL] ")
             << L"Credits: " << S.P.credits
-            << L"  Fuel: " << S.P.fuel << L"/" << S.P.fuelMax
-            << L"  Cargo: " << S.P.cargoUsed() << L"/" << S.P.cargoMax;
+            << L"  Fuel: " << S.fleet.fuel[S.pilot] << L"/" << S.fleet.fuelMax[S.pilot]
+            << L"  Cargo: " << S.fleet.cargoUsed(S.pilot) << L"/" << S.fleet.cargoMax[S.pilot];
         std::wstring line = ellipsize(oss.str(), w);
         if ((int)line.size() < w) line += std::wstring(w - line.size(), L' ');
         C.writeW(line);
     }
     C.setAttr(termui::FG_WHITE);
 
-    // Rumor lines for selected good (no prices)
+    // Rumor lines for selected good (no prices), from everything within RUMOR_JUMPS
     Good selG = (Good)S.marketSel;
-    BestInfo selBI = computeBestInSystem(sys, selG);
     {
+        int radius = RUMOR_JUMPS * GALAXY_JUMP_RANGE;
+        PriceIndex::Hit lo = S.priceIndex.cheapest(S.galaxy, selG, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot], radius);
+        PriceIndex::Hit hi = S.priceIndex.priciest(S.galaxy, selG, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot], radius);
+        auto where = [&](const PriceIndex::Hit& h) {
+            if (h.system < 0) return std::wstring(L"(nowhere known)");
+            const StarSystem& at = S.galaxy[h.system];
+            return at.pois[h.poi].name + L" (" + at.name + L")";
+        };
         std::wstringstream a, b;
-        a << L"Rumor: " << GOOD_NAME[(int)selG] << L" is cheapest at";
-        b << L"       " << sys.pois[selBI.minPoi].name << L"; priciest at " << sys.pois[selBI.maxPoi].name << L".";
+        a << L"Rumor: within " << RUMOR_JUMPS << L" jumps, " << GOOD_NAME[(int)selG] << L" is cheapest at";
+        b << L"       " << where(lo) << L"; priciest at " << where(hi) << L".";
 
         C.gotoXY((SHORT)x0, (SHORT)(y0 + 1));
         C.setAttr(termui::FG_BRIGHT | termui::FG_WHITE);
@@ -815,11 +3521,17 @@ static void renderMarket(termui::Canvas& C, const termui::Rect& r, GameState& S)
 
     int rowStart = y0 + 4;
 
+    const auto& best = S.bestInSystem.get(std::make_tuple(S.gen.world, S.currentSystem, sys.marketsVersion), [&]() {
+        std::array<BestInfo, (int)Good::COUNT> all;
+        for (int g = 0; g < (int)Good::COUNT; g++) all[g] = computeBestInSystem(sys, (Good)g);
+        return all;
+    });
+
     for(int i=0;i<(int)Good::COUNT && (rowStart+i) < (r.y+r.h-2); i++){
         Good g = (Good)i;
         int price = poi.market.priceOf(g);
 
-        BestInfo bi = computeBestInSystem(sys, g);
+        const BestInfo& bi = best[i];
         bool cheapestHere = (bi.minPoi == shipPoi);
         bool priciestHere = (bi.maxPoi == shipPoi);
 
@@ -836,23 +3548,10 @@ static void renderMarket(termui::Canvas& C, const termui::Rect& r, GameState& S)
         else if (priciestHere) oss << L"  [EXPENSIVE HERE]";
         else                   oss << L"               ";
 
-        if (g == Good::Fuel) {
-            oss << L" You: " << std::setw(3) << S.P.fuel;
-            if (S.marketModeBuy) {
-                int maxBuy = std::min(S.P.credits / std::max(1,price), S.P.fuelMax - S.P.fuel);
-                oss << L" MaxBuy: " << maxBuy;
-            } else {
-                oss << L" MaxSell: " << S.P.fuel;
-            }
-        } else {
-            oss << L" You: " << std::setw(3) << S.P.cargo[i];
-            if (S.marketModeBuy) {
-                int maxBuy = std::min(S.P.credits / std::max(1,price), S.P.cargoMax - S.P.cargoUsed());
-                oss << L" MaxBuy: " << maxBuy;
-            } else {
-                oss << L" MaxSell: " << S.P.cargo[i];
-            }
-        }
+        oss << L" Stock: " << std::setw(4) << poi.market.stock[i];
+        oss << L" You: " << std::setw(3) << heldUnits(S.fleet, S.pilot, g);
+        if (S.marketModeBuy) oss << L" MaxBuy: " << marketMaxBuy(S, poi.market, g);
+        else                 oss << L" MaxSell: " << heldUnits(S.fleet, S.pilot, g);
 
         std::wstring line = ellipsize(oss.str(), w);
         if ((int)line.size() < w) line += std::wstring(w - line.size(), L' ');
@@ -862,17 +3561,43 @@ static void renderMarket(termui::Canvas& C, const termui::Rect& r, GameState& S)
     int fy = r.y + r.h - 2;
     C.gotoXY((SHORT)x0, (SHORT)fy);
     C.setAttr(termui::FG_WHITE);
-    std::wstring help = L"Up/Down: select | ENTER: trade 1 | TAB: buy/sell | Q: back | E: sidebar | L: clear log";
+    std::wstring help = L"Up/Down: select | ENTER: trade 1 | 1-9,0: trade N | M: max/dump all | F: fill hold | TAB: buy/sell | Q: back | E: sidebar | L: clear log";
     help = ellipsize(help, w);
     if ((int)help.size() < w) help += std::wstring(w - help.size(), L' ');
     C.writeW(help);
 }
 
+// "  +412 CR  9/31w  @48 Sol Prime  FUEL" under a contract; i indexes the
+// scored list (offers or activeMissions).
+static void printContractScore(termui::Canvas& C, const termui::Rect& r, int& y, const GameState& S,
+                               const std::vector<ContractScore>& scores, int i) {
+    if (S.scorer.result().key != S.scorer.submittedKey() || i >= (int)scores.size()) {
+        panelPrintLine(C, r, y, L"    (scoring...)");
+        return;
+    }
+    const ContractScore& sc = scores[i];
+    std::wstringstream oss;
+    oss << L"    " << (sc.net >= 0 ? L"+" : L"") << sc.net << L" CR  " << sc.weeks << L"/" << sc.weeksLeft << L"w";
+    if (sc.buySystem >= 0) oss << L"  @" << sc.buyPrice << L" " << S.galaxy[sc.buySystem].pois[sc.buyPoi].name;
+    static const wchar_t* TAGS[] = { L"LATE", L"TIGHT", L"FUEL", L"RANGE", L"CARGO", L"CASH", L"NO SELLER" };
+    static_assert(std::size(TAGS) == RISK_BITS, "one tag per ContractRisk flag");
+    for (int b = 0; b < RISK_BITS; b++)
+        if (sc.risk & (1 << b)) oss << L"  " << TAGS[b];
+    WORD attr = termui::FG_GREEN;                                       // clear run
+    if (sc.risk) attr = termui::FG_RED | termui::FG_GREEN;              // doable, with a caveat
+    if ((sc.risk & (RISK_LATE | RISK_RANGE | RISK_SOURCE)) || sc.net < 0) attr = termui::FG_RED;
+    panelPrintLine(C, r, y, oss.str(), attr);
+}
+
 static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameState& S) {
+    TRACE_SCOPE("renderSidebar");
     std::wstring title;
     if (S.sidePage == SidebarPage::Status)   title = L"SIDEBAR: STATUS (E)";
     if (S.sidePage == SidebarPage::Cargo)    title = L"SIDEBAR: CARGO (E)";
     if (S.sidePage == SidebarPage::Missions) title = L"SIDEBAR: MISSIONS (E)";
+    if (S.sidePage == SidebarPage::Fleet)    title = L"SIDEBAR: FLEET (E)";
+    if (S.sidePage == SidebarPage::Prices)   title = L"SIDEBAR: PRICES (E)";
+    if (S.sidePage == SidebarPage::Trades)   title = L"SIDEBAR: TRADES (E)";
     C.drawBox(r, title);
     C.clearInside(r, termui::FG_WHITE);
 
@@ -882,13 +3607,13 @@ static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameSt
     };
 
     const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
+    int shipSystem = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
 
     if (S.sidePage == SidebarPage::Cargo) {
         section(L"Cargo Hold");
         {
             std::wstringstream oss;
-            oss << L"Used: " << S.P.cargoUsed() << L"/" << S.P.cargoMax;
+            oss << L"Used: " << S.fleet.cargoUsed(S.pilot) << L"/" << S.fleet.cargoMax[S.pilot];
             panelPrintLine(C, r, y, oss.str());
         }
         panelPrintLine(C, r, y, L"");
@@ -896,16 +3621,36 @@ static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameSt
             Good g = (Good)i;
             if (g == Good::Fuel) continue;
             std::wstringstream oss;
-            oss << std::left << std::setw(12) << GOOD_NAME[i] << L": " << S.P.cargo[i];
+            oss << std::left << std::setw(12) << GOOD_NAME[i] << L": " << S.fleet.cargo[i][S.pilot];
             panelPrintLine(C, r, y, oss.str());
         }
         panelPrintLine(C, r, y, L"");
         section(L"Fuel Tank");
         {
             std::wstringstream oss;
-            oss << L"Fuel: " << S.P.fuel << L"/" << S.P.fuelMax;
+            oss << L"Fuel: " << S.fleet.fuel[S.pilot] << L"/" << S.fleet.fuelMax[S.pilot];
             panelPrintLine(C, r, y, oss.str());
         }
+
+        // Best places to sell the whole hold without refuelling.
+        int units[(int)Good::COUNT]{};
+        bool any = false;
+        for (int g = 0; g < (int)Good::COUNT; g++)
+            if (g != (int)Good::Fuel) { units[g] = S.fleet.cargo[g][S.pilot]; any |= units[g] > 0; }
+        panelPrintLine(C, r, y, L"");
+        section(L"Sell Leads (fuel range)");
+        if (!any) {
+            panelPrintLine(C, r, y, L"(hold empty)");
+        } else {
+            int radius = S.fleet.fuel[S.pilot] / GALAXY_FUEL_PER_JUMP * GALAXY_JUMP_RANGE;
+            auto leads = S.priceIndex.bestSellPoints(S.galaxy, units, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot], radius, 5);
+            for (const auto& h : leads) {
+                const StarSystem& at = S.galaxy[h.system];
+                std::wstringstream oss;
+                oss << L"~" << h.value << L" CR  " << at.pois[h.poi].name << L" (" << at.name << L")";
+                panelPrintLine(C, r, y, oss.str());
+            }
+        }
         return;
     }
 
@@ -926,25 +3671,122 @@ static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameSt
 					<< L" to " << S.galaxy[m.toSystem].name << L" / " << S.galaxy[m.toSystem].pois[m.toPoi].name
 					<< L" (" << m.deadlineWeeks << L"w)";
                 panelPrintLine(C, r, y, oss.str(), (i==S.offerSel) ? (termui::FG_BRIGHT|termui::FG_WHITE) : termui::FG_WHITE);
+                printContractScore(C, r, y, S, S.scorer.result().offers, i);
             }
         }
 
         panelPrintLine(C, r, y, L"");
         section(L"Active Missions");
         int shown = 0;
-        for (const auto& m : S.activeMissions) {
+        for (int i = 0; i < (int)S.activeMissions.size(); i++) {
+            const auto& m = S.activeMissions[i];
             if (!m.active || m.completed) continue;
             std::wstringstream oss;
             oss << L"To " << S.galaxy[m.toSystem].name << L"/" << S.galaxy[m.toSystem].pois[m.toPoi].name
 				<< L": " << m.amount << L" " << goodNameW(m.good)
-				<< L" (" << m.deadlineWeeks << L"w)";
+				<< L" (" << weeksLeft(S, m) << L"w)";
             panelPrintLine(C, r, y, oss.str());
+            printContractScore(C, r, y, S, S.scorer.result().missions, i);
             if (++shown >= 8) break;
         }
         if (shown == 0) panelPrintLine(C, r, y, L"(none)");
         return;
     }
 
+    if (S.sidePage == SidebarPage::Fleet) {
+        const Fleet& F = S.fleet;
+        int travelling = 0;
+        for (uint8_t o : F.order) travelling += (o == (uint8_t)ShipOrder::Travel);
+
+        section(L"Fleet");
+        {
+            std::wstringstream oss;
+            oss << L"Ships: " << F.size() << L"  En route: " << travelling;
+            panelPrintLine(C, r, y, oss.str());
+        }
+        panelPrintLine(C, r, y, L"B: buy ship at a station (" + std::to_wstring(SHIP_PRICE) + L" CR)");
+        panelPrintLine(C, r, y, L"O: send idle ships to galaxy cursor");
+        panelPrintLine(C, r, y, L"");
+
+        for (int i = 0; i < F.size() && y < r.y + r.h - 1; i++) {
+            std::wstringstream oss;
+            oss << L"#" << (i + 1) << (i == S.pilot ? L"*" : L" ")
+                << L" (" << F.gx[i] << L"," << F.gy[i] << L")"
+                << L" F:" << F.fuel[i] << L" C:" << F.cargoUsed(i) << L"/" << F.cargoMax[i];
+            if (F.order[i] == (uint8_t)ShipOrder::Travel)
+                oss << L" -> (" << F.tx[i] << L"," << F.ty[i] << L")";
+            panelPrintLine(C, r, y, oss.str(), (i == S.pilot) ? (termui::FG_BRIGHT | termui::FG_WHITE) : termui::FG_WHITE);
+        }
+        return;
+    }
+
+    if (S.sidePage == SidebarPage::Prices) {
+        Good g = (Good)S.marketSel;
+        int week = S.date.weeks;
+        const SystemPoi& dock = sys.pois[S.dockPoiIndex];
+        PriceSeries h = S.prices.at(S.currentSystem, S.dockPoiIndex, g, week, dock.market);
+
+        section(L"Price History: " + goodNameW(g));
+        panelPrintLine(C, r, y, dock.name, termui::FG_BRIGHT | termui::FG_WHITE);
+        {
+            std::vector<int> w, m, yr;
+            for (int i = 0; i < h.weekCount(); i++) w.push_back(h.weekPrice(i));
+            for (int i = 0; i < h.monthCount(); i++) m.push_back(h.month(i).avgPrice);
+            for (int i = 0; i < h.yearCount(); i++) yr.push_back(h.year(i).avgPrice);
+            panelPrintLine(C, r, y, L"Weeks  " + sparkline(w) + L"  now " + std::to_wstring(h.price()));
+            panelPrintLine(C, r, y, L"Months " + sparkline(m));
+            panelPrintLine(C, r, y, L"Years  " + sparkline(yr));
+        }
+        static const struct { const wchar_t* label; int weeks; } WINDOWS[] = {
+            { L"4w ", GameDate::WEEKS_PER_MONTH }, { L"16w", 16 }, { L"1y ", GameDate::WEEKS_PER_YEAR },
+            { L"8y ", GameDate::WEEKS_PER_YEAR * 8 },
+        };
+        for (const auto& win : WINDOWS) {
+            PriceStats st = h.stats(win.weeks);
+            std::wstringstream oss;
+            oss << win.label << L" min " << st.min << L"  max " << st.max << L"  avg " << st.avg;
+            panelPrintLine(C, r, y, oss.str());
+        }
+        panelPrintLine(C, r, y, L"Market Up/Down picks the good.");
+
+        panelPrintLine(C, r, y, L"");
+        section(L"In " + sys.name + L" (16w)");
+        for (int i = 0; i < (int)sys.pois.size() && y < r.y + r.h - 1; i++) {
+            PriceSeries p = S.prices.at(S.currentSystem, i, g, week, sys.pois[i].market);
+            std::vector<int> w;
+            for (int k = 0; k < p.weekCount(); k++) w.push_back(p.weekPrice(k));
+            std::wstringstream oss;
+            oss << std::left << std::setw(12) << ellipsize(sys.pois[i].name, 12) << L" " << sparkline(w) << L" " << p.price();
+            panelPrintLine(C, r, y, oss.str(), (i == S.dockPoiIndex) ? (termui::FG_BRIGHT | termui::FG_WHITE) : termui::FG_WHITE);
+        }
+        return;
+    }
+
+    if (S.sidePage == SidebarPage::Trades) {
+        Good g = (Good)S.marketSel;
+        section(L"Best Trades: " + goodNameW(g));
+        panelPrintLine(C, r, y, L"Market Up/Down picks the good.");
+        auto list = [&](ArbitrageIndex::Kind k, const std::wstring& title) {
+            panelPrintLine(C, r, y, L"");
+            section(title);
+            const auto& top = S.arbitrage.top(g, k);
+            if (top.empty()) panelPrintLine(C, r, y, L"(nothing worth hauling)");
+            for (const auto& t : top) {
+                const StarSystem& from = S.galaxy[t.buySystem];
+                std::wstringstream buy, sell;
+                buy << L"+" << std::left << std::setw(4) << t.spread() << t.buyPrice << L" "
+                    << from.pois[t.buyPoi].name << L" (" << from.name << L")";
+                sell << L"     -> " << t.sellPrice << L" " << S.galaxy[t.sellSystem].pois[t.sellPoi].name;
+                if (k == ArbitrageIndex::Nearby) sell << L" (" << t.jumps << L"j)";
+                panelPrintLine(C, r, y, buy.str(), termui::FG_BRIGHT | termui::FG_WHITE);
+                panelPrintLine(C, r, y, sell.str());
+            }
+        };
+        list(ArbitrageIndex::InSystem, L"Within a system");
+        list(ArbitrageIndex::Nearby, L"Within " + std::to_wstring(ARBITRAGE_JUMPS) + L" jumps");
+        return;
+    }
+
     // STATUS page
 	section(L"Current Location");
 	if (shipSystem >= 0) {
@@ -953,7 +3795,7 @@ static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameSt
 		panelPrintLine(C, r, y, L"Ship @ " + dock.name + L" (" + poiTypeNameW(dock.type) + L")");
 	} else {
 		std::wstringstream loc;
-		loc << L"Deep Space (" << S.shipGX << L"," << S.shipGY << L")";
+		loc << L"Deep Space (" << S.fleet.gx[S.pilot] << L"," << S.fleet.gy[S.pilot] << L")";
 		panelPrintLine(C, r, y, loc.str(), termui::FG_BRIGHT | termui::FG_WHITE);
 		panelPrintLine(C, r, y, L"(not docked)");
 	}
@@ -966,15 +3808,13 @@ static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameSt
 		oss << L"Cursor: (" << S.gCurX << L"," << S.gCurY << L")";
 		panelPrintLine(C, r, y, oss.str());
 
-		int hovered = -1;
-		for(int i=0;i<(int)S.galaxy.size();i++){
-			if (S.galaxy[i].gx==S.gCurX && S.galaxy[i].gy==S.gCurY) { hovered=i; break; }
-		}
+		int hovered = S.galaxy.systemAt(S.gCurX, S.gCurY);
 
 		if (hovered >= 0) {
 			panelPrintLine(C, r, y, L"Target: " + S.galaxy[hovered].name, termui::FG_BRIGHT | termui::FG_WHITE);
 
-			int dist = chebyshev(S.galaxy[S.currentSystem].gx, S.galaxy[S.currentSystem].gy, S.gCurX, S.gCurY);
+			SystemPos here = S.galaxy.pos(S.currentSystem);
+			int dist = chebyshev(here.gx, here.gy, S.gCurX, S.gCurY);
 			int jumps = jumpsRequired(dist, GALAXY_JUMP_RANGE);
 			std::wstringstream t;
 			t << L"Dist: " << dist
@@ -1000,12 +3840,13 @@ static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameSt
 		oss << L"Cursor: (" << S.sCurX << L"," << S.sCurY << L")";
 		panelPrintLine(C, r, y, oss.str());
 
-		int piExact = poiIndexAt(sys, S.sCurX, S.sCurY);
+		int piExact = poiIndexAt(S, S.currentSystem, S.sCurX, S.sCurY);
 		if (piExact >= 0) {
 			const SystemPoi& p = sys.pois[piExact];
 			panelPrintLine(C, r, y, L"POI: " + p.name + L" (" + poiTypeNameW(p.type) + L")", termui::FG_BRIGHT | termui::FG_WHITE);
 
-			int dist = chebyshev(S.shipX, S.shipY, p.x, p.y);
+			PoiPos at = poiPos(S, S.currentSystem, piExact);
+			int dist = chebyshev(S.fleet.sx[S.pilot], S.fleet.sy[S.pilot], at.x, at.y);
 			int jumps = jumpsRequired(dist, SYSTEM_JUMP_RANGE);
 			std::wstringstream t;
 			t << L"Dist: " << dist
@@ -1026,11 +3867,12 @@ static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameSt
 
 			panelPrintLine(C, r, y, L"(ENTER to travel, SPACE market)");
 		} else {
-			int pi = nearestPoiIndex(sys, S.sCurX, S.sCurY);
+			int pi = nearestPoiIndex(S, S.currentSystem, S.sCurX, S.sCurY);
 			const SystemPoi& p = sys.pois[pi];
 			panelPrintLine(C, r, y, L"Nearest: " + p.name + L" (" + poiTypeNameW(p.type) + L")");
 
-			int dist = chebyshev(S.shipX, S.shipY, p.x, p.y);
+			PoiPos at = poiPos(S, S.currentSystem, pi);
+			int dist = chebyshev(S.fleet.sx[S.pilot], S.fleet.sy[S.pilot], at.x, at.y);
 			int jumps = jumpsRequired(dist, SYSTEM_JUMP_RANGE);
 			std::wstringstream t;
 			t << L"Dist: " << dist
@@ -1057,23 +3899,143 @@ static void renderSidebar(termui::Canvas& C, const termui::Rect& r, const GameSt
 	panelPrintLine(C, r, y, L"");
 	section(L"Controls");
 	panelPrintLine(C, r, y, L"TAB: Galaxy/System");
-	panelPrintLine(C, r, y, L"E: Sidebar page (Status/Cargo/Missions)");
-	panelPrintLine(C, r, y, L"L: Clear log");
+	panelPrintLine(C, r, y, L"E: Sidebar page (Status/Cargo/Missions/Fleet/Prices/Trades)");
+	panelPrintLine(C, r, y, L"Z: Wait 1 week  X: Wait for next event");
+	panelPrintLine(C, r, y, L"L: Clear log  PgUp/PgDn: Log history");
+	panelPrintLine(C, r, y, L"K: Log kind  /: Search log");
+	panelPrintLine(C, r, y, L"F3: Performance overlay  F12: Trace/alloc dump");
 	panelPrintLine(C, r, y, L"ESC: Quit");
 }
 
-static void renderLog(termui::Canvas& C, const termui::Rect& r, const GameState& S) {
-    C.drawBox(r, L"LOG  (L: clear)");
+static const wchar_t* journalKindName(int k) {
+    static const wchar_t* N[(int)journal::Kind::COUNT] = { L"Info", L"Trade", L"Travel", L"Mission", L"Fleet" };
+    return (k >= 0 && k < (int)journal::Kind::COUNT) ? N[k] : L"All";
+}
+
+static journal::Filter logFilter(const LogView& V) {
+    journal::Filter f;
+    if (V.kind >= 0) f.kinds = 1u << V.kind;
+    f.text = V.text;
+    return f;
+}
+
+// Picks up journal entries written since the last frame. A scrolled view
+// keeps showing the same rows as new matches arrive above it.
+static void syncLogView(GameState& S) {
+    ALLOC_SCOPE(Log);
+    LogView& V = S.logView;
+    uint64_t added = V.search.sync(S.journal);
+    if (!V.live) V.top += added;
+}
+
+// Re-runs the search from the newest entry after a filter change.
+static void applyLogFilter(GameState& S) {
+    LogView& V = S.logView;
+    V.search.reset(logFilter(V));
+    V.search.sync(S.journal);
+    V.top = 0;
+    V.live = true;
+}
+
+// dy: -1 older / +1 newer page; dx: -1 oldest / +1 newest. One row of the
+// previous page stays in view.
+static void scrollLog(GameState& S, int dx, int dy) {
+    LogView& V = S.logView;
+    const journal::Journal& J = S.journal;
+    uint64_t page = (uint64_t)std::max(1, V.rows - 1);
+    uint64_t idx;
+    if (dx > 0) {
+        V.top = 0;
+        V.live = true;
+    } else if (dx < 0) {
+        uint64_t first = J.findForward(0, V.search.filter());
+        if (first == journal::Journal::NONE) return;
+        uint64_t last = V.search.rankBefore(J, first + 1);
+        V.top = last > page ? last - page : 0;
+        V.live = false;
+    } else if (dy < 0) {
+        uint64_t next = V.live ? std::min<uint64_t>((uint64_t)V.shown, page) : V.top + page;
+        if (!V.search.at(J, next, idx)) return;   // already at the oldest
+        V.top = next;
+        V.live = false;
+    } else if (dy > 0) {
+        if (V.top <= page) { V.top = 0; V.live = true; }
+        else V.top -= page;
+    }
+}
+
+// "@N" on the search prompt: the newest entry from N weeks ago or earlier.
+static void seekLogWeeksAgo(GameState& S, int weeksAgo) {
+    LogView& V = S.logView;
+    int week = std::max(0, S.date.weeks - weeksAgo);
+    uint64_t rank = V.search.rankBefore(S.journal, S.journal.firstAtWeek((uint32_t)week + 1));
+    uint64_t idx;
+    if (!V.search.at(S.journal, rank, idx)) return;
+    V.top = rank;
+    V.live = false;
+}
+
+static void editLogSearch(GameState& S, int ch) {
+    LogView& V = S.logView;
+    if (ch == 27) {
+        V.editing = false;
+    } else if (ch == '\r') {
+        V.editing = false;
+        auto digit = [](wchar_t c) { return c >= L'0' && c <= L'9'; };
+        if (V.draft.size() > 1 && V.draft[0] == L'@' && std::all_of(V.draft.begin() + 1, V.draft.end(), digit)) {
+            int weeks = 0;
+            for (size_t i = 1; i < V.draft.size(); i++) weeks = std::min(weeks * 10 + (V.draft[i] - L'0'), 1000000);
+            seekLogWeeksAgo(S, weeks);
+        } else {
+            V.text = V.draft;
+            applyLogFilter(S);
+        }
+    } else if (ch == '\b') {
+        if (!V.draft.empty()) V.draft.pop_back();
+    } else if (ch >= 32 && ch < 127 && V.draft.size() < 40) {
+        V.draft.push_back((wchar_t)ch);
+    }
+}
+
+// Without a journal (replays, server seats, clients) this is the in-memory
+// log; with one, a page of the filtered journal read on demand.
+static void renderLog(termui::Canvas& C, const termui::Rect& r, GameState& S) {
+    TRACE_SCOPE("renderLog");
+    LogView& V = S.logView;
+    bool history = S.journal.isOpen() && (!V.live || V.kind >= 0 || !V.text.empty());
+
+    std::wstring title = L"LOG  (L: clear)";
+    if (S.journal.isOpen()) {
+        std::wstringstream oss;
+        oss << L"LOG  [" << journalKindName(V.kind) << L"]";
+        if (!V.text.empty()) oss << L" \"" << V.text << L"\"";
+        if (!V.live) oss << L"  -" << V.top;
+        oss << L"  (L: clear  PgUp/PgDn/Home/End: scroll  K: kind  /: search)";
+        title = oss.str();
+    }
+    C.drawBox(r, title);
     C.clearInside(r, termui::FG_WHITE);
 
     int x = r.x + 2;
     int y = r.y + 1;
     int w = r.w - 4;
     int h = r.h - 2;
+    V.rows = h;
+    V.shown = 0;
 
+    journal::Entry e;
     for(int i=0;i<h;i++){
         C.gotoXY((SHORT)x, (SHORT)(y+i));
-        std::wstring line = (i < (int)S.log.size()) ? S.log[i] : L"";
+        std::wstring line;
+        uint64_t idx = 0;
+        if (!S.journal.isOpen()) {
+            if (i < (int)S.log.size()) line = S.log[i];
+        } else if (V.editing && i == h - 1) {
+            line = L"/" + V.draft + L"_  (ENTER: search  ESC: cancel  @N: N weeks ago)";
+        } else if (V.search.at(S.journal, V.top + i, idx) && !(!history && idx < V.floor) && S.journal.read(idx, e)) {
+            line = history ? GameDate{ (int)e.week }.toString() + L"  " + e.text : e.text;
+            V.shown++;
+        }
         line = ellipsize(line, w);
         if ((int)line.size() < w) line += std::wstring(w - line.size(), L' ');
         C.writeW(line);
@@ -1081,6 +4043,11 @@ static void renderLog(termui::Canvas& C, const termui::Rect& r, const GameState&
 }
 
 static void renderAll(termui::Canvas& C, const termui::Layout& L, GameState& S) {
+    TRACE_SCOPE("renderAll");
+    ALLOC_SCOPE(Render);
+    refreshContractScores(S);
+    if (S.sidePage == SidebarPage::Trades)
+        S.arbitrage.follow(S.galaxy, S.priceIndex, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
     renderHUD(C, L.hud, S);
 
     if (S.screen == Screen::Galaxy) renderGalaxyMap(C, L.map, S);
@@ -1088,266 +4055,1189 @@ static void renderAll(termui::Canvas& C, const termui::Layout& L, GameState& S)
     else renderMarket(C, L.map, S);
 
     renderSidebar(C, L.side, S);
+    syncLogView(S);
     renderLog(C, L.log, S);
 }
 
 // ---------------- Game actions ----------------
 static void doGalaxyJump(GameState& S) {
+    TRACE_SCOPE("doGalaxyJump");
     // Jump target is the cursor position (galaxy-space), even if it's empty space.
-    const int GW=45, GH=30;
+    const int GW=S.galaxyW, GH=S.galaxyH;
     int tx = termui::clampi(S.gCurX, 0, GW-1);
     int ty = termui::clampi(S.gCurY, 0, GH-1);
 
-    int dist = chebyshev(S.shipGX, S.shipGY, tx, ty);
-    if (dist == 0) { S.pushLog(L"Jump: You are already there."); return; }
+    int dist = chebyshev(S.fleet.gx[S.pilot], S.fleet.gy[S.pilot], tx, ty);
+    if (dist == 0) { S.pushLog(L"Jump: You are already there.", journal::Kind::Travel); return; }
 
     // One jump = one week. If target is out of range, we jump toward it by the range.
-    int nx = S.shipGX;
-    int ny = S.shipGY;
+    int nx = S.fleet.gx[S.pilot];
+    int ny = S.fleet.gy[S.pilot];
     if (dist > GALAXY_JUMP_RANGE) {
         stepToward(nx, ny, tx, ty, GALAXY_JUMP_RANGE);
     } else {
         nx = tx; ny = ty;
     }
 
-    if (S.P.fuel < GALAXY_FUEL_PER_JUMP) { S.pushLog(L"Jump: Not enough fuel."); return; }
+    if (S.fleet.fuel[S.pilot] < GALAXY_FUEL_PER_JUMP) { S.pushLog(L"Jump: Not enough fuel.", journal::Kind::Travel); return; }
+
+    // Refuse a hop into deep space that leaves no system within the fuel left,
+    // unless the ship is already past saving.
+    {
+        int fuel = S.fleet.fuel[S.pilot];
+        auto range = [](int f) { return f / GALAXY_FUEL_PER_JUMP * GALAXY_JUMP_RANGE; };
+        if (!S.reach.anySystemWithin(nx, ny, range(fuel - GALAXY_FUEL_PER_JUMP))
+            && S.reach.anySystemWithin(S.fleet.gx[S.pilot], S.fleet.gy[S.pilot], range(fuel))) {
+            S.pushLog(L"Jump: That would strand you in deep space. Pick a target in range.", journal::Kind::Travel);
+            return;
+        }
+    }
 
     S.clearLog();                 // clear log on travel
-    S.P.fuel -= GALAXY_FUEL_PER_JUMP;
-    advanceWeek(S, 1);
-    tickMissionDeadlines(S, 1);
+    S.dockVisit = ++S.visitCounter;   // undock
+    S.fleet.fuel[S.pilot] -= GALAXY_FUEL_PER_JUMP;
+    advanceTime(S, 1);
 
-    S.shipGX = nx;
-    S.shipGY = ny;
+    S.fleet.gx[S.pilot] = nx;
+    S.fleet.gy[S.pilot] = ny;
+    S.galaxyMip.setShip(nx, ny);
+    S.routeGalaxy.arrive(nx, ny);
 
-    int landedSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
+    int landedSystem = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
 
     std::wstringstream oss;
     if (landedSystem >= 0) {
+        if (landedSystem != S.currentSystem) { S.routeSystem.clear(); S.showRouteSystem = false; }
         S.currentSystem = landedSystem;
 
         oss << L"FTL jump to " << S.galaxy[landedSystem].name
             << L" (1 week, -" << GALAXY_FUEL_PER_JUMP << L" fuel).";
-        S.pushLog(oss.str());
+        S.pushLog(oss.str(), journal::Kind::Travel);
 
         // On arrival, place you at POI #0 and dock (offers, potential delivery completion)
-        const auto& sys = S.galaxy[S.currentSystem];
-        S.sCurX = sys.pois[0].x;
-        S.sCurY = sys.pois[0].y;
+        S.sCurX = poiPos(S, S.currentSystem, 0).x;
+        S.sCurY = poiPos(S, S.currentSystem, 0).y;
 
         dockAtPoi(S, 0, /*autoOpenMissions=*/true);
     } else {
-        oss << L"FTL jump into deep space (" << S.shipGX << L"," << S.shipGY
+        oss << L"FTL jump into deep space (" << S.fleet.gx[S.pilot] << L"," << S.fleet.gy[S.pilot]
             << L") (1 week, -" << GALAXY_FUEL_PER_JUMP << L" fuel).";
-        S.pushLog(oss.str());
+        S.pushLog(oss.str(), journal::Kind::Travel);
         // Stay in Galaxy view; System/Market requires landing on a system.
     }
 }
 
 static void doSystemJump(GameState& S) {
+    TRACE_SCOPE("doSystemJump");
     const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
+    int shipSystem = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
 
-    // Jump target is the cursor position (clamped to system bounds)
-    const int SW=40, SH=20;
+    // Jump target is the cursor position (clamped to system bounds). A POI
+    // under the cursor is aimed at where it will be when the jump lands.
+    const int SW=sys.size, SH=sys.size;
     int tx = termui::clampi(S.sCurX, 0, SW-1);
     int ty = termui::clampi(S.sCurY, 0, SH-1);
 
-    int dist = chebyshev(S.shipX, S.shipY, tx, ty);
-    if (dist == 0) { S.pushLog(L"Jump: You are already there."); return; }
+    int dist = chebyshev(S.fleet.sx[S.pilot], S.fleet.sy[S.pilot], tx, ty);
+    if (dist == 0) { S.pushLog(L"Jump: You are already there.", journal::Kind::Travel); return; }
+
+    int target = poiIndexAt(S, S.currentSystem, tx, ty);
+    if (target >= 0) {
+        PoiPos p = orbitPos(sys, target, S.date.weeks + 1);
+        tx = p.x; ty = p.y;
+    }
 
     // We allow a jump only if within range; otherwise, we jump *toward* cursor by range
-    int nx = S.shipX;
-    int ny = S.shipY;
+    int nx = S.fleet.sx[S.pilot];
+    int ny = S.fleet.sy[S.pilot];
     stepToward(nx, ny, tx, ty, SYSTEM_JUMP_RANGE);
 
-    if (S.P.fuel < SYSTEM_FUEL_PER_JUMP) { S.pushLog(L"Jump: Not enough fuel."); return; }
+    if (S.fleet.fuel[S.pilot] < SYSTEM_FUEL_PER_JUMP) { S.pushLog(L"Jump: Not enough fuel.", journal::Kind::Travel); return; }
 
     S.clearLog();                 // clear log on travel
-    S.P.fuel -= SYSTEM_FUEL_PER_JUMP;
-    advanceWeek(S, 1);
-    tickMissionDeadlines(S, 1);
+    S.dockVisit = ++S.visitCounter;   // undock
+    S.fleet.fuel[S.pilot] -= SYSTEM_FUEL_PER_JUMP;
+    advanceTime(S, 1);
 
-    S.shipX = nx;
-    S.shipY = ny;
+    S.fleet.sx[S.pilot] = nx;
+    S.fleet.sy[S.pilot] = ny;
+    S.routeSystem.arrive(nx, ny);
 
     // If we landed on a POI, dock (mission completion + offers)
-    int pi = poiIndexAt(sys, S.shipX, S.shipY);
+    int pi = poiIndexAt(S, S.currentSystem, S.fleet.sx[S.pilot], S.fleet.sy[S.pilot]);
     if (pi >= 0) {
         std::wstringstream oss;
         oss << L"STL jump to " << sys.pois[pi].name
             << L" (1 week, -" << SYSTEM_FUEL_PER_JUMP << L" fuel).";
-        S.pushLog(oss.str());
+        S.pushLog(oss.str(), journal::Kind::Travel);
 
         dockAtPoi(S, pi, /*autoOpenMissions=*/true);
     } else {
         std::wstringstream oss;
         oss << L"STL jump (1 week, -" << SYSTEM_FUEL_PER_JUMP << L" fuel).";
-        S.pushLog(oss.str());
+        S.pushLog(oss.str(), journal::Kind::Travel);
         // not docked; keep existing dockPoiIndex unchanged
     }
 }
 
+// R on a map: plot a route from the ship to the cursor, or hide it when the
+// cursor is still on the plotted destination.
+static void plotRoute(GameState& S) {
+    TRACE_SCOPE("plotRoute");
+    bool galaxy = S.screen == Screen::Galaxy;
+    RouteLayer& layer = galaxy ? S.routeGalaxy : S.routeSystem;
+    bool& shown = galaxy ? S.showRouteGalaxy : S.showRouteSystem;
+    int w = galaxy ? S.galaxyW : S.galaxy[S.currentSystem].size, h = galaxy ? S.galaxyH : w;
+    int fx = galaxy ? S.fleet.gx[S.pilot] : S.fleet.sx[S.pilot];
+    int fy = galaxy ? S.fleet.gy[S.pilot] : S.fleet.sy[S.pilot];
+    int tx = termui::clampi(galaxy ? S.gCurX : S.sCurX, 0, w - 1);
+    int ty = termui::clampi(galaxy ? S.gCurY : S.sCurY, 0, h - 1);
+
+    if (shown && !layer.empty() && layer.to() == std::make_pair(tx, ty)) {
+        shown = false;
+        S.pushLog(L"Route: hidden.", journal::Kind::Travel);
+        return;
+    }
+    if (fx == tx && fy == ty) { S.pushLog(L"Route: You are already there.", journal::Kind::Travel); return; }
 
-static void marketTradeOne(GameState& S) {
-    const StarSystem& sys = S.galaxy[S.currentSystem];
-    int shipSystem = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
-    const SystemPoi& poi = sys.pois[S.dockPoiIndex]; // dock market
-
-    Good g = (Good)S.marketSel;
-    int price = poi.market.priceOf(g);
-
-    if (S.marketModeBuy) {
-        if (g == Good::Fuel) {
-            if (S.P.fuel >= S.P.fuelMax) { S.pushLog(L"Market: Fuel tank full."); return; }
-            if (S.P.credits < price) { S.pushLog(L"Market: Not enough credits."); return; }
-            S.P.credits -= price; S.P.fuel += 1;
-            S.pushLog(L"Bought 1 Fuel.");
-            return;
+    int range = galaxy ? GALAXY_JUMP_RANGE : SYSTEM_JUMP_RANGE;
+    layer.set(fx, fy, buildRoute(fx, fy, tx, ty, range), w, h, galaxy ? S.galaxyMip.levelCount() : 1);
+    shown = true;
+
+    int fuel = (int)layer.hops().size() * (galaxy ? GALAXY_FUEL_PER_JUMP : SYSTEM_FUEL_PER_JUMP);
+    std::wstringstream oss;
+    oss << L"Route: " << layer.hops().size() << L" jump(s), " << layer.hops().size()
+        << L" week(s), " << fuel << L" fuel.";
+    if (fuel > S.fleet.fuel[S.pilot]) oss << L" Refuel on the way.";
+    S.pushLog(oss.str(), journal::Kind::Travel);
+}
+
+
+static const char* TRACE_FILE = "spacetrader_trace.json";
+static const char* JOURNAL_FILE = "spacetrader_journal.bin";   // + ".idx"
+static const char* ALLOC_FILE = "spacetrader_allocs.csv";      // F12 and at exit
+static constexpr int RECORD_FLUSH_MS = 2000;   // recordings reach the disk this often
+
+// FNV-1a over everything that defines the simulation (not UI camera or log
+// text), used to check that a replay ends in the same state it was recorded in.
+static uint64_t stateDigest(const GameState& S) {
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&](long long v) {
+        for (int i = 0; i < 8; i++) { h ^= (uint64_t)((v >> (8 * i)) & 0xFF); h *= 1099511628211ull; }
+    };
+    mix(S.seed); mix(S.date.weeks);
+    mix(S.P.credits); mix(S.P.crew);
+    const Fleet& F = S.fleet;
+    auto mixColumn = [&](const std::vector<int>& v) { for (int x : v) mix(x); };
+    mix(F.size());
+    mixColumn(F.gx); mixColumn(F.gy); mixColumn(F.sx); mixColumn(F.sy);
+    mixColumn(F.fuel); mixColumn(F.fuelMax); mixColumn(F.cargoMax);
+    for (const auto& c : F.cargo) mixColumn(c);
+    for (uint8_t o : F.order) mix(o);
+    mixColumn(F.tx); mixColumn(F.ty);
+    mix(S.currentSystem); mix(S.dockPoiIndex); mix((int)S.screen);
+    // Untouched markets are a pure function of the seed; hash the traded ones.
+    for (const auto& kv : S.galaxy.modifiedMarkets()) {
+        mix(kv.first);
+        for (const Market& m : kv.second)
+            for (int g = 0; g < (int)Good::COUNT; g++) {
+                mix(m.price[g]); mix(m.stock[g]); mix(m.pressure[g]);
+            }
+    }
+    auto mixMissions = [&](const std::vector<Mission>& v) {
+        mix((long long)v.size());
+        for (const auto& m : v) {
+            mix(m.active); mix(m.completed); mix(m.toSystem); mix(m.toPoi);
+            mix((int)m.good); mix(m.amount); mix(m.reward); mix(m.deadlineWeeks); mix(m.dueWeek);
+        }
+    };
+    mixMissions(S.activeMissions);
+    mixMissions(S.poiOffers);
+    return h;
+}
+
+// ---------------- Action dispatch ----------------
+// Shared by the interactive loop and the replayer. Mutates game state only;
+// the caller is responsible for presenting the result.
+enum class Dispatch { Ignore, Render, Relayout, Quit };
+
+static Dispatch handleAction(GameState& S, const termui::Action& a) {
+    if (a.type == termui::ActionType::Quit) return Dispatch::Quit;
+
+    if (a.type == termui::ActionType::Resize) return Dispatch::Relayout;
+    if (a.type == termui::ActionType::PerfOverlay) { S.showPerf = !S.showPerf; return Dispatch::Relayout; }
+
+    if (a.type == termui::ActionType::ClearLog) {
+        S.clearLog();
+        S.pushLog(L"(log cleared)");
+        return Dispatch::Render;
+    }
+
+    // Log panel; only a journal has history to browse.
+    if (a.type == termui::ActionType::LogScroll || a.type == termui::ActionType::LogKind ||
+        a.type == termui::ActionType::LogSearch || a.type == termui::ActionType::Text) {
+        if (!S.journal.isOpen()) return Dispatch::Ignore;
+        LogView& V = S.logView;
+        if (a.type == termui::ActionType::LogScroll) scrollLog(S, a.dx, a.dy);
+        else if (a.type == termui::ActionType::LogKind) {
+            V.kind = V.kind + 1 < (int)journal::Kind::COUNT ? V.kind + 1 : -1;
+            applyLogFilter(S);
         }
+        else if (a.type == termui::ActionType::LogSearch) { V.editing = true; V.draft = V.text; }
+        else if (V.editing) editLogSearch(S, a.dx);
+        return Dispatch::Render;
+    }
 
-        if (S.P.cargoUsed() >= S.P.cargoMax) { S.pushLog(L"Market: Cargo full."); return; }
-        if (S.P.credits < price) { S.pushLog(L"Market: Not enough credits."); return; }
-        S.P.credits -= price;
-        S.P.cargo[(int)g] += 1;
+    if (a.type == termui::ActionType::Wait) {
+        doWait(S, a.dx);
+        return Dispatch::Render;
+    }
 
-        std::wstringstream oss; oss << L"Bought 1 " << GOOD_NAME[(int)g] << L".";
-        S.pushLog(oss.str());
-    } else {
-        if (g == Good::Fuel) {
-            if (S.P.fuel <= 0) { S.pushLog(L"Market: No fuel to sell."); return; }
-            S.P.fuel -= 1; S.P.credits += price;
-            S.pushLog(L"Sold 1 Fuel.");
-            return;
+    if (a.type == termui::ActionType::TraceDump) {
+        if (!trace::compiledIn()) S.pushLog(L"Trace: not compiled in (build with SPACETRADER_TRACE).");
+        else if (trace::exportChromeJson(TRACE_FILE)) S.pushLog(L"Trace: wrote spacetrader_trace.json.");
+        else S.pushLog(L"Trace: could not write spacetrader_trace.json.");
+        if (perf::writeAllocReport(ALLOC_FILE, S.frameStats)) S.pushLog(L"Allocs: wrote spacetrader_allocs.csv.");
+        else S.pushLog(L"Allocs: could not write spacetrader_allocs.csv.");
+        return Dispatch::Render;
+    }
+
+    if (a.type == termui::ActionType::SidebarToggle) {
+        // NEW: cycle 4 pages
+        if (S.sidePage == SidebarPage::Status) S.sidePage = SidebarPage::Cargo;
+        else if (S.sidePage == SidebarPage::Cargo) S.sidePage = SidebarPage::Missions;
+        else if (S.sidePage == SidebarPage::Missions) S.sidePage = SidebarPage::Fleet;
+        else if (S.sidePage == SidebarPage::Fleet) S.sidePage = SidebarPage::Prices;
+        else if (S.sidePage == SidebarPage::Prices) S.sidePage = SidebarPage::Trades;
+        else S.sidePage = SidebarPage::Status;
+        return Dispatch::Render;
+    }
+
+    // Missions page interaction (works from any screen)
+    if (S.sidePage == SidebarPage::Missions) {
+        if (a.type == termui::ActionType::Back) {
+            S.sidePage = SidebarPage::Status;
+            return Dispatch::Render;
         }
+        if (a.type == termui::ActionType::Move && !S.poiOffers.empty()) {
+            if (a.dy != 0) S.offerSel += a.dy;
+            else if (a.dx != 0) S.offerSel += a.dx;
+            S.offerSel = termui::clampi(S.offerSel, 0, (int)S.poiOffers.size()-1);
+            return Dispatch::Render;
+        }
+        if ((a.type == termui::ActionType::Confirm || a.type == termui::ActionType::Yes) && !S.poiOffers.empty()) {
+            acceptSelectedOffer(S);
+            return Dispatch::Render;
+        }
+        if (a.type == termui::ActionType::No && !S.poiOffers.empty()) {
+            declineSelectedOffer(S);
+            return Dispatch::Render;
+        }
+    }
 
-        if (S.P.cargo[(int)g] <= 0) { S.pushLog(L"Market: You have none to sell."); return; }
-        S.P.cargo[(int)g] -= 1;
-        S.P.credits += price;
+    // TAB behavior
+    if (a.type == termui::ActionType::TabRight || a.type == termui::ActionType::TabLeft) {
+        if (S.screen == Screen::Market) {
+            S.marketModeBuy = !S.marketModeBuy;
+            S.pushLog(S.marketModeBuy ? L"Market: BUY mode." : L"Market: SELL mode.");
+        } else {
+            if (S.screen == Screen::Galaxy) {
+                int at = systemIndexAtGalaxy(S, S.fleet.gx[S.pilot], S.fleet.gy[S.pilot]);
+                if (at < 0) {
+                    S.pushLog(L"Cannot enter System view: you are in deep space.");
+                } else {
+                    S.currentSystem = at; // ensure index matches where you're actually located
+                    S.screen = Screen::System;
+                }
+            } else {
+                S.screen = Screen::Galaxy;
+            }
+        }
+        return Dispatch::Render;
+    }
 
-        std::wstringstream oss; oss << L"Sold 1 " << GOOD_NAME[(int)g] << L".";
-        S.pushLog(oss.str());
+    // Screen-specific input
+    if (S.screen == Screen::Galaxy) {
+        if (a.type == termui::ActionType::ZoomIn || a.type == termui::ActionType::ZoomOut) {
+            int z = S.gZoom + (a.type == termui::ActionType::ZoomOut ? 1 : -1);
+            z = termui::clampi(z, 0, std::max(0, S.galaxyMip.levelCount() - 1));
+            // keep the camera over the same area; render re-clamps it
+            S.gCamX = (S.gCamX << S.gZoom) >> z;
+            S.gCamY = (S.gCamY << S.gZoom) >> z;
+            S.gZoom = z;
+            return Dispatch::Render;
+        }
+        if (a.type == termui::ActionType::Move) {
+            // one press moves one cell at the current zoom
+            S.gCurX += a.dx * (1 << S.gZoom); S.gCurY += a.dy * (1 << S.gZoom);
+            return Dispatch::Render;
+        }
+        if (a.type == termui::ActionType::Confirm) { doGalaxyJump(S); return Dispatch::Render; }
+        if (a.type == termui::ActionType::FleetOrder) { fleetOrderTravel(S, S.gCurX, S.gCurY); return Dispatch::Render; }
+        if (a.type == termui::ActionType::PlotRoute) { plotRoute(S); return Dispatch::Render; }
+    }
+    else if (S.screen == Screen::System) {
+        if (a.type == termui::ActionType::Move) { S.sCurX += a.dx; S.sCurY += a.dy; return Dispatch::Render; }
+        if (a.type == termui::ActionType::Confirm) { doSystemJump(S); return Dispatch::Render; }
+        if (a.type == termui::ActionType::Select) { S.screen = Screen::Market; S.marketSel = 0; S.marketModeBuy = true; return Dispatch::Render; }
+        if (a.type == termui::ActionType::BuyShip) { buyShip(S); return Dispatch::Render; }
+        if (a.type == termui::ActionType::PlotRoute) { plotRoute(S); return Dispatch::Render; }
+    }
+    else { // Market
+        if (a.type == termui::ActionType::Back) { S.screen = Screen::System; return Dispatch::Render; }
+        if (a.type == termui::ActionType::Move) {
+            if (a.dy != 0) S.marketSel += a.dy;
+            else if (a.dx != 0) S.marketSel += a.dx;
+            S.marketSel = termui::clampi(S.marketSel, 0, (int)Good::COUNT - 1);
+            return Dispatch::Render;
+        }
+        if (a.type == termui::ActionType::Confirm) { marketTradeSelected(S, TradeQty::Units, 1); return Dispatch::Render; }
+        if (a.type == termui::ActionType::TradeUnits) { marketTradeSelected(S, TradeQty::Units, a.dx); return Dispatch::Render; }
+        if (a.type == termui::ActionType::TradeMax) {
+            marketTradeSelected(S, S.marketModeBuy ? TradeQty::MaxAffordable : TradeQty::DumpAll);
+            return Dispatch::Render;
+        }
+        if (a.type == termui::ActionType::TradeFill && S.marketModeBuy) { marketTradeSelected(S, TradeQty::FillHold); return Dispatch::Render; }
+        if (a.type == termui::ActionType::BuyShip) { buyShip(S); return Dispatch::Render; }
     }
+    return Dispatch::Ignore;
 }
 
-// ---------------- Main ----------------
-int main() {
-	srand((unsigned)time(nullptr));
-	std::cout << "Debug Welcome Menu: Press ENTER to play" << std::endl;
-	std::cout << "MAXIMIZE WINDOW NOW" << std::endl;
-	std::cin.get();
-	
-    termui::Canvas C;
-    C.configure(true, false);
-    termui::Input I(C.in());
+// Queue the sectors around the ship and the galaxy map view for background
+// generation, so travel and panning rarely hit a synchronous sector load.
+static void prefetchAroundViews(GameState& S) {
+    S.galaxy.prefetch(S.fleet.gx[S.pilot], S.fleet.gy[S.pilot], 1);
+
+    int z = S.gZoom;
+    int cx = (S.gCamX + S.gViewCols / 2) << z;
+    int cy = (S.gCamY + S.gViewRows / 2) << z;
+    int radius = ((std::max(S.gViewCols, S.gViewRows) << z) / 2) / SECTOR_SIZE + 1;
+    S.galaxy.prefetch(cx, cy, std::min(radius, 4));
+}
+
+// ---------------- Replay ----------------
+// Feeds a recording through handleAction/renderAll and reports per-action
+// processing and render time. `paced` sleeps to reproduce recorded timing.
+static int runReplay(termui::Canvas& C, const std::string& path, bool paced) {
+    replay::Recording rec;
+    std::string err;
+    if (!replay::load(path, rec, err)) { std::cerr << "Replay: " << err << std::endl; return 2; }
 
     GameState S;
-    initGalaxy(S);
+    initGalaxy(S, rec.header.seed);
 
-    auto sz = C.windowSize();
-    termui::Layout L = termui::computeLayout(sz.w, sz.h);
+    termui::Size sz{ rec.header.w, rec.header.h };
+    auto layoutFor = [&]() { return termui::computeLayout(sz.w, sz.h, S.showPerf ? 6 : 3); };
+    termui::Layout L = layoutFor();
     C.clearAll(termui::FG_WHITE);
     renderAll(C, L, S);
 
-    while (true) {
-        termui::Action a = I.readActionBlocking();
+    struct Timing { double processMs = 0, renderMs = 0; };
+    std::vector<Timing> timings;
+    timings.reserve(rec.entries.size());
+    perf::FrameStats allocFrames;       // one frame per action, allocations only
+    auto allocFrame = [&allocFrames]() {
+        perf::FrameSample f;
+        for (int t = 0; t < perf::ALLOC_TAGS; t++) f.alloc[t] = perf::frameAllocCounters((perf::AllocTag)t);
+        allocFrames.add(f);
+    };
 
-        if (a.type == termui::ActionType::Quit) break;
+    double start = perf::nowMs();
+    for (const replay::Entry& e : rec.entries) {
+        if (paced) {
+            double wait = start + e.tMs - perf::nowMs();
+            if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(wait));
+        }
 
-        if (a.type == termui::ActionType::Resize) {
-            sz = C.windowSize();
-            L = termui::computeLayout(sz.w, sz.h);
+        S.galaxy.beginFrame();
+        perf::beginAllocFrame();
+        double t0 = perf::nowMs();
+        Dispatch d = handleAction(S, e.action);
+        double t1 = perf::nowMs();
+        if (d == Dispatch::Quit) break;
+        if (d == Dispatch::Ignore) { timings.push_back({ t1 - t0, 0 }); allocFrame(); continue; }
+        if (d == Dispatch::Relayout) {
+            if (e.action.type == termui::ActionType::Resize) sz = { e.w, e.h };
+            L = layoutFor();
             C.clearAll(termui::FG_WHITE);
-            renderAll(C, L, S);
-            continue;
         }
+        renderAll(C, L, S);
+        double t2 = perf::nowMs();
+        timings.push_back({ t1 - t0, t2 - t1 });
+        allocFrame();
+        prefetchAroundViews(S);
+    }
+    double total = perf::nowMs() - start;
 
-        if (a.type == termui::ActionType::ClearLog) {
-            S.clearLog();
-            S.pushLog(L"(log cleared)");
-            renderAll(C, L, S);
-            continue;
-        }
+    // Report after the console frame so it is not overwritten.
+    C.clearAll(termui::FG_WHITE);
+    C.gotoXY(0, 0);
+
+    std::ofstream csv("replay_report.csv");
+    csv << "action,type,process_ms,render_ms\n";
+    double sumP = 0, sumR = 0, maxP = 0, maxR = 0;
+    for (size_t i = 0; i < timings.size(); i++) {
+        const Timing& t = timings[i];
+        csv << i << "," << (int)rec.entries[i].action.type << "," << t.processMs << "," << t.renderMs << "\n";
+        sumP += t.processMs; sumR += t.renderMs;
+        maxP = std::max(maxP, t.processMs); maxR = std::max(maxR, t.renderMs);
+    }
 
-        if (a.type == termui::ActionType::SidebarToggle) {
-            // NEW: cycle 3 pages
-            if (S.sidePage == SidebarPage::Status) S.sidePage = SidebarPage::Cargo;
-            else if (S.sidePage == SidebarPage::Cargo) S.sidePage = SidebarPage::Missions;
-            else S.sidePage = SidebarPage::Status;
-            renderAll(C, L, S);
-            continue;
+    size_t n = std::max<size_t>(1, timings.size());
+    uint64_t digest = stateDigest(S);
+    std::cout << "Replay: " << timings.size() << " actions in " << total << " ms"
+              << (paced ? " (paced)" : " (full speed)") << "\n"
+              << "  process ms: avg " << sumP / n << "  max " << maxP << "\n"
+              << "  render  ms: avg " << sumR / n << "  max " << maxR << "\n"
+              << "  per-action timings: replay_report.csv\n"
+              << "  allocations by tag: " << (perf::writeAllocReport("replay_allocs.csv", allocFrames) ? "replay_allocs.csv" : "(not written)") << "\n"
+              << "  final digest: " << std::hex << digest << std::dec;
+    if (!rec.hasDigest) {
+        std::cout << "  (recording has no digest)" << std::endl;
+        return 0;
+    }
+    if (digest == rec.digest) {
+        std::cout << "  MATCH" << std::endl;
+        return 0;
+    }
+    std::cout << "  MISMATCH (recorded " << std::hex << rec.digest << std::dec << ")" << std::endl;
+    return 1;
+}
+
+// ---------------- Server mode ----------------
+// One authoritative GameState hosts the shared universe. Each connected
+// operator gets a Seat: a manned ship of the fleet plus their own screen,
+// cursors, log and contract board. A seat is swapped into GameState around
+// each of its actions, so handleAction and the renderers work unchanged;
+// credits, missions, markets, the fleet and the clock are shared.
+//
+// Clients send Action records, and a View record (map camera and size in
+// cells) whenever their galaxy map moves; the camera is theirs to own.
+// Every tick the server applies all queued actions, then sends each client
+// one frame holding only the records that changed among those the client can
+// see: markets of the system it is in, company missions, its contract board
+// and ships in its map view. Shared records are encoded once per tick and
+// reused by every client that sees them; per client the server only compares
+// hashes, and an idle client costs no bandwidth.
+static const int SERVER_TICK_MS = 50;
+static const uint32_t NET_PROTOCOL = 3;
+static const size_t NET_LOG_LINES = 40;
+
+enum class Rec : uint8_t { Welcome = 1, Clock, Seat, Log, Market, Missions, Offers, FleetSize, Ship, Action, View };
+
+struct Seat {
+    int pilot = 0;
+    Screen screen = Screen::Galaxy;
+    SidebarPage sidePage = SidebarPage::Status;
+    int gCurX = 0, gCurY = 0, gCamX = 0, gCamY = 0, gZoom = 0, gViewCols = 0, gViewRows = 0;
+    int currentSystem = 0;
+    int sCurX = 0, sCurY = 0, sCamX = 0, sCamY = 0;
+    int marketSel = 0;
+    bool marketModeBuy = true;
+    std::deque<std::wstring> log;
+    int dockPoiIndex = 0, dockVisit = 0;
+    std::vector<Mission> poiOffers;
+    int offerSel = 0;
+    RouteLayer routeGalaxy, routeSystem;
+    bool showRouteGalaxy = false, showRouteSystem = false;
+};
+
+static void swapSeat(GameState& S, Seat& t) {
+    using std::swap;
+    swap(S.pilot, t.pilot); swap(S.screen, t.screen); swap(S.sidePage, t.sidePage);
+    swap(S.gCurX, t.gCurX); swap(S.gCurY, t.gCurY); swap(S.gCamX, t.gCamX); swap(S.gCamY, t.gCamY);
+    swap(S.gZoom, t.gZoom); swap(S.gViewCols, t.gViewCols); swap(S.gViewRows, t.gViewRows);
+    swap(S.currentSystem, t.currentSystem);
+    swap(S.sCurX, t.sCurX); swap(S.sCurY, t.sCurY); swap(S.sCamX, t.sCamX); swap(S.sCamY, t.sCamY);
+    swap(S.marketSel, t.marketSel); swap(S.marketModeBuy, t.marketModeBuy);
+    swap(S.log, t.log);
+    swap(S.dockPoiIndex, t.dockPoiIndex); swap(S.dockVisit, t.dockVisit);
+    swap(S.poiOffers, t.poiOffers); swap(S.offerSel, t.offerSel);
+    S.gen.offers++;
+    swap(S.routeGalaxy, t.routeGalaxy); swap(S.routeSystem, t.routeSystem);
+    swap(S.showRouteGalaxy, t.showRouteGalaxy); swap(S.showRouteSystem, t.showRouteSystem);
+}
+
+static uint64_t fnv1a(const std::vector<uint8_t>& b) {
+    uint64_t h = 1469598103934665603ull;
+    for (uint8_t c : b) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+// ---- record encoding (server) / decoding (client)
+static void encodeMissionList(net::Writer& w, Rec tag, const std::vector<Mission>& v) {
+    w.u8((uint8_t)tag);
+    w.varint(v.size());
+    for (const Mission& m : v) {
+        w.u8((uint8_t)((m.active ? 1 : 0) | (m.completed ? 2 : 0)));
+        w.svarint(m.fromSystem); w.svarint(m.fromPoi); w.svarint(m.toSystem); w.svarint(m.toPoi);
+        w.u8((uint8_t)m.good); w.svarint(m.amount); w.svarint(m.reward);
+        w.svarint(m.deadlineWeeks); w.svarint(m.dueWeek);
+    }
+}
+static std::vector<Mission> decodeMissionList(net::Reader& r) {
+    std::vector<Mission> v((size_t)std::min<uint64_t>(r.varint(), (uint64_t)(r.end - r.p)));
+    for (Mission& m : v) {
+        uint8_t f = r.u8();
+        m.active = (f & 1) != 0; m.completed = (f & 2) != 0;
+        m.fromSystem = (int)r.svarint(); m.fromPoi = (int)r.svarint();
+        m.toSystem = (int)r.svarint(); m.toPoi = (int)r.svarint();
+        m.good = (Good)std::min<int>(r.u8(), (int)Good::COUNT - 1);
+        m.amount = (int)r.svarint(); m.reward = (int)r.svarint();
+        m.deadlineWeeks = (int)r.svarint(); m.dueWeek = (int)r.svarint();
+    }
+    return v;
+}
+
+static void encodeMarket(net::Writer& w, const GameState& S, int system) {
+    const StarSystem& sys = S.galaxy[system];
+    w.u8((uint8_t)Rec::Market);
+    w.varint((uint64_t)system);
+    w.varint(sys.pois.size());
+    for (const SystemPoi& p : sys.pois)
+        for (int g = 0; g < (int)Good::COUNT; g++) {
+            w.svarint(p.market.price[g]); w.svarint(p.market.stock[g]); w.svarint(p.market.pressure[g]);
         }
+}
 
-        // Missions page interaction (works from any screen)
-        if (S.sidePage == SidebarPage::Missions) {
-            if (a.type == termui::ActionType::Back) {
-                S.sidePage = SidebarPage::Status;
-                renderAll(C, L, S);
-                continue;
-            }
-            if (a.type == termui::ActionType::Move && !S.poiOffers.empty()) {
-                if (a.dy != 0) S.offerSel += a.dy;
-                else if (a.dx != 0) S.offerSel += a.dx;
-                S.offerSel = termui::clampi(S.offerSel, 0, (int)S.poiOffers.size()-1);
-                renderAll(C, L, S);
-                continue;
-            }
-            if ((a.type == termui::ActionType::Confirm || a.type == termui::ActionType::Yes) && !S.poiOffers.empty()) {
-                acceptSelectedOffer(S);
-                renderAll(C, L, S);
-                continue;
+static void encodeShip(net::Writer& w, const Fleet& F, int i) {
+    w.u8((uint8_t)Rec::Ship);
+    w.varint((uint64_t)i);
+    w.svarint(F.gx[i]); w.svarint(F.gy[i]); w.svarint(F.sx[i]); w.svarint(F.sy[i]);
+    w.svarint(F.fuel[i]); w.svarint(F.fuelMax[i]); w.svarint(F.cargoMax[i]);
+    for (const auto& c : F.cargo) w.svarint(c[i]);
+    w.u8(F.order[i]); w.svarint(F.tx[i]); w.svarint(F.ty[i]);
+}
+
+static void encodeSeat(net::Writer& w, const GameState& S) {
+    w.u8((uint8_t)Rec::Seat);
+    const int v[] = { S.pilot, (int)S.screen, (int)S.sidePage,
+                      S.gCurX, S.gCurY, S.gZoom,
+                      S.currentSystem, S.sCurX, S.sCurY,
+                      S.marketSel, S.marketModeBuy ? 1 : 0, S.dockPoiIndex, S.offerSel,
+                      S.showRouteGalaxy ? 1 : 0, S.showRouteSystem ? 1 : 0 };
+    for (int x : v) w.svarint(x);
+    auto route = [&](const RouteLayer& r) {
+        w.varint(r.hops().size());
+        if (r.empty()) return;
+        w.svarint(r.from().first); w.svarint(r.from().second); w.varint((uint64_t)r.reached());
+        for (const auto& p : r.hops()) { w.svarint(p.first); w.svarint(p.second); }
+    };
+    route(S.routeGalaxy);
+    route(S.routeSystem);
+}
+
+static void encodeLog(net::Writer& w, const GameState& S) {
+    w.u8((uint8_t)Rec::Log);
+    size_t n = std::min(S.log.size(), NET_LOG_LINES);
+    w.varint(n);
+    for (size_t i = 0; i < n; i++) w.wstr(S.log[i]);
+}
+
+// ---- server
+struct ClientSession {
+    net::Conn conn;
+    Seat seat;
+    std::unordered_map<uint64_t, uint64_t> sent;   // record key -> hash last sent
+};
+
+static uint64_t recKey(Rec tag, uint64_t id) { return ((uint64_t)tag << 56) | id; }
+
+// Records shared between clients, encoded at most once per tick.
+struct TickCache {
+    struct Entry { std::vector<uint8_t> bytes; uint64_t hash = 0; };
+    std::unordered_map<uint64_t, Entry> recs;
+    std::unordered_map<uint64_t, std::vector<int>> shipsBySector;
+
+    template <class Encode>
+    const Entry& get(uint64_t key, Encode&& encode) {
+        auto it = recs.find(key);
+        if (it != recs.end()) return it->second;
+        net::Writer w;
+        encode(w);
+        Entry& e = recs[key];
+        e.hash = fnv1a(w.buf);
+        e.bytes = std::move(w.buf);
+        return e;
+    }
+};
+
+static uint64_t sectorKey(int sx, int sy) { return ((uint64_t)(uint32_t)sx << 32) | (uint32_t)sy; }
+static int floorDivI(int a, int b) { return (a >= 0) ? a / b : -((-a + b - 1) / b); }
+
+// Builds one delta frame for the seat currently swapped into S. Returns false
+// when nothing the client can see changed.
+static bool buildDelta(GameState& S, ClientSession& c, TickCache& cache, net::Writer& out) {
+    size_t start = out.buf.size();
+    auto emit = [&](uint64_t key, const TickCache::Entry& e) {
+        uint64_t& last = c.sent[key];
+        if (last == e.hash) return;
+        last = e.hash;
+        out.bytes(e.bytes);
+    };
+    auto emitOwn = [&](Rec tag, const std::function<void(net::Writer&)>& encode) {
+        net::Writer w;
+        encode(w);
+        TickCache::Entry e;
+        e.hash = fnv1a(w.buf);
+        e.bytes = std::move(w.buf);
+        emit(recKey(tag, 0), e);
+    };
+
+    const Fleet& F = S.fleet;
+    emitOwn(Rec::Clock, [&](net::Writer& w) {
+        w.u8((uint8_t)Rec::Clock);
+        w.svarint(S.date.weeks); w.svarint(S.P.credits); w.svarint(S.P.crew);
+    });
+    emitOwn(Rec::Seat, [&](net::Writer& w) { encodeSeat(w, S); });
+    emitOwn(Rec::Log, [&](net::Writer& w) { encodeLog(w, S); });
+    emitOwn(Rec::Offers, [&](net::Writer& w) { encodeMissionList(w, Rec::Offers, S.poiOffers); });
+    emit(recKey(Rec::Missions, 0), cache.get(recKey(Rec::Missions, 0), [&](net::Writer& w) {
+        encodeMissionList(w, Rec::Missions, S.activeMissions);
+    }));
+
+    // Markets: the system you are docked in and the one the screens show.
+    int here = systemIndexAtGalaxy(S, F.gx[S.pilot], F.gy[S.pilot]);
+    for (int sys : { here, S.currentSystem }) {
+        if (sys < 0) continue;   // deep space; a repeat is filtered by its hash
+        uint64_t key = recKey(Rec::Market, (uint64_t)sys);
+        emit(key, cache.get(key, [&](net::Writer& w) { encodeMarket(w, S, sys); }));
+    }
+
+    // Ships: your own, those in the sectors around it, and every ship in the
+    // galaxy map view.
+    emitOwn(Rec::FleetSize, [&](net::Writer& w) { w.u8((uint8_t)Rec::FleetSize); w.varint((uint64_t)F.size()); });
+    auto emitShip = [&](int i) {
+        uint64_t key = recKey(Rec::Ship, (uint64_t)i);
+        emit(key, cache.get(key, [&](net::Writer& w) { encodeShip(w, F, i); }));
+    };
+    emitShip(S.pilot);
+    auto emitSectors = [&](int x0, int y0, int x1, int y1) {
+        x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+        x1 = std::min(x1, S.galaxy.sectorsX() - 1); y1 = std::min(y1, S.galaxy.sectorsY() - 1);
+        for (int sy = y0; sy <= y1; sy++)
+            for (int sx = x0; sx <= x1; sx++) {
+                auto it = cache.shipsBySector.find(sectorKey(sx, sy));
+                if (it == cache.shipsBySector.end()) continue;
+                for (int i : it->second) emitShip(i);
             }
-            if (a.type == termui::ActionType::No && !S.poiOffers.empty()) {
-                declineSelectedOffer(S);
-                renderAll(C, L, S);
-                continue;
+    };
+    int px = floorDivI(F.gx[S.pilot], SECTOR_SIZE), py = floorDivI(F.gy[S.pilot], SECTOR_SIZE);
+    emitSectors(px - 1, py - 1, px + 1, py + 1);
+    if (S.gViewCols > 0 && S.gViewRows > 0) {
+        int z = S.gZoom;
+        emitSectors(floorDivI(S.gCamX << z, SECTOR_SIZE), floorDivI(S.gCamY << z, SECTOR_SIZE),
+                    floorDivI(((S.gCamX + S.gViewCols) << z) - 1, SECTOR_SIZE),
+                    floorDivI(((S.gCamY + S.gViewRows) << z) - 1, SECTOR_SIZE));
+    }
+
+    return out.buf.size() > start;
+}
+
+// Seats a new operator in a fresh ship docked at the starting system.
+static Seat newSeat(GameState& S) {
+    Seat seat;
+    swapSeat(S, seat);
+    SystemPos home = S.galaxy.pos(0);
+    S.pilot = S.fleet.add(home.gx, home.gy);
+    S.fleet.order[S.pilot] = (uint8_t)ShipOrder::Manned;
+    S.currentSystem = 0;
+    S.gCurX = home.gx; S.gCurY = home.gy;
+    S.sCurX = poiPos(S, 0, 0).x;
+    S.sCurY = poiPos(S, 0, 0).y;
+    std::wstringstream oss;
+    oss << L"Operator online, flying ship #" << (S.pilot + 1) << L".";
+    S.pushLog(oss.str());
+    dockAtPoi(S, 0, /*autoOpenMissions=*/false);
+    swapSeat(S, seat);
+    return seat;
+}
+
+static int runServer(uint16_t port, size_t sectorBudget) {
+    std::string err;
+    net::Listener listener;
+    if (!net::startup() || !listener.listen(port, err)) {
+        std::cerr << "Server: " << (err.empty() ? "winsock startup failed" : err) << std::endl;
+        return 1;
+    }
+
+    GameState S;
+    uint32_t seed = (uint32_t)rand();
+    initGalaxy(S, seed);
+    S.galaxy.setBudget(sectorBudget);
+    S.fleet.order[S.pilot] = (uint8_t)ShipOrder::Hold;   // the host seat flies nothing
+
+    std::vector<std::unique_ptr<ClientSession>> clients;
+    ClientSession* acting = nullptr;
+
+    // Events due for a seat other than the acting one run in that seat.
+    S.withVisitSeat = [&](int visit, const Scheduler::Handler& fn) {
+        for (auto& c : clients) {
+            if (c->seat.dockVisit != visit || c.get() == acting) continue;
+            if (acting) swapSeat(S, acting->seat);
+            swapSeat(S, c->seat);
+            fn(S);
+            swapSeat(S, c->seat);
+            if (acting) swapSeat(S, acting->seat);
+            return;
+        }
+    };
+
+    std::cout << "Server: listening on 127.0.0.1:" << port << " (seed " << seed << ")" << std::endl;
+    uint64_t tick = 0, bytesAtReport = 0;
+    double lastReport = perf::nowMs();
+
+    for (;;) {
+        double t0 = perf::nowMs();
+        S.galaxy.beginFrame();
+
+        for (net::Conn conn = listener.accept(); conn.valid(); conn = listener.accept()) {
+            auto c = std::make_unique<ClientSession>();
+            c->conn = std::move(conn);
+            c->seat = newSeat(S);
+            net::Writer w;
+            w.u8((uint8_t)Rec::Welcome);
+            w.varint(NET_PROTOCOL); w.varint(seed);
+            c->conn.send(w.buf);
+            clients.push_back(std::move(c));
+        }
+
+        // Apply every queued action, one seat at a time.
+        std::vector<uint8_t> frame;
+        for (auto& c : clients) {
+            c->conn.poll();
+            while (c->conn.nextFrame(frame)) {
+                net::Reader r(frame);
+                while (r.ok && !r.done()) {
+                    Rec tag = (Rec)r.u8();
+                    if (tag == Rec::View) {
+                        // Untrusted: keep the camera on the seat's map level and the view sane.
+                        Seat& v = c->seat;
+                        const GalaxyMip::Level& lv = S.galaxyMip.levels[termui::clampi(v.gZoom, 0, S.galaxyMip.levelCount() - 1)];
+                        long long camX = r.svarint(), camY = r.svarint(), cols = r.svarint(), rows = r.svarint();
+                        v.gCamX = (int)std::clamp<long long>(camX, 0, lv.w - 1);
+                        v.gCamY = (int)std::clamp<long long>(camY, 0, lv.h - 1);
+                        v.gViewCols = (int)std::clamp<long long>(cols, 1, 1024);
+                        v.gViewRows = (int)std::clamp<long long>(rows, 1, 1024);
+                        continue;
+                    }
+                    if (tag != Rec::Action) { r.ok = false; break; }
+                    termui::Action a;
+                    a.type = (termui::ActionType)r.u8();
+                    a.dx = (int)r.svarint();
+                    a.dy = (int)r.svarint();
+                    if (!r.ok || a.type == termui::ActionType::Quit) break;
+                    acting = c.get();
+                    swapSeat(S, c->seat);
+                    handleAction(S, a);
+                    swapSeat(S, c->seat);
+                    acting = nullptr;
+                }
             }
         }
 
-        // TAB behavior
-        if (a.type == termui::ActionType::TabRight || a.type == termui::ActionType::TabLeft) {
-            if (S.screen == Screen::Market) {
-                S.marketModeBuy = !S.marketModeBuy;
-                S.pushLog(S.marketModeBuy ? L"Market: BUY mode." : L"Market: SELL mode.");
-            } else {
-                if (S.screen == Screen::Galaxy) {
-                    int at = systemIndexAtGalaxy(S, S.shipGX, S.shipGY);
-                    if (at < 0) {
-                        S.pushLog(L"Cannot enter System view: you are in deep space.");
-                    } else {
-                        S.currentSystem = at; // ensure index matches where you're actually located
-                        S.screen = Screen::System;
+        // Drop operators who left; their ships stay in the fleet.
+        for (auto& c : clients)
+            if (!c->conn.valid()) S.fleet.order[c->seat.pilot] = (uint8_t)ShipOrder::Hold;
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                     [](const std::unique_ptr<ClientSession>& c) { return !c->conn.valid(); }),
+                      clients.end());
+
+        // One frame per client with what changed.
+        TickCache cache;
+        for (int i = 0; i < S.fleet.size(); i++)
+            cache.shipsBySector[sectorKey(floorDivI(S.fleet.gx[i], SECTOR_SIZE), floorDivI(S.fleet.gy[i], SECTOR_SIZE))].push_back(i);
+        uint64_t bytes = 0;
+        for (auto& c : clients) {
+            net::Writer w;
+            w.varint(tick);
+            swapSeat(S, c->seat);
+            bool changed = buildDelta(S, *c, cache, w);
+            swapSeat(S, c->seat);
+            if (changed) c->conn.send(w.buf);
+            c->conn.flush();
+            bytes += c->conn.bytesSent();
+        }
+
+        if (t0 - lastReport >= 1000) {
+            std::cout << "Server: week " << S.date.weeks << "  clients " << clients.size()
+                      << "  ships " << S.fleet.size() << "  tx " << (bytes >= bytesAtReport ? bytes - bytesAtReport : bytes)
+                      << " B/s  tick " << (perf::nowMs() - t0) << " ms" << std::endl;
+            bytesAtReport = bytes;
+            lastReport = t0;
+        }
+        tick++;
+
+        double wait = SERVER_TICK_MS - (perf::nowMs() - t0);
+        if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(wait));
+    }
+}
+
+// ---- client
+// Applies one server frame to the client's mirror GameState.
+static bool applyServerFrame(GameState& S, const std::vector<uint8_t>& frame) {
+    net::Reader r(frame);
+    r.varint();   // tick
+    Fleet& F = S.fleet;
+    while (r.ok && !r.done()) {
+        Rec tag = (Rec)r.u8();
+        switch (tag) {
+            case Rec::Clock:
+                S.date.weeks = (int)r.svarint(); S.P.credits = (int)r.svarint(); S.P.crew = (int)r.svarint();
+                S.gen.date++;
+                break;
+            case Rec::Seat: {
+                int v[15];
+                for (int& x : v) x = (int)r.svarint();
+                S.pilot = v[0]; S.screen = (Screen)v[1]; S.sidePage = (SidebarPage)v[2];
+                S.gCurX = v[3]; S.gCurY = v[4]; S.gZoom = v[5];
+                S.currentSystem = v[6]; S.sCurX = v[7]; S.sCurY = v[8];
+                S.marketSel = v[9]; S.marketModeBuy = v[10] != 0; S.dockPoiIndex = v[11]; S.offerSel = v[12];
+                S.showRouteGalaxy = v[13] != 0; S.showRouteSystem = v[14] != 0;
+                // Re-rasterize only when the plotted route itself changed.
+                for (int k = 0; k < 2; k++) {
+                    RouteLayer& layer = k == 0 ? S.routeGalaxy : S.routeSystem;
+                    size_t n = (size_t)std::min<uint64_t>(r.varint(), (uint64_t)(r.end - r.p));
+                    if (n == 0) { layer.clear(); continue; }
+                    int fx = (int)r.svarint(), fy = (int)r.svarint(), reached = (int)r.varint();
+                    std::vector<std::pair<int,int>> hops(n);
+                    for (auto& p : hops) { p.first = (int)r.svarint(); p.second = (int)r.svarint(); }
+                    if (hops != layer.hops() || layer.from() != std::make_pair(fx, fy)) {
+                        if (k == 0) layer.set(fx, fy, hops, S.galaxyW, S.galaxyH, S.galaxyMip.levelCount());
+                        else        layer.set(fx, fy, hops, S.galaxy[S.currentSystem].size, S.galaxy[S.currentSystem].size);
                     }
-                } else {
-                    S.screen = Screen::Galaxy;
+                    layer.setReached(reached);
                 }
+                break;
             }
-            renderAll(C, L, S);
-            continue;
+            case Rec::Log: {
+                size_t n = (size_t)std::min<uint64_t>(r.varint(), NET_LOG_LINES);
+                S.log.clear();
+                for (size_t i = 0; i < n; i++) S.log.push_back(r.wstr());
+                break;
+            }
+            case Rec::Market: {
+                int sys = (int)r.varint();
+                size_t n = (size_t)r.varint();
+                if (sys < 0 || sys >= S.galaxy.size() || n != S.galaxy[sys].pois.size()) return false;
+                std::vector<MarketRef> movedMarkets;
+                for (int i = 0; i < (int)n; i++) {
+                    Market& m = writeMarket(S, sys, i);
+                    bool moved = false, changed = false;
+                    for (int g = 0; g < (int)Good::COUNT; g++) {
+                        int price0 = m.priceOf((Good)g), stock0 = m.stock[g];
+                        int pressure0 = m.pressure[g];
+                        m.price[g] = (int)r.svarint(); m.stock[g] = (int)r.svarint(); m.pressure[g] = (int)r.svarint();
+                        if (m.priceOf((Good)g) != price0 || m.stock[g] != stock0) {
+                            S.prices.record(sys, i, (Good)g, S.date.weeks, price0, stock0, m.priceOf((Good)g), m.stock[g]);
+                            moved = true;
+                        }
+                        if (m.pressure[g] != pressure0) changed = true;
+                    }
+                    if (moved || changed) marketWritten(S, sys, i);
+                    if (moved) { S.priceIndex.update(S.galaxy, sys, i, m); movedMarkets.push_back({ sys, i }); }
+                }
+                S.arbitrage.changed(S.galaxy, S.priceIndex, movedMarkets);
+                break;
+            }
+            case Rec::Missions: {
+                for (const Mission& m : S.activeMissions) if (m.active && !m.completed) missionTargetChanged(S, m, -1);
+                S.activeMissions = decodeMissionList(r);
+                S.gen.missions++;
+                for (const Mission& m : S.activeMissions) if (m.active && !m.completed) missionTargetChanged(S, m, +1);
+                break;
+            }
+            case Rec::Offers:
+                S.poiOffers = decodeMissionList(r);
+                S.gen.offers++;
+                break;
+            case Rec::FleetSize: {
+                int n = (int)std::min<uint64_t>(r.varint(), 1u << 24);
+                while (F.size() < n) F.add(0, 0);
+                break;
+            }
+            case Rec::Ship: {
+                int i = (int)r.varint();
+                if (i < 0 || i >= F.size()) return false;
+                F.gx[i] = (int)r.svarint(); F.gy[i] = (int)r.svarint(); F.sx[i] = (int)r.svarint(); F.sy[i] = (int)r.svarint();
+                F.fuel[i] = (int)r.svarint(); F.fuelMax[i] = (int)r.svarint(); F.cargoMax[i] = (int)r.svarint();
+                for (auto& c : F.cargo) c[i] = (int)r.svarint();
+                F.touch(i);
+                F.order[i] = r.u8(); F.tx[i] = (int)r.svarint(); F.ty[i] = (int)r.svarint();
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    if (S.pilot >= 0 && S.pilot < F.size()) S.galaxyMip.setShip(F.gx[S.pilot], F.gy[S.pilot]);
+    return r.ok;
+}
+
+// Thin terminal client: forwards actions, mirrors what the server sends and
+// renders it with the normal renderers. Resize and the F3 overlay stay local.
+static int runClient(termui::Canvas& C, termui::Input& I, uint16_t port, size_t sectorBudget) {
+    std::string err;
+    if (!net::startup()) { std::cerr << "Client: winsock startup failed" << std::endl; return 1; }
+    net::Conn conn = net::connect(port, err);
+    if (!conn.valid()) { std::cerr << "Client: " << err << std::endl; return 1; }
+
+    // Welcome carries the universe seed; the catalog and untouched markets
+    // are regenerated locally from it.
+    std::vector<uint8_t> frame;
+    uint32_t seed = 0;
+    for (double deadline = perf::nowMs() + 5000;;) {
+        if (!conn.poll() && !conn.valid()) { std::cerr << "Client: server closed the connection" << std::endl; return 1; }
+        if (conn.nextFrame(frame)) {
+            net::Reader r(frame);
+            if (r.u8() != (uint8_t)Rec::Welcome || r.varint() != NET_PROTOCOL) { std::cerr << "Client: protocol mismatch" << std::endl; return 1; }
+            seed = (uint32_t)r.varint();
+            break;
         }
+        if (perf::nowMs() > deadline) { std::cerr << "Client: no welcome from server" << std::endl; return 1; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    GameState S;
+    initGalaxy(S, seed);
+    S.galaxy.setBudget(sectorBudget);
+    S.clearLog();
 
-        // Screen-specific input
-        if (S.screen == Screen::Galaxy) {
-            if (a.type == termui::ActionType::Move) { S.gCurX += a.dx; S.gCurY += a.dy; renderAll(C, L, S); continue; }
-            if (a.type == termui::ActionType::Confirm) { doGalaxyJump(S); renderAll(C, L, S); continue; }
+    // The input thread blocks in the console read and cannot be joined, so
+    // it owns everything it touches: its own Input (a handle) and a share of
+    // the queue, which outlives this function if need be.
+    struct Pending {
+        std::mutex mu;
+        std::deque<termui::Action> actions;
+    };
+    auto pending = std::make_shared<Pending>();
+    std::thread([in = I, pending]() mutable {
+        for (;;) {
+            termui::Action a = in.readActionBlocking();
+            std::lock_guard<std::mutex> lock(pending->mu);
+            pending->actions.push_back(a);
+            if (a.type == termui::ActionType::Quit) return;
         }
-        else if (S.screen == Screen::System) {
-            if (a.type == termui::ActionType::Move) { S.sCurX += a.dx; S.sCurY += a.dy; renderAll(C, L, S); continue; }
-            if (a.type == termui::ActionType::Confirm) { doSystemJump(S); renderAll(C, L, S); continue; }
-            if (a.type == termui::ActionType::Select) { S.screen = Screen::Market; S.marketSel = 0; S.marketModeBuy = true; renderAll(C, L, S); continue; }
+    }).detach();
+
+    auto sz = C.windowSize();
+    auto layoutFor = [&]() { return termui::computeLayout(sz.w, sz.h, S.showPerf ? 6 : 3); };
+    termui::Layout L = layoutFor();
+    C.clearAll(termui::FG_WHITE);
+    bool dirty = true;
+    int sentView[4] = { -1, -1, -1, -1 };
+
+    for (;;) {
+        std::deque<termui::Action> actions;
+        {
+            std::lock_guard<std::mutex> lock(pending->mu);
+            actions.swap(pending->actions);
         }
-        else { // Market
-            if (a.type == termui::ActionType::Back) { S.screen = Screen::System; renderAll(C, L, S); continue; }
-            if (a.type == termui::ActionType::Move) {
-                if (a.dy != 0) S.marketSel += a.dy;
-                else if (a.dx != 0) S.marketSel += a.dx;
-                S.marketSel = termui::clampi(S.marketSel, 0, (int)Good::COUNT - 1);
-                renderAll(C, L, S);
+        net::Writer w;
+        for (const termui::Action& a : actions) {
+            if (a.type == termui::ActionType::Quit) return 0;
+            if (a.type == termui::ActionType::Resize || a.type == termui::ActionType::PerfOverlay) {
+                if (a.type == termui::ActionType::Resize) sz = C.windowSize();
+                else S.showPerf = !S.showPerf;
+                L = layoutFor();
+                C.clearAll(termui::FG_WHITE);
+                dirty = true;
                 continue;
             }
-            if (a.type == termui::ActionType::Confirm) { marketTradeOne(S); renderAll(C, L, S); continue; }
+            w.u8((uint8_t)Rec::Action);
+            w.u8((uint8_t)a.type); w.svarint(a.dx); w.svarint(a.dy);
+        }
+        if (!w.buf.empty()) conn.send(w.buf);
+        conn.flush();
+
+        if (!conn.poll() && !conn.valid()) { std::cerr << "Client: server closed the connection" << std::endl; return 1; }
+        while (conn.nextFrame(frame)) {
+            S.galaxy.beginFrame();
+            if (!applyServerFrame(S, frame)) { std::cerr << "Client: bad frame from server" << std::endl; return 1; }
+            dirty = true;
+        }
+
+        if (dirty) {
+            renderAll(C, L, S);
+            dirty = false;
+
+            int view[4] = { S.gCamX, S.gCamY, S.gViewCols, S.gViewRows };
+            if (!std::equal(view, view + 4, sentView)) {
+                std::copy(view, view + 4, sentView);
+                net::Writer v;
+                v.u8((uint8_t)Rec::View);
+                for (int x : view) v.svarint(x);
+                conn.send(v.buf);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+// ---------------- Main ----------------
+// bench_main.cpp includes this file with SPACETRADER_NO_MAIN to reach the
+// game kernels without the console front end.
+#ifndef SPACETRADER_NO_MAIN
+// Usage: SpaceTrader [--record FILE] [--replay FILE [--paced]]
+//                    [--server [PORT]] [--connect [PORT]] [--catalog FILE]
+//                    [--sector-budget MB]
+//        SpaceTrader --convert-catalog IN.csv OUT
+// --sector-budget caps the memory of generated galaxy sectors (default 64).
+int main(int argc, char** argv) {
+    std::string recordPath, replayPath, catalogPath, convertIn, convertOut;
+    bool paced = false, server = false, client = false;
+    uint16_t port = net::DEFAULT_PORT;
+    size_t sectorBudget = Galaxy::DEFAULT_BUDGET;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--record" && i + 1 < argc) recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+        else if (arg == "--paced") paced = true;
+        else if (arg == "--catalog" && i + 1 < argc) catalogPath = argv[++i];
+        else if (arg == "--sector-budget" && i + 1 < argc) {
+            long long mb = std::atoll(argv[++i]);
+            if (mb < 1) { std::cerr << "--sector-budget needs a size in MB" << std::endl; return 1; }
+            sectorBudget = (size_t)mb << 20;
+        }
+        else if (arg == "--convert-catalog" && i + 2 < argc) { convertIn = argv[++i]; convertOut = argv[++i]; }
+        else if (arg == "--server" || arg == "--connect") {
+            (arg == "--server" ? server : client) = true;
+            if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) port = (uint16_t)std::atoi(argv[++i]);
+        }
+    }
+
+    if (!convertIn.empty()) {
+        std::string err;
+        if (!catalog::convertCsv(convertIn, convertOut, SECTOR_SIZE, err)) {
+            std::cerr << "Catalog: " << err << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!replayPath.empty()) {
+        termui::Canvas C;
+        C.configure(false, true);
+        return runReplay(C, replayPath, paced);
+    }
+
+    // Recordings and multiplayer peers rebuild the universe from the seed
+    // alone, so a catalog is for single-player, unrecorded sessions.
+    std::shared_ptr<catalog::Catalog> cat;
+    if (!catalogPath.empty()) {
+        std::string err;
+        cat = std::make_shared<catalog::Catalog>();
+        if (server || client || !recordPath.empty()) err = "--catalog cannot be combined with --record, --server or --connect";
+        else cat->open(catalogPath, SECTOR_SIZE, err);
+        if (!err.empty()) {
+            std::cerr << "Catalog: " << err << std::endl;
+            return 1;
+        }
+    }
+
+    srand((unsigned)time(nullptr));
+    if (server) return runServer(port, sectorBudget);
+    if (client) {
+        termui::Canvas C;
+        C.configure(true, false);
+        termui::Input I(C.in());
+        return runClient(C, I, port, sectorBudget);
+    }
+
+	std::cout << "Debug Welcome Menu: Press ENTER to play" << std::endl;
+	std::cout << "MAXIMIZE WINDOW NOW" << std::endl;
+	std::cin.get();
+	
+    termui::Canvas C;
+    C.configure(true, false);
+    termui::Input I(C.in());
+
+    GameState S;
+    bool journalOk = S.journal.open(JOURNAL_FILE);
+    uint32_t seed = (uint32_t)rand();
+    initGalaxy(S, seed, cat);
+    S.galaxy.setBudget(sectorBudget);
+    if (!journalOk) S.pushLog(L"Journal: could not open spacetrader_journal.bin; log history is off.");
+
+    auto sz = C.windowSize();
+    auto layoutFor = [&]() { return termui::computeLayout(sz.w, sz.h, S.showPerf ? 6 : 3); };
+    termui::Layout L = layoutFor();
+    C.clearAll(termui::FG_WHITE);
+    renderAll(C, L, S);
+
+    replay::Recorder recorder;
+    double sessionStart = perf::nowMs();
+    if (!recordPath.empty() && !recorder.open(recordPath, { seed, sz.w, sz.h }))
+        S.pushLog(L"Replay: could not open recording file.");
+
+    // Frame accounting for the performance overlay: a frame spans from the
+    // action being returned by Input to renderAll finishing. Allocations are
+    // counted from the end of the previous frame, so reading the input that
+    // caused a frame is charged to it.
+    double inputMs = 0;
+    uint64_t allocStart = perf::allocCount();
+    perf::beginAllocFrame();
+    auto present = [&]() {
+        C.resetStats();
+        double t0 = perf::nowMs();
+        renderAll(C, L, S);
+        double t1 = perf::nowMs();
+
+        const termui::CanvasStats& cs = C.stats();
+        perf::FrameSample f;
+        f.frameMs = t1 - t0;
+        f.latencyMs = t1 - inputMs;
+        f.gotoXY = cs.gotoXY;
+        f.setAttr = cs.setAttr;
+        f.writeW = cs.writeW;
+        f.fill = cs.fill;
+        f.scroll = cs.scroll;
+        f.chars = cs.chars;
+        f.allocs = perf::allocCount() - allocStart;
+        for (int t = 0; t < perf::ALLOC_TAGS; t++) f.alloc[t] = perf::frameAllocCounters((perf::AllocTag)t);
+        S.frameStats.add(f);
+        allocStart = perf::allocCount();
+        perf::beginAllocFrame();
+    };
+
+    // Background results wake the loop; the frame they land in is redrawn.
+    termui::EventLoop loop(I);
+    bool woken = false;
+    S.scorer.setOnReady([&loop, &woken]() { loop.post([&woken]() { woken = true; }); });
+    if (recorder.isOpen()) loop.addTimer(RECORD_FLUSH_MS, RECORD_FLUSH_MS, [&recorder]() { recorder.flush(); });
+
+    while (true) {
+        termui::Action a;
+        {
+            ALLOC_SCOPE(Input);
+            a = loop.next();
+        }
+        inputMs = perf::nowMs();
+        if (a.type == termui::ActionType::None) {
+            if (woken) { woken = false; present(); }
+            continue;
+        }
+
+        S.galaxy.beginFrame();
+        if (a.type == termui::ActionType::Resize) sz = C.windowSize();
+        if (recorder.isOpen()) recorder.add((uint32_t)(inputMs - sessionStart), a, sz);
+
+        Dispatch d = handleAction(S, a);
+        I.setTextEntry(S.logView.editing);
+        if (d == Dispatch::Quit) break;
+        if (d == Dispatch::Ignore) continue;
+        if (d == Dispatch::Relayout) {
+            L = layoutFor();
+            C.clearAll(termui::FG_WHITE);
         }
+        present();
+        prefetchAroundViews(S);
     }
+    S.scorer.setOnReady(nullptr);   // the loop goes before S does
 
+    recorder.finish(stateDigest(S));
+    if (trace::compiledIn()) trace::exportChromeJson(TRACE_FILE);
+    perf::writeAllocReport(ALLOC_FILE, S.frameStats);
     return 0;
 }
+#endif // SPACETRADER_NO_MAIN
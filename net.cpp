@@ -0,0 +1,167 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "net.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+
+namespace net {
+
+static const uint32_t MAX_FRAME = 16u << 20;
+
+static SOCKET sock(uintptr_t s) { return (SOCKET)s; }
+
+static void setNonBlocking(SOCKET s) {
+    unsigned long on = 1;
+    ioctlsocket(s, FIONBIO, &on);
+}
+
+static void setNoDelay(SOCKET s) {
+    int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+}
+
+static sockaddr_in loopback(uint16_t port) {
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return a;
+}
+
+bool startup() {
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+}
+
+void shutdown() { WSACleanup(); }
+
+// ---------------- Conn ----------------
+Conn::Conn(uintptr_t s) : s_(s) {
+    setNonBlocking(sock(s_));
+    setNoDelay(sock(s_));
+}
+
+Conn::~Conn() { close(); }
+
+Conn::Conn(Conn&& o) noexcept { *this = std::move(o); }
+
+Conn& Conn::operator=(Conn&& o) noexcept {
+    if (this != &o) {
+        close();
+        s_ = o.s_; o.s_ = INVALID;
+        in_ = std::move(o.in_);
+        inPos_ = o.inPos_; o.inPos_ = 0;
+        out_ = std::move(o.out_);
+        outPos_ = o.outPos_; o.outPos_ = 0;
+        sent_ = o.sent_;
+    }
+    return *this;
+}
+
+void Conn::close() {
+    if (s_ != INVALID) closesocket(sock(s_));
+    s_ = INVALID;
+    in_.clear(); out_.clear(); inPos_ = outPos_ = 0;
+}
+
+void Conn::send(const std::vector<uint8_t>& payload) {
+    uint32_t n = (uint32_t)payload.size();
+    for (int i = 0; i < 4; i++) out_.push_back((uint8_t)(n >> (8 * i)));
+    out_.insert(out_.end(), payload.begin(), payload.end());
+}
+
+bool Conn::flush() {
+    if (!valid()) return false;
+    while (outPos_ < out_.size()) {
+        int n = ::send(sock(s_), (const char*)out_.data() + outPos_, (int)(out_.size() - outPos_), 0);
+        if (n == SOCKET_ERROR) {
+            if (WSAGetLastError() == WSAEWOULDBLOCK) break;   // kernel buffer full, retry next tick
+            close();
+            return false;
+        }
+        outPos_ += (size_t)n;
+        sent_ += (uint64_t)n;
+    }
+    if (outPos_ == out_.size()) { out_.clear(); outPos_ = 0; }
+    return true;
+}
+
+bool Conn::poll() {
+    if (!valid()) return false;
+    char buf[16384];
+    for (;;) {
+        int n = ::recv(sock(s_), buf, (int)sizeof(buf), 0);
+        if (n > 0) { in_.insert(in_.end(), buf, buf + n); continue; }
+        if (n == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) return true;
+        close();   // 0 = orderly shutdown, otherwise an error
+        return false;
+    }
+}
+
+bool Conn::nextFrame(std::vector<uint8_t>& out) {
+    size_t avail = in_.size() - inPos_;
+    if (avail < 4) return false;
+    const uint8_t* h = in_.data() + inPos_;
+    uint32_t n = (uint32_t)h[0] | ((uint32_t)h[1] << 8) | ((uint32_t)h[2] << 16) | ((uint32_t)h[3] << 24);
+    if (n > MAX_FRAME) { close(); return false; }
+    if (avail < 4 + (size_t)n) return false;
+    out.assign(h + 4, h + 4 + n);
+    inPos_ += 4 + (size_t)n;
+
+    // Drop consumed bytes once they dominate the buffer.
+    if (inPos_ * 2 >= in_.size()) {
+        in_.erase(in_.begin(), in_.begin() + inPos_);
+        inPos_ = 0;
+    }
+    return true;
+}
+
+// ---------------- Listener ----------------
+Listener::~Listener() {
+    if (s_ != ~(uintptr_t)0) closesocket(sock(s_));
+}
+
+bool Listener::listen(uint16_t port, std::string& err) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) { err = "socket() failed"; return false; }
+
+    sockaddr_in a = loopback(port);
+    if (bind(s, (const sockaddr*)&a, sizeof(a)) == SOCKET_ERROR) {
+        err = "cannot bind 127.0.0.1:" + std::to_string(port);
+        closesocket(s);
+        return false;
+    }
+    if (::listen(s, SOMAXCONN) == SOCKET_ERROR) {
+        err = "listen() failed";
+        closesocket(s);
+        return false;
+    }
+    setNonBlocking(s);
+    s_ = (uintptr_t)s;
+    return true;
+}
+
+Conn Listener::accept() {
+    SOCKET c = ::accept(sock(s_), nullptr, nullptr);
+    if (c == INVALID_SOCKET) return Conn{};
+    return Conn((uintptr_t)c);
+}
+
+// ---------------- connect ----------------
+Conn connect(uint16_t port, std::string& err) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) { err = "socket() failed"; return Conn{}; }
+
+    sockaddr_in a = loopback(port);
+    if (::connect(s, (const sockaddr*)&a, sizeof(a)) == SOCKET_ERROR) {
+        err = "cannot connect to 127.0.0.1:" + std::to_string(port);
+        closesocket(s);
+        return Conn{};
+    }
+    return Conn((uintptr_t)s);
+}
+
+} // namespace net
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Loopback TCP transport for server mode.
+//
+// Frames are a u32 little-endian payload length followed by the payload.
+// Sockets are non-blocking: send() only queues, flush() writes what the
+// kernel accepts, poll() reads what is available. Payloads are built with
+// Writer and parsed with Reader (varints, zigzag for signed values).
+
+namespace net {
+
+static const uint16_t DEFAULT_PORT = 47474;
+
+struct Writer {
+    std::vector<uint8_t> buf;
+
+    void u8(uint8_t v) { buf.push_back(v); }
+    void varint(uint64_t v) {
+        while (v >= 0x80) { buf.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+        buf.push_back((uint8_t)v);
+    }
+    void svarint(int64_t v) { varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); }
+    void wstr(const std::wstring& s) {
+        varint(s.size());
+        for (wchar_t c : s) varint((uint32_t)c);
+    }
+    void bytes(const std::vector<uint8_t>& b) { buf.insert(buf.end(), b.begin(), b.end()); }
+};
+
+struct Reader {
+    const uint8_t* p = nullptr;
+    const uint8_t* end = nullptr;
+    bool ok = true;
+
+    Reader(const std::vector<uint8_t>& b) : p(b.data()), end(b.data() + b.size()) {}
+
+    bool done() const { return p >= end; }
+    uint8_t u8() {
+        if (p >= end) { ok = false; return 0; }
+        return *p++;
+    }
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64 && ok; shift += 7) {
+            uint8_t c = u8();
+            v |= (uint64_t)(c & 0x7F) << shift;
+            if (!(c & 0x80)) break;
+        }
+        return v;
+    }
+    int64_t svarint() { uint64_t v = varint(); return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+    std::wstring wstr() {
+        size_t n = (size_t)varint();
+        if (n > (size_t)(end - p)) { ok = false; return {}; }   // each char is >= 1 byte
+        std::wstring s(n, L' ');
+        for (auto& c : s) c = (wchar_t)varint();
+        return s;
+    }
+};
+
+bool startup();      // once per process
+void shutdown();
+
+// One connected peer.
+class Conn {
+public:
+    Conn() = default;
+    explicit Conn(uintptr_t s);
+    ~Conn();
+    Conn(const Conn&) = delete;
+    Conn& operator=(const Conn&) = delete;
+    Conn(Conn&& o) noexcept;
+    Conn& operator=(Conn&& o) noexcept;
+
+    bool valid() const { return s_ != INVALID; }
+    void close();
+
+    void send(const std::vector<uint8_t>& payload);   // queues one frame
+    bool flush();                                     // false once the peer is gone
+    bool poll();                                      // false once the peer is gone
+    bool nextFrame(std::vector<uint8_t>& out);        // one complete received frame
+
+    uint64_t bytesSent() const { return sent_; }
+    size_t pendingOut() const { return out_.size() - outPos_; }
+
+private:
+    static const uintptr_t INVALID = ~(uintptr_t)0;
+    uintptr_t s_ = INVALID;
+    std::vector<uint8_t> in_, out_;
+    size_t inPos_ = 0, outPos_ = 0;
+    uint64_t sent_ = 0;
+};
+
+// Listening socket bound to 127.0.0.1 only.
+class Listener {
+public:
+    Listener() = default;
+    ~Listener();
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    bool listen(uint16_t port, std::string& err);
+    Conn accept();                                    // invalid Conn if none pending
+
+private:
+    uintptr_t s_ = ~(uintptr_t)0;
+};
+
+// Blocking connect to 127.0.0.1:port; the returned Conn is non-blocking.
+Conn connect(uint16_t port, std::string& err);
+
+} // namespace net
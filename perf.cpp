@@ -0,0 +1,253 @@
+#include "perf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+namespace perf {
+
+namespace {
+// One cache line per tag: tags are hit from different threads.
+struct alignas(64) TagCounters {
+    std::atomic<uint64_t> allocs{ 0 }, bytes{ 0 }, frees{ 0 };
+    std::atomic<int64_t> live{ 0 }, peak{ 0 }, framePeak{ 0 };
+};
+TagCounters gTags[ALLOC_TAGS];
+AllocCounters gFrameBase[ALLOC_TAGS];     // main thread, see beginAllocFrame
+thread_local AllocTag tCurrent = AllocTag::Other;
+
+const char* const TAG_NAME[] = { "other", "init", "input", "render", "missions", "market", "log" };
+static_assert(sizeof(TAG_NAME) / sizeof(TAG_NAME[0]) == ALLOC_TAGS, "one name per AllocTag");
+
+// Every lookup by tag goes through here: anything out of range counts as Other.
+int tagIndex(AllocTag t) { return (unsigned)t < (unsigned)ALLOC_TAGS ? (int)t : (int)AllocTag::Other; }
+TagCounters& counters(AllocTag t) { return gTags[tagIndex(t)]; }
+
+void raise(std::atomic<int64_t>& a, int64_t v) {
+    int64_t cur = a.load(std::memory_order_relaxed);
+    while (cur < v && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+}
+
+double nowMs() {
+    using namespace std::chrono;
+    static const steady_clock::time_point epoch = steady_clock::now();
+    return duration<double, std::milli>(steady_clock::now() - epoch).count();
+}
+
+uint64_t allocCount() {
+    uint64_t n = 0;
+    for (const TagCounters& t : gTags) n += t.allocs.load(std::memory_order_relaxed);
+    return n;
+}
+uint64_t allocBytes() {
+    uint64_t n = 0;
+    for (const TagCounters& t : gTags) n += t.bytes.load(std::memory_order_relaxed);
+    return n;
+}
+
+const char* allocTagName(AllocTag t) { return (unsigned)t < (unsigned)ALLOC_TAGS ? TAG_NAME[(int)t] : "?"; }
+
+AllocCounters allocCounters(AllocTag t) {
+    const TagCounters& c = counters(t);
+    AllocCounters out;
+    out.allocs = c.allocs.load(std::memory_order_relaxed);
+    out.bytes = c.bytes.load(std::memory_order_relaxed);
+    out.frees = c.frees.load(std::memory_order_relaxed);
+    out.live = c.live.load(std::memory_order_relaxed);
+    out.peak = c.peak.load(std::memory_order_relaxed);
+    return out;
+}
+
+void beginAllocFrame() {
+    for (int t = 0; t < ALLOC_TAGS; t++) {
+        gFrameBase[t] = allocCounters((AllocTag)t);
+        gTags[t].framePeak.store(gFrameBase[t].live, std::memory_order_relaxed);
+    }
+}
+
+AllocCounters frameAllocCounters(AllocTag t) {
+    AllocCounters now = allocCounters(t);
+    const AllocCounters& base = gFrameBase[tagIndex(t)];
+    now.allocs -= base.allocs;
+    now.bytes -= base.bytes;
+    now.frees -= base.frees;
+    now.peak = counters(t).framePeak.load(std::memory_order_relaxed);
+    return now;
+}
+
+AllocScope::AllocScope(AllocTag t) : prev_(tCurrent) { tCurrent = (AllocTag)tagIndex(t); }
+AllocScope::~AllocScope() { tCurrent = prev_; }
+
+void FrameStats::add(const FrameSample& s) {
+    last_ = s;
+    frames_++;
+    sumFrameMs_ += s.frameMs;
+    maxFrameMs_ = std::max(maxFrameMs_, s.frameMs);
+    for (int t = 0; t < ALLOC_TAGS; t++) {
+        AllocTotals& a = alloc_[t];
+        a.allocs += s.alloc[t].allocs;
+        a.bytes += s.alloc[t].bytes;
+        a.maxAllocs = std::max(a.maxAllocs, s.alloc[t].allocs);
+        a.maxBytes = std::max(a.maxBytes, s.alloc[t].bytes);
+        a.maxPeak = std::max(a.maxPeak, s.alloc[t].peak);
+    }
+}
+
+bool writeAllocReport(const std::string& path, const FrameStats& frames) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "tag,allocs,bytes,frees,live_bytes,peak_live_bytes,"
+                    "frames,frame_allocs_avg,frame_allocs_max,frame_bytes_max,frame_peak_live_max\n");
+    uint64_t n = frames.frames();
+    for (int t = 0; t < ALLOC_TAGS; t++) {
+        AllocCounters c = allocCounters((AllocTag)t);
+        const FrameStats::AllocTotals& a = frames.allocTotals((AllocTag)t);
+        std::fprintf(f, "%s,%llu,%llu,%llu,%lld,%lld,%llu,%.1f,%llu,%llu,%lld\n", TAG_NAME[t],
+                     (unsigned long long)c.allocs, (unsigned long long)c.bytes, (unsigned long long)c.frees,
+                     (long long)c.live, (long long)c.peak, (unsigned long long)n,
+                     n ? (double)a.allocs / (double)n : 0.0, (unsigned long long)a.maxAllocs,
+                     (unsigned long long)a.maxBytes, (long long)a.maxPeak);
+    }
+    return std::fclose(f) == 0;
+}
+
+} // namespace perf
+
+// ---------------- Global allocation hooks ----------------
+// Blocks are plain malloc blocks, so a block that another module's
+// operator new/delete allocated or frees (a shared libstdc++, say) is still
+// handled right. Size and tag are kept in a side table keyed by address,
+// split into shards that each sit behind a spin lock. The table grows with
+// malloc, never operator new. A delete of a block the table never saw just
+// frees it. If an address comes back while the table still holds it, the
+// old block was freed elsewhere, and it is uncounted then.
+namespace {
+struct Block {
+    uintptr_t addr;              // 0 = empty slot
+    std::size_t size;
+    perf::AllocTag tag;
+};
+
+struct alignas(64) Shard {
+    std::atomic<bool> busy{ false };
+    Block* slots = nullptr;
+    std::size_t cap = 0, used = 0;   // cap is 0 or a power of 2, at most half full
+
+    void lock() {
+        for (int spins = 0; busy.exchange(true, std::memory_order_acquire); spins++)
+            if (spins >= 64) std::this_thread::yield();   // the holder may be descheduled
+    }
+    void unlock() { busy.store(false, std::memory_order_release); }
+};
+
+constexpr int SHARD_BITS = 6;
+Shard gShards[1 << SHARD_BITS];
+
+uint64_t hashAddr(uintptr_t a) { return (uint64_t)a * 0x9E3779B97F4A7C15ull; }
+Shard& shardOf(uintptr_t a) { return gShards[hashAddr(a) >> (64 - SHARD_BITS)]; }
+std::size_t homeOf(uintptr_t a, std::size_t cap) { return (std::size_t)(hashAddr(a) >> 16) & (cap - 1); }
+
+bool grow(Shard& sh) {
+    std::size_t cap = sh.cap ? sh.cap * 2 : 256;
+    Block* slots = (Block*)std::calloc(cap, sizeof(Block));
+    if (!slots) return false;
+    for (std::size_t i = 0; i < sh.cap; i++) {
+        if (!sh.slots[i].addr) continue;
+        std::size_t j = homeOf(sh.slots[i].addr, cap);
+        while (slots[j].addr) j = (j + 1) & (cap - 1);
+        slots[j] = sh.slots[i];
+    }
+    std::free(sh.slots);
+    sh.slots = slots;
+    sh.cap = cap;
+    return true;
+}
+
+// Records `b`; a stale entry at the same address comes back in `old`.
+bool remember(const Block& b, Block& old) {
+    Shard& sh = shardOf(b.addr);
+    sh.lock();
+    if ((sh.used + 1) * 2 > sh.cap && !grow(sh)) { sh.unlock(); return false; }
+    std::size_t i = homeOf(b.addr, sh.cap);
+    while (sh.slots[i].addr && sh.slots[i].addr != b.addr) i = (i + 1) & (sh.cap - 1);
+    old = sh.slots[i];
+    if (!old.addr) sh.used++;
+    sh.slots[i] = b;
+    sh.unlock();
+    return true;
+}
+
+// Takes the entry for `addr` out of the table (linear probing, so the run
+// after it shifts back over the hole).
+bool forget(uintptr_t addr, Block& out) {
+    Shard& sh = shardOf(addr);
+    sh.lock();
+    if (!sh.cap) { sh.unlock(); return false; }
+    std::size_t m = sh.cap - 1, i = homeOf(addr, sh.cap);
+    while (sh.slots[i].addr != addr) {
+        if (!sh.slots[i].addr) { sh.unlock(); return false; }
+        i = (i + 1) & m;
+    }
+    out = sh.slots[i];
+    for (std::size_t j = (i + 1) & m; sh.slots[j].addr; j = (j + 1) & m) {
+        std::size_t k = homeOf(sh.slots[j].addr, sh.cap);
+        if (((j - k) & m) >= ((j - i) & m)) { sh.slots[i] = sh.slots[j]; i = j; }
+    }
+    sh.slots[i].addr = 0;
+    sh.used--;
+    sh.unlock();
+    return true;
+}
+
+void uncount(const Block& b) {
+    perf::TagCounters& c = perf::counters(b.tag);
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    c.live.fetch_sub((int64_t)b.size, std::memory_order_relaxed);
+}
+}
+
+static void* countedAlloc(std::size_t n) {
+    void* p = std::malloc(n ? n : 1);
+    if (!p) return nullptr;
+    Block b{ (uintptr_t)p, n, perf::tCurrent }, old;
+    if (!remember(b, old)) return p;    // table full: this block goes uncounted
+    if (old.addr) uncount(old);
+
+    perf::TagCounters& c = perf::counters(b.tag);
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(n, std::memory_order_relaxed);
+    int64_t live = c.live.fetch_add((int64_t)n, std::memory_order_relaxed) + (int64_t)n;
+    perf::raise(c.peak, live);
+    perf::raise(c.framePeak, live);
+    return p;
+}
+
+static void countedFree(void* p) {
+    if (!p) return;
+    Block b;
+    if (forget((uintptr_t)p, b)) uncount(b);
+    std::free(p);
+}
+
+void* operator new(std::size_t n) {
+    if (void* p = countedAlloc(n)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) {
+    if (void* p = countedAlloc(n)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return countedAlloc(n); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return countedAlloc(n); }
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { countedFree(p); }
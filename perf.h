@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Live performance counters for the in-game overlay (F3).
+//
+// Frame timing is fed by the main loop; allocation counts come from the
+// replaceable global operator new/delete in perf.cpp.
+//
+// Allocations are tracked by subsystem tag. ALLOC_SCOPE(Render) charges
+// every operator new on this thread to Render until the scope exits (the
+// innermost scope wins; outside any scope it is Other). A side table keyed
+// by block address keeps each block's size and tag, so a delete is charged
+// to the tag that allocated it, on whatever thread, and live bytes per tag
+// stay exact. Blocks themselves are plain malloc blocks, so memory crossing
+// into or out of another module's operator new/delete stays safe.
+// Cost per call: a thread-local read, a short spin lock on one of 64 table
+// shards, a hash probe and a few relaxed atomics.
+
+namespace perf {
+
+double nowMs();
+
+uint64_t allocCount();   // operator new calls since start
+uint64_t allocBytes();   // bytes requested since start
+
+enum class AllocTag : uint8_t { Other, Init, Input, Render, Missions, Market, Log, COUNT };
+constexpr int ALLOC_TAGS = (int)AllocTag::COUNT;
+
+const char* allocTagName(AllocTag t);
+
+struct AllocCounters {
+    uint64_t allocs = 0;     // operator new calls
+    uint64_t bytes = 0;      // bytes requested
+    uint64_t frees = 0;
+    int64_t live = 0;        // bytes allocated and not freed yet
+    int64_t peak = 0;        // highest live
+};
+
+// Since start. live/peak count blocks of this tag freed anywhere.
+AllocCounters allocCounters(AllocTag t);
+
+// Frame window, main thread: allocs/bytes/frees since beginAllocFrame(),
+// live now and the peak live inside the window.
+void beginAllocFrame();
+AllocCounters frameAllocCounters(AllocTag t);
+
+class AllocScope {
+public:
+    explicit AllocScope(AllocTag t);
+    ~AllocScope();
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+private:
+    AllocTag prev_;
+};
+
+struct FrameSample {
+    double frameMs = 0;      // renderAll wall time
+    double latencyMs = 0;    // input returned -> frame presented
+    uint32_t gotoXY = 0;      // Canvas calls by kind
+    uint32_t setAttr = 0;
+    uint32_t writeW = 0;
+    uint32_t fill = 0;
+    uint32_t scroll = 0;
+    uint64_t chars = 0;
+    uint64_t allocs = 0;     // allocations since the previous frame was presented
+    AllocCounters alloc[ALLOC_TAGS];   // the same frame, by tag
+};
+
+class FrameStats {
+public:
+    // Per-tag allocation figures over all frames added.
+    struct AllocTotals {
+        uint64_t allocs = 0, bytes = 0;
+        uint64_t maxAllocs = 0, maxBytes = 0;   // worst single frame
+        int64_t maxPeak = 0;                    // highest in-frame peak live
+    };
+
+    void add(const FrameSample& s);
+
+    const FrameSample& last() const { return last_; }
+    double avgFrameMs() const { return frames_ ? sumFrameMs_ / frames_ : 0.0; }
+    double maxFrameMs() const { return maxFrameMs_; }
+    uint64_t frames() const { return frames_; }
+    const AllocTotals& allocTotals(AllocTag t) const { return alloc_[(int)t]; }
+
+private:
+    FrameSample last_;
+    uint64_t frames_ = 0;
+    double sumFrameMs_ = 0;
+    double maxFrameMs_ = 0;
+    AllocTotals alloc_[ALLOC_TAGS];
+};
+
+// Per tag: session counters plus the per-frame figures of `frames`, as CSV.
+bool writeAllocReport(const std::string& path, const FrameStats& frames);
+
+} // namespace perf
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+#define ALLOC_SCOPE(tag) ::perf::AllocScope PERF_CONCAT(allocScope_, __LINE__)(::perf::AllocTag::tag)
@@ -0,0 +1,118 @@
+#include "replay.h"
+
+#include <algorithm>
+
+namespace replay {
+
+static const char MAGIC[4] = { 'S', 'T', 'R', 'P' };
+static const uint8_t VERSION = 1;
+static const uint8_t END_MARKER = 0xFF;
+
+static void put16(FILE* f, uint16_t v) { std::fputc(v & 0xFF, f); std::fputc(v >> 8, f); }
+
+Recorder::~Recorder() {
+    if (f_) std::fclose(f_);
+}
+
+bool Recorder::open(const std::string& path, const Header& h) {
+    f_ = std::fopen(path.c_str(), "wb");
+    if (!f_) return false;
+    std::fwrite(MAGIC, 1, 4, f_);
+    std::fputc(VERSION, f_);
+    for (int i = 0; i < 4; i++) std::fputc((h.seed >> (8 * i)) & 0xFF, f_);
+    put16(f_, (uint16_t)h.w);
+    put16(f_, (uint16_t)h.h);
+    lastMs_ = 0;
+    return true;
+}
+
+void Recorder::putVarint(uint32_t v) {
+    while (v >= 0x80) { std::fputc((int)(v & 0x7F) | 0x80, f_); v >>= 7; }
+    std::fputc((int)v, f_);
+}
+
+void Recorder::add(uint32_t tMs, const termui::Action& a, termui::Size size) {
+    if (!f_) return;
+    putVarint(tMs >= lastMs_ ? tMs - lastMs_ : 0);
+    lastMs_ = std::max(lastMs_, tMs);
+    std::fputc((int)a.type, f_);
+    std::fputc((int)(int8_t)a.dx & 0xFF, f_);
+    std::fputc((int)(int8_t)a.dy & 0xFF, f_);
+    if (a.type == termui::ActionType::Resize) {
+        put16(f_, (uint16_t)size.w);
+        put16(f_, (uint16_t)size.h);
+    }
+}
+
+void Recorder::flush() {
+    if (f_) std::fflush(f_);
+}
+
+void Recorder::finish(uint64_t digest) {
+    if (!f_) return;
+    putVarint(0);
+    std::fputc(END_MARKER, f_);
+    for (int i = 0; i < 8; i++) std::fputc((int)((digest >> (8 * i)) & 0xFF), f_);
+    std::fclose(f_);
+    f_ = nullptr;
+}
+
+namespace {
+struct Reader {
+    FILE* f;
+    bool ok = true;
+    int byte() { int c = std::fgetc(f); if (c == EOF) ok = false; return c & 0xFF; }
+    uint16_t u16() { int lo = byte(); return (uint16_t)(lo | (byte() << 8)); }
+    uint32_t varint() {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35 && ok; shift += 7) {
+            int c = byte();
+            v |= (uint32_t)(c & 0x7F) << shift;
+            if (!(c & 0x80)) break;
+        }
+        return v;
+    }
+};
+}
+
+bool load(const std::string& path, Recording& out, std::string& err) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) { err = "cannot open " + path; return false; }
+    Reader r{ f };
+
+    char magic[4]{};
+    for (char& c : magic) c = (char)r.byte();
+    if (!r.ok || std::equal(magic, magic + 4, MAGIC) == false) { std::fclose(f); err = "not a replay file"; return false; }
+    if (r.byte() != VERSION) { std::fclose(f); err = "unsupported replay version"; return false; }
+
+    out = Recording{};
+    for (int i = 0; i < 4; i++) out.header.seed |= (uint32_t)r.byte() << (8 * i);
+    out.header.w = r.u16();
+    out.header.h = r.u16();
+
+    uint32_t t = 0;
+    while (true) {
+        uint32_t dt = r.varint();
+        int type = r.byte();
+        if (!r.ok) break;                       // truncated (game crashed): keep what we have
+        if (type == END_MARKER) {
+            uint64_t d = 0;
+            for (int i = 0; i < 8; i++) d |= (uint64_t)r.byte() << (8 * i);
+            if (r.ok) { out.hasDigest = true; out.digest = d; }
+            break;
+        }
+        t += dt;
+        Entry e;
+        e.tMs = t;
+        e.action.type = (termui::ActionType)type;
+        e.action.dx = (int8_t)r.byte();
+        e.action.dy = (int8_t)r.byte();
+        if (e.action.type == termui::ActionType::Resize) { e.w = r.u16(); e.h = r.u16(); }
+        if (!r.ok) break;
+        out.entries.push_back(e);
+    }
+    std::fclose(f);
+    return true;
+}
+
+} // namespace replay
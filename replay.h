@@ -0,0 +1,61 @@
+#pragma once
+#include "termui.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Input recordings for deterministic replays.
+//
+// File layout (little endian):
+//   "STRP" u8 version  u32 seed  u16 width  u16 height
+//   entries:  varint dtMs  u8 type  i8 dx  i8 dy  [u16 w  u16 h  if Resize]
+//   trailer:  varint 0  u8 0xFF  u64 final state digest
+// dtMs is the time since the previous entry, so an idle session costs a few
+// bytes per keypress.
+
+namespace replay {
+
+struct Header {
+    uint32_t seed = 0;
+    int w = 0, h = 0;
+};
+
+struct Entry {
+    uint32_t tMs = 0;             // since start of recording
+    termui::Action action;
+    int w = 0, h = 0;             // window size, Resize only
+};
+
+struct Recording {
+    Header header;
+    std::vector<Entry> entries;
+    bool hasDigest = false;
+    uint64_t digest = 0;
+};
+
+class Recorder {
+public:
+    Recorder() = default;
+    ~Recorder();
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    bool open(const std::string& path, const Header& h);
+    bool isOpen() const { return f_ != nullptr; }
+
+    void add(uint32_t tMs, const termui::Action& a, termui::Size size);
+    void flush();                     // on disk so far; a crash keeps the rest loadable
+    void finish(uint64_t digest);
+
+private:
+    void putVarint(uint32_t v);
+
+    FILE* f_ = nullptr;
+    uint32_t lastMs_ = 0;
+};
+
+bool load(const std::string& path, Recording& out, std::string& err);
+
+} // namespace replay
@@ -0,0 +1,102 @@
+#include "rng.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RNG_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RNG_SSE2 1
+#endif
+
+namespace rng {
+
+#if RNG_AVX2
+
+static inline __m256i hash32x8(__m256i x) {
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x7feb352dU));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x846ca68bU));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    return x;
+}
+
+void hash32Batch(const uint32_t* in, uint32_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+        _mm256_storeu_si256((__m256i*)(out + i), hash32x8(v));
+    }
+    for (; i < n; i++) out[i] = hash32(in[i]);
+}
+
+void hash32Counter(uint32_t base, uint32_t* out, size_t n) {
+    size_t i = 0;
+    __m256i ctr = _mm256_add_epi32(_mm256_set1_epi32((int)base), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i step = _mm256_set1_epi32(8);
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i*)(out + i), hash32x8(ctr));
+        ctr = _mm256_add_epi32(ctr, step);
+    }
+    for (; i < n; i++) out[i] = hash32(base + (uint32_t)i);
+}
+
+const char* simdPath() { return "avx2"; }
+
+#elif RNG_SSE2
+
+// SSE2 has no 32-bit low multiply; do even and odd lanes with
+// _mm_mul_epu32 and interleave the low halves back together.
+static inline __m128i mullo32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i hash32x4(__m128i x) {
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = mullo32(x, _mm_set1_epi32((int)0x7feb352dU));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+    x = mullo32(x, _mm_set1_epi32((int)0x846ca68bU));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    return x;
+}
+
+void hash32Batch(const uint32_t* in, uint32_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        _mm_storeu_si128((__m128i*)(out + i), hash32x4(v));
+    }
+    for (; i < n; i++) out[i] = hash32(in[i]);
+}
+
+void hash32Counter(uint32_t base, uint32_t* out, size_t n) {
+    size_t i = 0;
+    __m128i ctr = _mm_add_epi32(_mm_set1_epi32((int)base), _mm_setr_epi32(0, 1, 2, 3));
+    const __m128i step = _mm_set1_epi32(4);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i*)(out + i), hash32x4(ctr));
+        ctr = _mm_add_epi32(ctr, step);
+    }
+    for (; i < n; i++) out[i] = hash32(base + (uint32_t)i);
+}
+
+const char* simdPath() { return "sse2"; }
+
+#else
+
+void hash32Batch(const uint32_t* in, uint32_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = hash32(in[i]);
+}
+
+void hash32Counter(uint32_t base, uint32_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = hash32(base + (uint32_t)i);
+}
+
+const char* simdPath() { return "scalar"; }
+
+#endif
+
+} // namespace rng
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Integer hash used for all procedural generation, plus batched versions.
+//
+// The batch entry points compute exactly hash32() per element (bit-identical,
+// so existing seeds keep producing the same worlds) using AVX2 (8 lanes) or
+// SSE2 (4 lanes) when the compiler targets them, with a scalar tail.
+
+namespace rng {
+
+inline uint32_t hash32(uint32_t x) {
+    x ^= x >> 16; x *= 0x7feb352dU;
+    x ^= x >> 15; x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// out[i] = hash32(in[i]); `out` may alias `in` (advances n chains one step).
+void hash32Batch(const uint32_t* in, uint32_t* out, size_t n);
+
+// out[i] = hash32(base + i)  (counter mode)
+void hash32Counter(uint32_t base, uint32_t* out, size_t n);
+
+// "avx2", "sse2" or "scalar"
+const char* simdPath();
+
+} // namespace rng
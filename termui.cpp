@@ -1,6 +1,9 @@
 #define WIN32_LEAN_AND_MEAN
 #include "termui.h"
+#include "trace.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 
 namespace termui {
 
@@ -42,9 +45,13 @@ Size Canvas::windowSize() const {
     return { w, h };
 }
 
-void Canvas::setAttr(WORD fg) { SetConsoleTextAttribute(hOut_, fg); }
+void Canvas::setAttr(WORD fg) {
+    stats_.setAttr++;
+    SetConsoleTextAttribute(hOut_, fg);
+}
 
 void Canvas::gotoXY(short x, short y) {
+    stats_.gotoXY++;
     COORD c{ x, y };
     SetConsoleCursorPosition(hOut_, c);
 }
@@ -56,14 +63,32 @@ void Canvas::clearRect(int x, int y, int w, int h, WORD attr) {
         FillConsoleOutputCharacterW(hOut_, L' ', w, pos, &written);
         FillConsoleOutputAttribute(hOut_, attr, w, pos, &written);
     }
+    if (h > 0 && w > 0) {
+        stats_.fill += 2u * (uint32_t)h;
+        stats_.chars += (uint64_t)w * (uint64_t)h;
+    }
 }
 
 void Canvas::clearAll(WORD attr) {
     auto s = windowSize();
     clearRect(0, 0, s.w, s.h, attr);
+    clears_++;
+}
+
+void Canvas::scroll(const Rect& r, int dx, int dy, WORD attr) {
+    if (r.w <= 0 || r.h <= 0 || (dx == 0 && dy == 0)) return;
+    SMALL_RECT clip{ (SHORT)r.x, (SHORT)r.y, (SHORT)(r.x + r.w - 1), (SHORT)(r.y + r.h - 1) };
+    COORD dest{ (SHORT)(r.x + dx), (SHORT)(r.y + dy) };
+    CHAR_INFO fill{};
+    fill.Char.UnicodeChar = L' ';
+    fill.Attributes = attr;
+    stats_.scroll++;
+    ScrollConsoleScreenBufferW(hOut_, &clip, &clip, dest, &fill);
 }
 
 void Canvas::writeW(const std::wstring& s) {
+    stats_.writeW++;
+    stats_.chars += s.size();
     DWORD written = 0;
     WriteConsoleW(hOut_, s.c_str(), (DWORD)s.size(), &written, nullptr);
 }
@@ -109,12 +134,11 @@ void Canvas::clearInside(const Rect& r, WORD attr) {
     clearRect(r.x + 1, r.y + 1, r.w - 2, r.h - 2, attr);
 }
 
-Layout computeLayout(int W, int H) {
+Layout computeLayout(int W, int H, int hudH) {
     Layout L{};
     W = std::max(W, 70);
     H = std::max(H, 22);
 
-    int hudH = 3;
     int logH = 7;
     logH = std::min(logH, H - hudH - 6);
 
@@ -133,47 +157,178 @@ Layout computeLayout(int W, int H) {
 
 Input::Input(HANDLE hIn) : hIn_(hIn) {}
 
+// The action one console record stands for; None for records that are not
+// (key releases, focus and mouse events, unbound keys).
+static Action translate(const INPUT_RECORD& ir, bool text) {
+    if (ir.EventType == WINDOW_BUFFER_SIZE_EVENT) {
+        return { ActionType::Resize, 0, 0 };
+    }
+    if (ir.EventType == KEY_EVENT && ir.Event.KeyEvent.bKeyDown && text) {
+        WORD vk = ir.Event.KeyEvent.wVirtualKeyCode;
+        wchar_t ch = ir.Event.KeyEvent.uChar.UnicodeChar;
+        if (vk == VK_ESCAPE) return { ActionType::Text, 27, 0 };
+        if (vk == VK_RETURN) return { ActionType::Text, '\r', 0 };
+        if (vk == VK_BACK)   return { ActionType::Text, '\b', 0 };
+        if (ch >= 32 && ch < 127) return { ActionType::Text, (int)ch, 0 };
+        return { ActionType::None, 0, 0 };
+    }
+    if (ir.EventType == KEY_EVENT && ir.Event.KeyEvent.bKeyDown) {
+        WORD vk = ir.Event.KeyEvent.wVirtualKeyCode;
+
+        switch (vk) {
+            case VK_ESCAPE: return { ActionType::Quit, 0, 0 };
+            case VK_RETURN: return { ActionType::Confirm, 0, 0 };
+            case VK_SPACE:  return { ActionType::Select, 0, 0 };
+            case VK_BACK:   return { ActionType::Back, 0, 0 };
+            case VK_TAB:
+                if (ir.Event.KeyEvent.dwControlKeyState & SHIFT_PRESSED)
+                    return { ActionType::TabLeft, 0, 0 };
+                else
+                    return { ActionType::TabRight, 0, 0 };
+            case VK_LEFT:   return { ActionType::Move, -1, 0 };
+            case VK_RIGHT:  return { ActionType::Move, +1, 0 };
+            case VK_UP:     return { ActionType::Move, 0, -1 };
+            case VK_DOWN:   return { ActionType::Move, 0, +1 };
+            case VK_F3:     return { ActionType::PerfOverlay, 0, 0 };
+            case VK_F12:    return { ActionType::TraceDump, 0, 0 };
+            case VK_PRIOR:  return { ActionType::LogScroll, 0, -1 };
+            case VK_NEXT:   return { ActionType::LogScroll, 0, +1 };
+            case VK_HOME:   return { ActionType::LogScroll, -1, 0 };
+            case VK_END:    return { ActionType::LogScroll, +1, 0 };
+            default: break;
+        }
+
+        wchar_t ch = ir.Event.KeyEvent.uChar.UnicodeChar;
+        if (ch == L'a' || ch == L'A') return { ActionType::Move, -1, 0 };
+        if (ch == L'd' || ch == L'D') return { ActionType::Move, +1, 0 };
+        if (ch == L'w' || ch == L'W') return { ActionType::Move, 0, -1 };
+        if (ch == L's' || ch == L'S') return { ActionType::Move, 0, +1 };
+
+        if (ch == L'q' || ch == L'Q') return { ActionType::Back, 0, 0 };
+        if (ch == L'l' || ch == L'L') return { ActionType::ClearLog, 0, 0 };
+        if (ch == L'e' || ch == L'E') return { ActionType::SidebarToggle, 0, 0 };
+        if (ch == L'n' || ch == L'N') return { ActionType::No, 0, 0 };
+        if (ch == L'm' || ch == L'M') return { ActionType::TradeMax, 0, 0 };
+        if (ch == L'f' || ch == L'F') return { ActionType::TradeFill, 0, 0 };
+        if (ch >= L'1' && ch <= L'9') return { ActionType::TradeUnits, ch - L'0', 0 };
+        if (ch == L'0') return { ActionType::TradeUnits, 10, 0 };
+        if (ch == L'+' || ch == L'=') return { ActionType::ZoomIn, 0, 0 };
+        if (ch == L'-' || ch == L'_') return { ActionType::ZoomOut, 0, 0 };
+        if (ch == L'o' || ch == L'O') return { ActionType::FleetOrder, 0, 0 };
+        if (ch == L'r' || ch == L'R') return { ActionType::PlotRoute, 0, 0 };
+        if (ch == L'b' || ch == L'B') return { ActionType::BuyShip, 0, 0 };
+        if (ch == L'z' || ch == L'Z') return { ActionType::Wait, 1, 0 };
+        if (ch == L'x' || ch == L'X') return { ActionType::Wait, 0, 0 };
+        if (ch == L'k' || ch == L'K') return { ActionType::LogKind, 0, 0 };
+        if (ch == L'/') return { ActionType::LogSearch, 0, 0 };
+    }
+    return { ActionType::None, 0, 0 };
+}
+
 Action Input::readActionBlocking() {
+    TRACE_SCOPE("readActionBlocking");
     INPUT_RECORD ir{};
     DWORD read = 0;
 
     while (ReadConsoleInputW(hIn_, &ir, 1, &read) && read == 1) {
-        if (ir.EventType == WINDOW_BUFFER_SIZE_EVENT) {
-            return { ActionType::Resize, 0, 0 };
+        Action a = translate(ir, text_);
+        if (a.type != ActionType::None) return a;
+    }
+    return { ActionType::None, 0, 0 };
+}
+
+bool Input::poll(Action& out) {
+    DWORD pending = 0;
+    while (GetNumberOfConsoleInputEvents(hIn_, &pending) && pending > 0) {
+        INPUT_RECORD ir{};
+        DWORD read = 0;
+        if (!ReadConsoleInputW(hIn_, &ir, 1, &read) || read != 1) return false;
+        out = translate(ir, text_);
+        if (out.type != ActionType::None) return true;
+    }
+    return false;
+}
+
+// ---------------- EventLoop ----------------
+static double loopNowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+EventLoop::EventLoop(Input& in) : in_(in), wake_(CreateEventW(nullptr, FALSE, FALSE, nullptr)) {}
+
+EventLoop::~EventLoop() { CloseHandle(wake_); }
+
+void EventLoop::post(Callback fn) {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        posted_.push_back(std::move(fn));
+    }
+    SetEvent(wake_);
+}
+
+int EventLoop::addTimer(int delayMs, int periodMs, Callback fn) {
+    Timer t;
+    t.id = nextTimer_++;
+    t.dueMs = loopNowMs() + std::max(0, delayMs);
+    t.periodMs = std::max(0, periodMs);
+    t.fn = std::move(fn);
+    timers_.push_back(std::move(t));
+    return timers_.back().id;
+}
+
+void EventLoop::cancelTimer(int id) {
+    timers_.erase(std::remove_if(timers_.begin(), timers_.end(), [id](const Timer& t) { return t.id == id; }),
+                  timers_.end());
+}
+
+bool EventLoop::runPosted() {
+    std::vector<Callback> run;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        run.swap(posted_);
+    }
+    for (auto& fn : run) if (fn) fn();
+    return !run.empty();
+}
+
+bool EventLoop::runTimers() {
+    double now = loopNowMs();
+    std::vector<Callback> due;
+    for (size_t i = 0; i < timers_.size();) {
+        Timer& t = timers_[i];
+        if (t.dueMs > now) { i++; continue; }
+        due.push_back(t.fn);
+        if (t.periodMs > 0) {
+            // Skip missed periods instead of firing a burst after a stall.
+            t.dueMs += t.periodMs * std::max(1.0, std::ceil((now - t.dueMs) / t.periodMs));
+            i++;
+        } else {
+            timers_.erase(timers_.begin() + i);
         }
-        if (ir.EventType == KEY_EVENT && ir.Event.KeyEvent.bKeyDown) {
-            WORD vk = ir.Event.KeyEvent.wVirtualKeyCode;
-
-            switch (vk) {
-                case VK_ESCAPE: return { ActionType::Quit, 0, 0 };
-                case VK_RETURN: return { ActionType::Confirm, 0, 0 };
-                case VK_SPACE:  return { ActionType::Select, 0, 0 };
-                case VK_BACK:   return { ActionType::Back, 0, 0 };
-                case VK_TAB:
-                    if (ir.Event.KeyEvent.dwControlKeyState & SHIFT_PRESSED)
-                        return { ActionType::TabLeft, 0, 0 };
-                    else
-                        return { ActionType::TabRight, 0, 0 };
-                case VK_LEFT:   return { ActionType::Move, -1, 0 };
-                case VK_RIGHT:  return { ActionType::Move, +1, 0 };
-                case VK_UP:     return { ActionType::Move, 0, -1 };
-                case VK_DOWN:   return { ActionType::Move, 0, +1 };
-                default: break;
-            }
-
-            wchar_t ch = ir.Event.KeyEvent.uChar.UnicodeChar;
-            if (ch == L'a' || ch == L'A') return { ActionType::Move, -1, 0 };
-            if (ch == L'd' || ch == L'D') return { ActionType::Move, +1, 0 };
-            if (ch == L'w' || ch == L'W') return { ActionType::Move, 0, -1 };
-            if (ch == L's' || ch == L'S') return { ActionType::Move, 0, +1 };
-
-            if (ch == L'q' || ch == L'Q') return { ActionType::Back, 0, 0 };
-            if (ch == L'l' || ch == L'L') return { ActionType::ClearLog, 0, 0 };
-            if (ch == L'e' || ch == L'E') return { ActionType::SidebarToggle, 0, 0 };
-            if (ch == L'n' || ch == L'N') return { ActionType::No, 0, 0 };
+    }
+    for (auto& fn : due) if (fn) fn();   // callbacks may add or cancel timers
+    return !due.empty();
+}
+
+Action EventLoop::next() {
+    for (;;) {
+        Action a;
+        if (in_.poll(a)) return a;
+        bool ran = runPosted();
+        ran |= runTimers();
+        if (ran) return { ActionType::None, 0, 0 };
+
+        DWORD timeout = INFINITE;
+        if (!timers_.empty()) {
+            double first = timers_[0].dueMs;
+            for (const Timer& t : timers_) first = std::min(first, t.dueMs);
+            timeout = (DWORD)std::max(0.0, std::ceil(first - loopNowMs()));
         }
+        HANDLE handles[2] = { in_.handle(), wake_ };
+        TRACE_SCOPE("EventLoop::wait");
+        WaitForMultipleObjects(2, handles, FALSE, timeout);
     }
-    return { ActionType::None, 0, 0 };
 }
 
 } // namespace termui
@@ -2,7 +2,11 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace termui {
 
@@ -17,6 +21,17 @@ constexpr WORD FG_RED    = FOREGROUND_RED   | FOREGROUND_INTENSITY;
 
 int clampi(int v, int lo, int hi);
 
+// Console calls issued by a Canvas since the last resetStats().
+struct CanvasStats {
+    uint32_t gotoXY = 0;
+    uint32_t setAttr = 0;
+    uint32_t writeW = 0;
+    uint32_t fill = 0;      // FillConsoleOutputCharacterW / FillConsoleOutputAttribute
+    uint32_t scroll = 0;    // ScrollConsoleScreenBufferW
+    uint64_t chars = 0;     // characters written or filled
+    uint32_t calls() const { return gotoXY + setAttr + writeW + fill + scroll; }
+};
+
 class Canvas {
 public:
     Canvas();
@@ -32,6 +47,11 @@ public:
 
     void clearRect(int x, int y, int w, int h, WORD attr = FG_WHITE);
     void clearAll(WORD attr = FG_WHITE);
+    uint32_t clearCount() const { return clears_; }   // clearAll() calls so far
+
+    // Moves the contents of `r` by (dx, dy) within `r`; cells left behind
+    // are blanked with `attr`. Nothing outside `r` changes.
+    void scroll(const Rect& r, int dx, int dy, WORD attr = FG_WHITE);
 
     void writeW(const std::wstring& s);
     void writeWAt(int x, int y, const std::wstring& s);
@@ -39,12 +59,17 @@ public:
     void drawBox(const Rect& r, const std::wstring& title = L"");
     void clearInside(const Rect& r, WORD attr = FG_WHITE);
 
+    const CanvasStats& stats() const { return stats_; }
+    void resetStats() { stats_ = {}; }
+
 private:
     HANDLE hOut_;
     HANDLE hIn_;
+    CanvasStats stats_;
+    uint32_t clears_ = 0;
 };
 
-Layout computeLayout(int W, int H);
+Layout computeLayout(int W, int H, int hudH = 3);
 
 enum class ActionType {
     None, Resize, Quit,
@@ -52,6 +77,14 @@ enum class ActionType {
     TabLeft, TabRight,
     ClearLog, Yes, No,
     SidebarToggle, PlotRoute,
+    TradeUnits, TradeMax, TradeFill, // TradeUnits: dx = quantity
+    TraceDump, PerfOverlay,
+    ZoomIn, ZoomOut,
+    FleetOrder, BuyShip,
+    Wait,                             // dx = weeks, 0 = until next event
+    LogScroll,                        // dy = -1 older / +1 newer page, dx = -1 oldest / +1 newest
+    LogKind, LogSearch,
+    Text,                             // dx = character, only while text entry is on
 };
 
 struct Action {
@@ -64,8 +97,50 @@ class Input {
 public:
     explicit Input(HANDLE hIn);
     Action readActionBlocking();
+    bool poll(Action& out);          // next pending action, without waiting
+    HANDLE handle() const { return hIn_; }
+
+    // While on, keys arrive as Text actions (printable ASCII, '\b' for
+    // Backspace, '\r' for Enter, 27 for Escape) instead of game actions.
+    void setTextEntry(bool on) { text_ = on; }
 private:
     HANDLE hIn_;
+    bool text_ = false;
+};
+
+// Waits on console input, timers and wake-ups from other threads together
+// (one WaitForMultipleObjects), so an idle game uses no CPU yet background
+// results and timer work show up without a keypress. Callbacks run on the
+// thread calling next(); only post() may be called from other threads.
+class EventLoop {
+public:
+    using Callback = std::function<void()>;
+
+    explicit EventLoop(Input& in);
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void post(Callback fn);                                 // any thread; wakes next()
+    int addTimer(int delayMs, int periodMs, Callback fn);   // periodMs 0: one-shot
+    void cancelTimer(int id);
+
+    // Returns the next input action. Posted callbacks and due timers run
+    // first; if any ran, returns ActionType::None so the caller can redraw.
+    Action next();
+
+private:
+    struct Timer { int id = 0; double dueMs = 0; int periodMs = 0; Callback fn; };
+
+    bool runPosted();
+    bool runTimers();
+
+    Input& in_;
+    HANDLE wake_;
+    std::mutex mu_;
+    std::vector<Callback> posted_;   // guarded by mu_
+    std::vector<Timer> timers_;
+    int nextTimer_ = 1;
 };
 
 } // namespace termui
@@ -0,0 +1,131 @@
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+uint64_t nowNs() {
+    using namespace std::chrono;
+    static const steady_clock::time_point epoch = steady_clock::now();
+    // +1 so a valid timestamp is never 0 (0 means "not recording" in Scope)
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now() - epoch).count() + 1;
+}
+
+#ifdef SPACETRADER_TRACE
+
+namespace {
+
+// Each slot is a small seqlock so an export can run while the owning thread
+// keeps recording: seq is odd while the slot is being written and 2 * (n + 1)
+// once it holds event n. A reader keeps an event only if seq was the same
+// even value before and after copying it.
+struct Slot {
+    std::atomic<uint64_t> seq{ 0 };
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint64_t> startNs{ 0 }, durNs{ 0 };
+};
+
+struct Ring {
+    uint32_t tid = 0;
+    std::atomic<uint64_t> head{ 0 };  // total events ever written
+    Slot slots[RING_CAPACITY];
+};
+
+std::atomic<bool> gEnabled{ true };
+
+std::mutex gRingsMutex;
+std::vector<std::shared_ptr<Ring>>& rings() {
+    static std::vector<std::shared_ptr<Ring>> r;
+    return r;
+}
+
+// Rings outlive their threads (the registry keeps them) so late exports
+// still see events from workers that have finished.
+Ring& localRing() {
+    thread_local std::shared_ptr<Ring> ring;
+    if (!ring) {
+        ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lk(gRingsMutex);
+        ring->tid = (uint32_t)rings().size() + 1;
+        rings().push_back(ring);
+    }
+    return *ring;
+}
+
+void writeJsonString(FILE* f, const char* s) {
+    std::fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') std::fputc('\\', f);
+        std::fputc(*s, f);
+    }
+    std::fputc('"', f);
+}
+
+} // namespace
+
+void setEnabled(bool on) { gEnabled.store(on, std::memory_order_relaxed); }
+bool enabled() { return gEnabled.load(std::memory_order_relaxed); }
+
+void record(const char* name, uint64_t startNs, uint64_t durNs) {
+    Ring& r = localRing();
+    uint64_t h = r.head.load(std::memory_order_relaxed);
+    Slot& s = r.slots[h & (RING_CAPACITY - 1)];
+    s.seq.store(2 * h + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.name.store(name, std::memory_order_relaxed);
+    s.startNs.store(startNs, std::memory_order_relaxed);
+    s.durNs.store(durNs, std::memory_order_relaxed);
+    s.seq.store(2 * h + 2, std::memory_order_release);
+    r.head.store(h + 1, std::memory_order_release);
+}
+
+bool exportChromeJson(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    bool first = true;
+
+    std::lock_guard<std::mutex> lk(gRingsMutex);
+    for (const auto& r : rings()) {
+        uint64_t head = r->head.load(std::memory_order_acquire);
+        uint64_t begin = (head > RING_CAPACITY) ? head - RING_CAPACITY : 0;
+
+        std::fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     first ? "" : ",\n", r->tid, r->tid == 1 ? "main" : "worker");
+        first = false;
+
+        for (uint64_t i = begin; i < head; i++) {
+            // Skip slots overwritten (or being overwritten) since head was read.
+            const Slot& s = r->slots[i & (RING_CAPACITY - 1)];
+            uint64_t seq = s.seq.load(std::memory_order_acquire);
+            Event e{ s.name.load(std::memory_order_relaxed), s.startNs.load(std::memory_order_relaxed),
+                     s.durNs.load(std::memory_order_relaxed) };
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq != 2 * i + 2 || s.seq.load(std::memory_order_relaxed) != seq) continue;
+            std::fputs(",\n{\"ph\":\"X\",\"pid\":1,\"name\":", f);
+            writeJsonString(f, e.name ? e.name : "?");
+            std::fprintf(f, ",\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                         r->tid, e.startNs / 1000.0, e.durNs / 1000.0);
+        }
+    }
+
+    std::fputs("\n]}\n", f);
+    return std::fclose(f) == 0;
+}
+
+#else // !SPACETRADER_TRACE
+
+void setEnabled(bool) {}
+bool enabled() { return false; }
+void record(const char*, uint64_t, uint64_t) {}
+bool exportChromeJson(const std::string&) { return false; }
+
+#endif
+
+} // namespace trace
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Scoped hot-path tracing.
+//
+// TRACE_SCOPE("name") records a complete event (start + duration) into a
+// per-thread ring buffer when the scope exits. Recording is a clock read and
+// a store into a fixed array: no locks, no allocation after the first event
+// on a thread. When a ring wraps, the oldest events are overwritten.
+//
+// exportChromeJson() writes every ring as Chrome trace_event JSON, which
+// loads directly in Perfetto (ui.perfetto.dev) or chrome://tracing. It may
+// run while other threads record; events overwritten mid-export are skipped.
+//
+// Build with -DSPACETRADER_TRACE to compile the instrumentation in; without
+// it TRACE_SCOPE expands to nothing and the API below is a no-op.
+
+namespace trace {
+
+struct Event {
+    const char* name = nullptr;  // must be a string literal / static storage
+    uint64_t startNs = 0;
+    uint64_t durNs = 0;
+};
+
+constexpr uint32_t RING_CAPACITY = 1u << 16; // events per thread (power of 2)
+
+uint64_t nowNs();
+
+void setEnabled(bool on);
+bool enabled();
+constexpr bool compiledIn() {
+#ifdef SPACETRADER_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void record(const char* name, uint64_t startNs, uint64_t durNs);
+
+// Writes all recorded events; returns false if the file could not be written
+// or tracing is compiled out.
+bool exportChromeJson(const std::string& path);
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name_(name), start_(enabled() ? nowNs() : 0) {}
+    ~Scope() { if (start_) record(name_, start_, nowNs() - start_); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+} // namespace trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef SPACETRADER_TRACE
+#define TRACE_SCOPE(name) ::trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif